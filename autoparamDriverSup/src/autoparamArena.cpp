@@ -0,0 +1,126 @@
+// SPDX-FileCopyrightText: 2022 Cosylab d.d. https://www.cosylab.com
+//
+// SPDX-License-Identifier: MIT
+
+#include <cstdlib>
+#include <new>
+
+#include "autoparamArena.h"
+
+namespace Autoparam {
+
+namespace {
+
+// Alignment suitable for any fundamental type.
+union MaxAlign {
+    long double ld;
+    long long ll;
+    void *p;
+    void (*fp)();
+};
+
+size_t const alignment = sizeof(MaxAlign);
+
+size_t alignUp(size_t size) {
+    return (size + alignment - 1) / alignment * alignment;
+}
+
+// Precedes memory from Arena::allocateTagged().
+struct Tag {
+    Arena *arena;
+    size_t size;
+};
+
+// Keeps the memory after the tag aligned.
+size_t const tagSize = alignUp(sizeof(Tag));
+
+Tag *tagOf(void const *ptr) {
+    return reinterpret_cast<Tag *>(
+        const_cast<char *>(static_cast<char const *>(ptr)) - tagSize);
+}
+
+} // namespace
+
+Arena::Arena(size_t blockSize)
+    : m_current(NULL), m_remaining(0), m_blockSize(alignUp(blockSize)),
+      m_allocated(0), m_reserved(0) {}
+
+Arena::~Arena() {
+    for (size_t i = 0; i < m_blocks.size(); ++i) {
+        free(m_blocks[i]);
+    }
+}
+
+char *Arena::newBlock(size_t size) {
+    char *mem = static_cast<char *>(malloc(size));
+    if (mem == NULL) {
+        throw std::bad_alloc();
+    }
+    m_blocks.push_back(mem);
+    m_reserved += size;
+    return mem;
+}
+
+void *Arena::allocate(size_t size) {
+    size = alignUp(size == 0 ? 1 : size);
+    m_allocated += size;
+
+    if (size > m_blockSize) {
+        // Don't waste the remainder of the current block on a big object.
+        return newBlock(size);
+    }
+
+    if (size > m_remaining) {
+        m_current = newBlock(m_blockSize);
+        m_remaining = m_blockSize;
+    }
+
+    void *ptr = m_current;
+    m_current += size;
+    m_remaining -= size;
+    return ptr;
+}
+
+void Arena::deallocate(void *ptr, size_t size) {
+    size = alignUp(size == 0 ? 1 : size);
+    // Big objects have blocks of their own, which are never current.
+    if (static_cast<char *>(ptr) + size == m_current &&
+        size <= m_blockSize - m_remaining) {
+        m_current -= size;
+        m_remaining += size;
+        m_allocated -= size;
+    }
+}
+
+void *Arena::allocateTagged(size_t size, Arena *arena) {
+    char *mem = static_cast<char *>(arena ? arena->allocate(tagSize + size)
+                                          : ::operator new(tagSize + size));
+    Tag *tag = reinterpret_cast<Tag *>(mem);
+    tag->arena = arena;
+    tag->size = size;
+    return mem + tagSize;
+}
+
+void Arena::releaseTagged(void *ptr) {
+    if (ptr == NULL) {
+        return;
+    }
+    Tag *tag = tagOf(ptr);
+    if (tag->arena) {
+        tag->arena->deallocate(tag, tagSize + tag->size);
+    } else {
+        ::operator delete(tag);
+    }
+}
+
+size_t Arena::taggedSize(void const *ptr) { return tagOf(ptr)->size; }
+
+} // namespace Autoparam
+
+void *operator new(size_t size, Autoparam::Arena &arena) {
+    return arena.allocate(size);
+}
+
+void operator delete(void *, Autoparam::Arena &) {
+    // Memory is reclaimed when the arena is destroyed.
+}
@@ -0,0 +1,102 @@
+// SPDX-FileCopyrightText: 2022 Cosylab d.d. https://www.cosylab.com
+//
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+// API definition
+#include <autoparamDriverAPI.h>
+
+namespace Autoparam {
+
+/*! A bump allocator for objects that live as long as the `Driver`.
+ *
+ * Drivers typically create a very large number of small `DeviceAddress` and
+ * `DeviceVariable` objects while records are initialized, and keep them until
+ * the driver is destroyed. Allocating them one by one on the heap is slow and
+ * fragments memory. `Arena` instead hands out memory from large blocks that
+ * are released all at once when the arena is destroyed.
+ *
+ * Objects are placed into an arena using placement new:
+ *
+ *     DeviceAddress *addr = new (arena()) MyAddress(...);
+ *
+ * `DeviceAddress` and `DeviceVariable` instances allocated this way can still
+ * be destroyed with `delete`: their destructors run as usual, but the memory
+ * is only reclaimed when the arena is destroyed, unless the object was the
+ * last one allocated. Objects of other types must not be `delete`d; call their
+ * destructor explicitly if needed.
+ *
+ * `Arena` is not threadsafe. The arena owned by `Driver` (see
+ * `Driver::arena()`) is meant to be used from `Driver::parseDeviceAddress()`
+ * and `Driver::createDeviceVariable()`, which are called with the driver
+ * locked.
+ */
+class AUTOPARAMDRIVER_API Arena {
+  public:
+    //! Construct an arena that reserves memory in blocks of `blockSize` bytes.
+    explicit Arena(size_t blockSize = 64 * 1024);
+
+    //! Release all memory. Destructors of contained objects are not run.
+    ~Arena();
+
+    /*! Allocate `size` bytes, suitably aligned for any type.
+     *
+     * Allocations larger than the block size get a block of their own. Throws
+     * `std::bad_alloc` on failure.
+     */
+    void *allocate(size_t size);
+
+    /*! Give back `size` bytes at `ptr`, obtained from `allocate()`.
+     *
+     * The memory is reused only if it was the last allocation, e.g. of an
+     * object that turned out not to be needed. Otherwise, it is reclaimed when
+     * the arena is destroyed.
+     */
+    void deallocate(void *ptr, size_t size);
+
+    //! The number of bytes handed out by `allocate()`.
+    size_t bytesAllocated() const { return m_allocated; }
+
+    //! The number of bytes reserved from the system.
+    size_t bytesReserved() const { return m_reserved; }
+
+    /*! Allocate memory for an object that may be destroyed with `delete`.
+     *
+     * The memory comes from `arena`, or from the heap if `arena` is `NULL`. It
+     * is preceded by a header recording where it came from and its size, so
+     * that `releaseTagged()` doesn't need to look it up. These are the
+     * allocation functions of `DeviceAddress` and `DeviceVariable`.
+     */
+    static void *allocateTagged(size_t size, Arena *arena);
+
+    //! Free memory from `allocateTagged()`, or give it back to its arena.
+    static void releaseTagged(void *ptr);
+
+    //! The size that was requested from `allocateTagged()`.
+    static size_t taggedSize(void const *ptr);
+
+  private:
+    Arena(Arena const &);
+    Arena &operator=(Arena const &);
+
+    char *newBlock(size_t size);
+
+    std::vector<char *> m_blocks;
+    char *m_current;
+    size_t m_remaining;
+    size_t m_blockSize;
+    size_t m_allocated;
+    size_t m_reserved;
+};
+
+} // namespace Autoparam
+
+//! Placement new allocating from an `Autoparam::Arena`.
+AUTOPARAMDRIVER_API void *operator new(size_t size, Autoparam::Arena &arena);
+
+//! Matching placement delete, called only if a constructor throws.
+AUTOPARAMDRIVER_API void operator delete(void *ptr, Autoparam::Arena &arena);
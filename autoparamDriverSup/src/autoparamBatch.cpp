@@ -0,0 +1,166 @@
+// SPDX-FileCopyrightText: 2022 Cosylab d.d. https://www.cosylab.com
+//
+// SPDX-License-Identifier: MIT
+
+#include <cstring>
+
+#include "autoparamBuffer.h"
+#include "autoparamDriver.h"
+
+namespace Autoparam {
+
+WriteBatch::WriteBatch(Driver *driver, std::string const &name)
+    : m_driver(driver), m_name(name), m_handler(NULL), m_window(0),
+      m_threadStarted(false), m_quit(false) {}
+
+template <typename T> T WriteBatch::value(size_t i) const {
+    T value;
+    std::memcpy(&value, &write(i).data[0], sizeof(value));
+    return value;
+}
+
+template <typename T> Array<T> WriteBatch::array(size_t i) {
+    Write &w = write(i);
+    return Array<T>(bufferElements<T>(w.data), w.size);
+}
+
+// Called when a member variable is created, with the driver locked. Strings
+// and generic pointers cannot be members.
+bool WriteBatch::addMember(DeviceVariable &var) {
+    if (m_positions.count(var.asynIndex()) > 0) {
+        return true;
+    }
+    Publisher publish;
+    switch (var.asynType()) {
+    case asynParamInt32:
+        publish = publishScalar<epicsInt32>;
+        break;
+    case asynParamInt64:
+        publish = publishScalar<epicsInt64>;
+        break;
+    case asynParamUInt32Digital:
+        publish = publishDigital;
+        break;
+    case asynParamFloat64:
+        publish = publishScalar<epicsFloat64>;
+        break;
+    case asynParamInt8Array:
+        publish = publishArray<epicsInt8>;
+        break;
+    case asynParamInt16Array:
+        publish = publishArray<epicsInt16>;
+        break;
+    case asynParamInt32Array:
+        publish = publishArray<epicsInt32>;
+        break;
+    case asynParamInt64Array:
+        publish = publishArray<epicsInt64>;
+        break;
+    case asynParamFloat32Array:
+        publish = publishArray<epicsFloat32>;
+        break;
+    case asynParamFloat64Array:
+        publish = publishArray<epicsFloat64>;
+        break;
+    default:
+        return false;
+    }
+
+    m_positions[var.asynIndex()] = m_slots.size();
+    m_slots.push_back(Write());
+    m_order.reserve(m_slots.size());
+
+    Write &write = m_slots.back();
+    write.var = &var;
+    write.publish = publish;
+    // Enough for any scalar.
+    write.data.reserve(sizeof(epicsFloat64));
+    return true;
+}
+
+void WriteBatch::stage(DeviceVariable &var, void const *data, size_t bytes,
+                       size_t size, epicsUInt32 mask) {
+    size_t slot = m_positions.find(var.asynIndex())->second;
+    Write &write = m_slots[slot];
+    if (!write.staged) {
+        write.staged = true;
+        write.mask = 0;
+        write.result = WriteResult();
+        m_order.push_back(slot);
+    }
+
+    if (var.asynType() == asynParamUInt32Digital && write.mask != 0) {
+        // Merge the bits with those written before.
+        epicsUInt32 value;
+        epicsUInt32 old;
+        std::memcpy(&value, data, sizeof(value));
+        std::memcpy(&old, &write.data[0], sizeof(old));
+        value = (old & ~mask) | (value & mask);
+        std::memcpy(&write.data[0], &value, sizeof(value));
+        write.mask |= mask;
+        return;
+    }
+    write.data.resize(bytes);
+    if (bytes > 0) {
+        std::memcpy(&write.data[0], data, bytes);
+    }
+    write.size = size;
+    write.mask = mask;
+}
+
+// Keeps the slots and their buffers for the next commit.
+void WriteBatch::clear() {
+    for (size_t i = 0; i < m_order.size(); ++i) {
+        m_slots[m_order[i]].staged = false;
+    }
+    m_order.clear();
+}
+
+template <typename T>
+asynStatus WriteBatch::publishScalar(Driver &driver, DeviceVariable &var,
+                                     std::vector<char> &data, size_t,
+                                     epicsUInt32) {
+    T value;
+    std::memcpy(&value, &data[0], sizeof(value));
+    return driver.setParam(var, value);
+}
+
+asynStatus WriteBatch::publishDigital(Driver &driver, DeviceVariable &var,
+                                      std::vector<char> &data, size_t,
+                                      epicsUInt32 mask) {
+    epicsUInt32 value;
+    std::memcpy(&value, &data[0], sizeof(value));
+    return driver.setParam(var, value, mask);
+}
+
+template <typename T>
+asynStatus WriteBatch::publishArray(Driver &driver, DeviceVariable &var,
+                                    std::vector<char> &data, size_t size,
+                                    epicsUInt32) {
+    Array<T> value(bufferElements<T>(data), size);
+    return driver.doCallbacksArray(var, value);
+}
+
+template AUTOPARAMDRIVER_API epicsInt32 epicsStdCall
+WriteBatch::value<epicsInt32>(size_t i) const;
+template AUTOPARAMDRIVER_API epicsInt64 epicsStdCall
+WriteBatch::value<epicsInt64>(size_t i) const;
+template AUTOPARAMDRIVER_API epicsUInt32 epicsStdCall
+WriteBatch::value<epicsUInt32>(size_t i) const;
+template AUTOPARAMDRIVER_API epicsFloat64 epicsStdCall
+WriteBatch::value<epicsFloat64>(size_t i) const;
+
+template AUTOPARAMDRIVER_API Array<epicsInt8> epicsStdCall
+WriteBatch::array<epicsInt8>(size_t i);
+template AUTOPARAMDRIVER_API Array<epicsInt16> epicsStdCall
+WriteBatch::array<epicsInt16>(size_t i);
+template AUTOPARAMDRIVER_API Array<epicsInt32> epicsStdCall
+WriteBatch::array<epicsInt32>(size_t i);
+template AUTOPARAMDRIVER_API Array<epicsInt64> epicsStdCall
+WriteBatch::array<epicsInt64>(size_t i);
+template AUTOPARAMDRIVER_API Array<epicsFloat32> epicsStdCall
+WriteBatch::array<epicsFloat32>(size_t i);
+template AUTOPARAMDRIVER_API Array<epicsFloat64> epicsStdCall
+WriteBatch::array<epicsFloat64>(size_t i);
+
+} // namespace Autoparam
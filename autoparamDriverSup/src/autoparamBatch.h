@@ -0,0 +1,147 @@
+// SPDX-FileCopyrightText: 2022 Cosylab d.d. https://www.cosylab.com
+//
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include <epicsEvent.h>
+
+#include "autoparamHandler.h"
+
+// API definition
+#include <autoparamDriverAPI.h>
+
+namespace Autoparam {
+
+class Driver;
+
+/*! The writes collected for a write batch, committed together.
+ *
+ * Configuring a device often takes many setpoint writes that the device
+ * could accept in a single transaction. Instead of calling a write handler
+ * for each of them, functions can be made members of a write batch (see
+ * `FunctionOpts::setWriteBatch()`). Writes to members are collected in the
+ * batch, and a single `BatchWriteHandler` writes all of them to the device
+ * when the batch is committed, either explicitly by `Driver::commitBatch()`
+ * or automatically a fixed time after the first write (see
+ * `Driver::registerBatchHandler()`).
+ *
+ * Each variable appears in the batch at most once, in the order it was first
+ * written in. Writing it again replaces the value; for `UInt32Digital`
+ * variables, the bits are merged and `mask()` covers all of them.
+ */
+class AUTOPARAMDRIVER_API WriteBatch {
+  public:
+    //! The name of the batch.
+    std::string const &name() const { return m_name; }
+
+    //! The number of writes in the batch.
+    size_t size() const { return m_order.size(); }
+
+    //! The variable of write `i`.
+    DeviceVariable &variable(size_t i) const { return *write(i).var; }
+
+    /*! The value of scalar write `i`.
+     *
+     * `T` must be the type the function of the variable is registered for;
+     * see `DeviceVariable::asynType()`.
+     */
+    template <typename T> T value(size_t i) const;
+
+    //! The bits written by `UInt32Digital` write `i`.
+    epicsUInt32 mask(size_t i) const { return write(i).mask; }
+
+    /*! The data of array write `i`.
+     *
+     * `T` must be the element type the function of the variable is registered
+     * for. The data remains valid until the handler returns.
+     */
+    template <typename T> Array<T> array(size_t i);
+
+    /*! The result of write `i`.
+     *
+     * Successful by default. The handler sets it for writes that failed or
+     * need alarms. After the handler returns, results are propagated to the
+     * parameters as if they were returned by a write handler.
+     */
+    WriteResult &result(size_t i) { return write(i).result; }
+
+  private:
+    friend class Driver;
+
+    typedef asynStatus (*Publisher)(Driver &driver, DeviceVariable &var,
+                                    std::vector<char> &data, size_t size,
+                                    epicsUInt32 mask);
+
+    // The slot of a member variable, created together with the variable.
+    // The buffer keeps its capacity between commits, so staging a write only
+    // allocates memory for an array larger than any before it.
+    struct Write {
+        Write() : var(NULL), size(0), mask(0), publish(NULL), staged(false) {}
+
+        DeviceVariable *var;
+        std::vector<char> data;
+        // The number of elements of arrays.
+        size_t size;
+        epicsUInt32 mask;
+        WriteResult result;
+        Publisher publish;
+        bool staged;
+    };
+
+    WriteBatch(Driver *driver, std::string const &name);
+    WriteBatch(WriteBatch const &);
+    WriteBatch &operator=(WriteBatch const &);
+
+    Write &write(size_t i) { return m_slots[m_order[i]]; }
+    Write const &write(size_t i) const { return m_slots[m_order[i]]; }
+
+    bool addMember(DeviceVariable &var);
+    void stage(DeviceVariable &var, void const *data, size_t bytes,
+               size_t size, epicsUInt32 mask);
+    void clear();
+
+    template <typename T>
+    static asynStatus publishScalar(Driver &driver, DeviceVariable &var,
+                                    std::vector<char> &data, size_t size,
+                                    epicsUInt32 mask);
+    static asynStatus publishDigital(Driver &driver, DeviceVariable &var,
+                                     std::vector<char> &data, size_t size,
+                                     epicsUInt32 mask);
+    template <typename T>
+    static asynStatus publishArray(Driver &driver, DeviceVariable &var,
+                                   std::vector<char> &data, size_t size,
+                                   epicsUInt32 mask);
+
+    Driver *m_driver;
+    std::string m_name;
+    asynStatus (*m_handler)(WriteBatch &batch);
+    // The time writes are collected for before an automatic commit, or 0.
+    double m_window;
+    // One per member variable.
+    std::vector<Write> m_slots;
+    // Keyed by asyn index, the position of the variable in `m_slots`.
+    std::map<int, size_t> m_positions;
+    // The slots of staged writes, in the order they were first written in.
+    std::vector<size_t> m_order;
+    // Wakes up the thread committing automatically, if there is one.
+    epicsEvent m_wakeup;
+    epicsEvent m_done;
+    bool m_threadStarted;
+    bool m_quit;
+};
+
+/*! A function writing the values of a write batch to the device.
+ *
+ * Called by `Driver::commitBatch()` with the driver locked. It should write
+ * all values, typically in a single transaction, and set
+ * `WriteBatch::result()` of writes that failed. If it returns an error, the
+ * status of all writes whose result is still successful is set to it.
+ */
+typedef asynStatus (*BatchWriteHandler)(WriteBatch &batch);
+
+} // namespace Autoparam
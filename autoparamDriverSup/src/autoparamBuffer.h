@@ -0,0 +1,20 @@
+// SPDX-FileCopyrightText: 2022 Cosylab d.d. https://www.cosylab.com
+//
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+// Byte buffers holding values of any asyn type. This header is private to the
+// library.
+
+#include <vector>
+
+namespace Autoparam {
+
+// Returns the elements stored in `data`, or NULL if it is empty. The buffer of
+// a vector comes from operator new, so it is suitably aligned for any T.
+template <typename T> T *bufferElements(std::vector<char> &data) {
+    return data.empty() ? NULL : reinterpret_cast<T *>(&data[0]);
+}
+
+} // namespace Autoparam
@@ -0,0 +1,173 @@
+// SPDX-FileCopyrightText: 2022 Cosylab d.d. https://www.cosylab.com
+//
+// SPDX-License-Identifier: MIT
+
+#include <algorithm>
+#include <cstring>
+
+#include "autoparamBuffer.h"
+#include "autoparamClient.h"
+
+namespace Autoparam {
+
+namespace {
+
+char const *interfaceType(asynParamType type) {
+    switch (type) {
+    case asynParamInt32:
+        return asynInt32Type;
+    case asynParamInt64:
+        return asynInt64Type;
+    case asynParamUInt32Digital:
+        return asynUInt32DigitalType;
+    case asynParamFloat64:
+        return asynFloat64Type;
+    case asynParamOctet:
+        return asynOctetType;
+    case asynParamInt8Array:
+        return asynInt8ArrayType;
+    case asynParamInt16Array:
+        return asynInt16ArrayType;
+    case asynParamInt32Array:
+        return asynInt32ArrayType;
+    case asynParamInt64Array:
+        return asynInt64ArrayType;
+    case asynParamFloat32Array:
+        return asynFloat32ArrayType;
+    case asynParamFloat64Array:
+        return asynFloat64ArrayType;
+    default:
+        // Generic pointers are opaque, so there is no value to issue.
+        return NULL;
+    }
+}
+
+template <typename Iface, typename T>
+asynStatus scalarRequest(ClientUser const &user, RequestKind kind,
+                         std::vector<char> &data) {
+    Iface *pif = static_cast<Iface *>(user.iface->pinterface);
+    T value = T();
+    if (kind == RequestWrite) {
+        if (data.size() == sizeof(T)) {
+            std::memcpy(&value, &data[0], sizeof(T));
+        }
+        return pif->write(user.iface->drvPvt, user.pasynUser, value);
+    }
+    asynStatus status = pif->read(user.iface->drvPvt, user.pasynUser, &value);
+    data.resize(sizeof(T));
+    std::memcpy(&data[0], &value, sizeof(T));
+    return status;
+}
+
+template <typename Iface, typename T>
+asynStatus arrayRequest(ClientUser const &user, RequestKind kind,
+                        std::vector<char> &data) {
+    Iface *pif = static_cast<Iface *>(user.iface->pinterface);
+    size_t size = data.size() / sizeof(T);
+    T *elements = bufferElements<T>(data);
+    if (kind == RequestWrite) {
+        return pif->write(user.iface->drvPvt, user.pasynUser, elements, size);
+    }
+    size_t nIn = 0;
+    asynStatus status =
+        pif->read(user.iface->drvPvt, user.pasynUser, elements, size, &nIn);
+    data.resize(std::min(nIn, size) * sizeof(T));
+    return status;
+}
+
+} // namespace
+
+bool connectClient(ClientUser &user, char const *port,
+                   std::string const &reason, asynParamType type,
+                   userCallback process, void *userPvt) {
+    user.pasynUser = pasynManager->createAsynUser(process, NULL);
+    user.pasynUser->userPvt = userPvt;
+    user.iface = NULL;
+    user.type = type;
+    char const *ifaceType = interfaceType(type);
+    if (ifaceType == NULL ||
+        pasynManager->connectDevice(user.pasynUser, port, 0) != asynSuccess) {
+        return false;
+    }
+    asynInterface *drvUser =
+        pasynManager->findInterface(user.pasynUser, asynDrvUserType, 1);
+    if (drvUser == NULL ||
+        static_cast<asynDrvUser *>(drvUser->pinterface)
+                ->create(drvUser->drvPvt, user.pasynUser, reason.c_str(), NULL,
+                         NULL) != asynSuccess) {
+        return false;
+    }
+    user.iface = pasynManager->findInterface(user.pasynUser, ifaceType, 1);
+    return user.iface != NULL;
+}
+
+void disconnectClient(ClientUser &user) {
+    if (user.pasynUser == NULL) {
+        return;
+    }
+    pasynManager->disconnect(user.pasynUser);
+    pasynManager->freeAsynUser(user.pasynUser);
+    user.pasynUser = NULL;
+    user.iface = NULL;
+}
+
+asynStatus clientRequest(ClientUser const &user, RequestKind kind,
+                         std::vector<char> &data, epicsUInt32 mask) {
+    switch (user.type) {
+    case asynParamInt32:
+        return scalarRequest<asynInt32, epicsInt32>(user, kind, data);
+    case asynParamInt64:
+        return scalarRequest<asynInt64, epicsInt64>(user, kind, data);
+    case asynParamFloat64:
+        return scalarRequest<asynFloat64, epicsFloat64>(user, kind, data);
+    case asynParamUInt32Digital: {
+        asynUInt32Digital *pif =
+            static_cast<asynUInt32Digital *>(user.iface->pinterface);
+        epicsUInt32 value = 0;
+        if (kind == RequestWrite) {
+            if (data.size() == sizeof(value)) {
+                std::memcpy(&value, &data[0], sizeof(value));
+            }
+            return pif->write(user.iface->drvPvt, user.pasynUser, value, mask);
+        }
+        asynStatus status =
+            pif->read(user.iface->drvPvt, user.pasynUser, &value, mask);
+        data.resize(sizeof(value));
+        std::memcpy(&data[0], &value, sizeof(value));
+        return status;
+    }
+    case asynParamOctet: {
+        asynOctet *pif = static_cast<asynOctet *>(user.iface->pinterface);
+        size_t size = data.size();
+        size_t nTransferred = 0;
+        if (kind == RequestWrite) {
+            return pif->write(user.iface->drvPvt, user.pasynUser,
+                              size > 0 ? &data[0] : "", size, &nTransferred);
+        }
+        // Leave room for the terminator.
+        data.resize(size + 1);
+        int eomReason;
+        asynStatus status = pif->read(user.iface->drvPvt, user.pasynUser,
+                                      &data[0], size + 1, &nTransferred,
+                                      &eomReason);
+        data.resize(std::min(nTransferred, size));
+        return status;
+    }
+    case asynParamInt8Array:
+        return arrayRequest<asynInt8Array, epicsInt8>(user, kind, data);
+    case asynParamInt16Array:
+        return arrayRequest<asynInt16Array, epicsInt16>(user, kind, data);
+    case asynParamInt32Array:
+        return arrayRequest<asynInt32Array, epicsInt32>(user, kind, data);
+    case asynParamInt64Array:
+        return arrayRequest<asynInt64Array, epicsInt64>(user, kind, data);
+    case asynParamFloat32Array:
+        return arrayRequest<asynFloat32Array, epicsFloat32>(user, kind, data);
+    case asynParamFloat64Array:
+        return arrayRequest<asynFloat64Array, epicsFloat64>(user, kind, data);
+    default:
+        return asynError;
+    }
+}
+
+} // namespace Autoparam
@@ -0,0 +1,49 @@
+// SPDX-FileCopyrightText: 2022 Cosylab d.d. https://www.cosylab.com
+//
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+// Issuing requests to a driver from within the IOC, the way device support
+// does. Used by traffic replay and the load generator. This header is private
+// to the library.
+
+#include <string>
+#include <vector>
+
+#include <asynPortDriver.h>
+#include <epicsTypes.h>
+
+#include "autoparamRecorder.h"
+
+namespace Autoparam {
+
+// An asynUser bound to a device variable, and the interface to issue its
+// requests through.
+struct ClientUser {
+    ClientUser() : pasynUser(NULL), iface(NULL), type(asynParamNotDefined) {}
+
+    asynUser *pasynUser;
+    asynInterface *iface;
+    asynParamType type;
+};
+
+// Creates an asynUser with the given process callback and connects it to the
+// variable `reason` on `port`, which can move it to the port of a device
+// group. Returns false if the variable cannot be created or its type cannot be
+// issued requests, i.e. it is a generic pointer. The asynUser is created even
+// then, and needs to be freed by `disconnectClient()`.
+bool connectClient(ClientUser &user, char const *port,
+                   std::string const &reason, asynParamType type,
+                   userCallback process = NULL, void *userPvt = NULL);
+
+void disconnectClient(ClientUser &user);
+
+// Reads or writes the value of the variable through its interface, without
+// going through the queue of the port. A write sends `data` as the raw bytes
+// of the value. A read fills `data` with the value read, reading at most
+// `data.size()` bytes of arrays and strings. `mask` applies to digital IO.
+asynStatus clientRequest(ClientUser const &user, RequestKind kind,
+                         std::vector<char> &data, epicsUInt32 mask);
+
+} // namespace Autoparam
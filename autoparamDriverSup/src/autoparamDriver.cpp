@@ -3,29 +3,198 @@
 // SPDX-License-Identifier: MIT
 
 #include <algorithm>
+#include <cstring>
 #include <sstream>
 
 #include <errlog.h>
+#include <epicsAtomic.h>
 #include <epicsExit.h>
+#include <epicsThread.h>
+#include <epicsTime.h>
 #include <initHooks.h>
 
 #include "autoparamDriver.h"
+#include "autoparamClient.h"
+#include "autoparamEventLoop.h"
+#include "autoparamMetrics.h"
+#include "autoparamThread.h"
+#include "autoparamTrace.h"
+#include "autoparamTraffic.h"
 
 namespace Autoparam {
 
+template <typename T>
+static void const *findInMap(std::map<std::string, T> const &map,
+                             std::string const &key) {
+    typename std::map<std::string, T>::const_iterator i = map.find(key);
+    return i == map.end() ? NULL : &i->second;
+}
+
 static char const *driverName = "Autoparam::Driver";
 
 static std::map<Driver *, DriverOpts::InitHook> allInitHooks;
 
-DeviceVariable::DeviceVariable(char const *reason, std::string const &function,
+// Drivers that have functions with deadlines, checked by the watchdog thread.
+static epicsMutex &watchdogLock() {
+    static epicsMutex lock;
+    return lock;
+}
+
+static std::vector<Driver *> &watchedDrivers() {
+    static std::vector<Driver *> drivers;
+    return drivers;
+}
+
+static double const watchdogPeriod = 0.1;
+
+// The mask of a complete `UInt32Digital` register.
+static epicsUInt32 const allBits = 0xffffffff;
+
+namespace {
+
+// A thread of a pool is an asyn port. Each driver assigned to the thread is a
+// device of the port, at its own address.
+struct PoolThread {
+    std::string portName;
+    asynInterface common;
+    double load;
+    int drivers;
+};
+
+struct ThreadPool {
+    std::vector<PoolThread *> threads;
+};
+
+// Pools are never deleted, since asyn ports cannot be removed.
+epicsMutex &threadPoolLock() {
+    static epicsMutex lock;
+    return lock;
+}
+
+std::map<std::string, ThreadPool> &threadPools() {
+    static std::map<std::string, ThreadPool> pools;
+    return pools;
+}
+
+void poolReport(void *drvPvt, FILE *fp, int) {
+    PoolThread *thread = static_cast<PoolThread *>(drvPvt);
+    threadPoolLock().lock();
+    fprintf(fp, "Thread pool port serving %d drivers, load %g\n",
+            thread->drivers, thread->load);
+    threadPoolLock().unlock();
+}
+
+asynStatus poolConnect(void *, asynUser *pasynUser) {
+    pasynManager->exceptionConnect(pasynUser);
+    return asynSuccess;
+}
+
+asynStatus poolDisconnect(void *, asynUser *pasynUser) {
+    pasynManager->exceptionDisconnect(pasynUser);
+    return asynSuccess;
+}
+
+asynCommon poolCommon = {poolReport, poolConnect, poolDisconnect};
+
+// Fills `dest` with the interfaces of a driver's port that are also exposed by
+// the ports handling requests on its behalf, and returns their number.
+size_t getForwardedInterfaces(asynStandardInterfaces *ifcs,
+                              asynInterface *dest[]) {
+    asynInterface *all[] = {
+        &ifcs->drvUser,    &ifcs->octet,        &ifcs->uInt32Digital,
+        &ifcs->int32,      &ifcs->int64,        &ifcs->float64,
+        &ifcs->int8Array,  &ifcs->int16Array,   &ifcs->int32Array,
+        &ifcs->int64Array, &ifcs->float32Array, &ifcs->float64Array,
+        &ifcs->genericPointer};
+    size_t count = 0;
+    for (size_t i = 0; i < sizeof(all) / sizeof(all[0]); ++i) {
+        if (all[i]->pinterface != NULL) {
+            dest[count++] = all[i];
+        }
+    }
+    return count;
+}
+
+size_t const maxForwardedInterfaces = 13;
+
+// Addresses and variables are created by the derived driver, which may
+// allocate them from the heap or from the arena. To know their sizes, the
+// Driver counts the bytes its thread allocates for them while they are being
+// created.
+epicsThreadOnceId allocationCounterOnce = EPICS_THREAD_ONCE_INIT;
+epicsThreadPrivateId allocationCounterId;
+
+void createAllocationCounterId(void *) {
+    allocationCounterId = epicsThreadPrivateCreate();
+}
+
+void *allocateCounted(size_t size, Arena *arena) {
+    void *ptr = Arena::allocateTagged(size, arena);
+    epicsThreadOnce(&allocationCounterOnce, createAllocationCounterId, NULL);
+    size_t *counter =
+        static_cast<size_t *>(epicsThreadPrivateGet(allocationCounterId));
+    if (counter != NULL) {
+        *counter += size;
+    }
+    return ptr;
+}
+
+// Counts the bytes of addresses and variables allocated by the calling thread
+// while it exists.
+class AllocationCounter {
+  public:
+    AllocationCounter() : m_bytes(0) {
+        epicsThreadOnce(&allocationCounterOnce, createAllocationCounterId,
+                        NULL);
+        epicsThreadPrivateSet(allocationCounterId, &m_bytes);
+    }
+
+    ~AllocationCounter() { epicsThreadPrivateSet(allocationCounterId, NULL); }
+
+    size_t bytes() const { return m_bytes; }
+
+  private:
+    size_t m_bytes;
+};
+
+} // namespace
+
+DeviceVariable::DeviceVariable(char const *reason, std::string const *function,
                                DeviceAddress *addr)
-    : m_reasonString(reason), m_function(function), m_address(addr) {}
+    : m_reasonString(reason), m_function(function),
+      m_asynParamType(asynParamNotDefined), m_asynParamIndex(-1),
+      m_interruptRefcount(0), m_handlers(NULL), m_functionInfo(NULL),
+      m_device(NULL), m_group(NULL), m_shadow(NULL), m_batch(NULL),
+      m_poll(NULL), m_address(addr) {}
+
+void *DeviceAddress::operator new(size_t size) {
+    return allocateCounted(size, NULL);
+}
+
+void *DeviceAddress::operator new(size_t size, Arena &arena) {
+    return allocateCounted(size, &arena);
+}
+
+void DeviceAddress::operator delete(void *ptr) { Arena::releaseTagged(ptr); }
+
+void DeviceAddress::operator delete(void *ptr, Arena &) {
+    Arena::releaseTagged(ptr);
+}
 
 DeviceVariable::DeviceVariable(DeviceVariable *other) {
     m_function = other->m_function;
-    m_reasonString = other->m_reasonString;
+    // `other` is invalidated anyway, so avoid copying the string.
+    m_reasonString.swap(other->m_reasonString);
     m_asynParamType = other->m_asynParamType;
     m_asynParamIndex = other->m_asynParamIndex;
+    m_interruptRefcount = other->m_interruptRefcount;
+    m_handlers = other->m_handlers;
+    m_functionInfo = other->m_functionInfo;
+    m_device = other->m_device;
+    m_group = other->m_group;
+    m_shadow = other->m_shadow;
+    m_batch = other->m_batch;
+    m_poll = other->m_poll;
     m_address = other->m_address;
     other->m_address = NULL;
 }
@@ -36,6 +205,20 @@ DeviceVariable::~DeviceVariable() {
     }
 }
 
+void *DeviceVariable::operator new(size_t size) {
+    return allocateCounted(size, NULL);
+}
+
+void *DeviceVariable::operator new(size_t size, Arena &arena) {
+    return allocateCounted(size, &arena);
+}
+
+void DeviceVariable::operator delete(void *ptr) { Arena::releaseTagged(ptr); }
+
+void DeviceVariable::operator delete(void *ptr, Arena &) {
+    Arena::releaseTagged(ptr);
+}
+
 // Copied from asyn. I wish they made this public.
 char const *getAsynTypeName(asynParamType type) {
     static const char *typeNames[] = {
@@ -49,17 +232,39 @@ char const *getAsynTypeName(asynParamType type) {
     return typeNames[type];
 }
 
-static std::string getDtypName(asynParamType type) {
-    std::string dtyp(getAsynTypeName(type));
-    std::string const substr("Param");
-    size_t idx = dtyp.find(substr);
-    dtyp.erase(idx, substr.size());
-    return dtyp;
+// Returns the asyn DTYP corresponding to the type, without allocating.
+static char const *getDtypName(asynParamType type) {
+    static const char *dtypNames[] = {
+        "asynTypeUndefined", "asynInt32",        "asynInt64",
+        "asynUInt32Digital", "asynFloat64",      "asynOctet",
+        "asynInt8Array",     "asynInt16Array",   "asynInt32Array",
+        "asynInt64Array",    "asynFloat32Array", "asynFloat64Array",
+        "asynGenericPointer"};
+    return dtypNames[type];
+}
+
+void Driver::timeStampSourceCallback(void *driver, epicsTimeStamp *timestamp) {
+    Driver *self = static_cast<Driver *>(driver);
+    self->opts.timeStampSource(self, timestamp);
 }
 
 void Driver::destroyDriver(void *driver) {
     Driver *drv = static_cast<Driver *>(driver);
     pasynManager->enable(drv->pasynUserSelf, 0);
+    for (std::map<std::string, DeviceGroup *>::iterator
+             i = drv->m_groups.begin(),
+             end = drv->m_groups.end();
+         i != end; ++i) {
+        if (i->second != NULL) {
+            pasynManager->enable(i->second->pasynUser, 0);
+        }
+    }
+    if (drv->m_pool != NULL) {
+        pasynManager->enable(drv->m_pool->pasynUser, 0);
+    }
+    if (drv->m_lane != NULL) {
+        pasynManager->enable(drv->m_lane->pasynUser, 0);
+    }
     delete drv;
 }
 
@@ -85,8 +290,24 @@ static void addInitHook(Driver *driver, DriverOpts::InitHook hook) {
 Driver::Driver(const char *portName, const DriverOpts &params)
     : asynPortDriver(portName, 1, params.interfaceMask, params.interruptMask,
                      params.asynFlags, params.autoConnect, params.priority,
-                     params.stackSize),
-      opts(params) {
+                     params.threadPool.empty()
+                         ? params.stackSize
+                         : epicsThreadGetStackSize(epicsThreadStackSmall)),
+      opts(params), m_addressBytes(0), m_variableBytes(0),
+      m_recorder(params.flightRecorderSize),
+      m_slowRequests(params.slowRequestCount), m_inFlight(NULL),
+      m_watched(false), m_pool(NULL), m_lane(NULL), m_active(0),
+      m_eventLoop(NULL), m_capture(NULL), m_replay(NULL) {
+    m_slowRequests.setLogging(params.slowRequestThreshold,
+                              params.slowRequestLogInterval);
+
+    if (params.deviceGroups && !(params.asynFlags & ASYN_CANBLOCK)) {
+        asynPrint(pasynUserSelf, ASYN_TRACE_ERROR,
+                  "%s: port=%s device groups require a blocking driver\n",
+                  driverName, portName);
+        opts.deviceGroups = false;
+    }
+
     if (params.autoDestruct) {
         epicsAtExit(destroyDriver, this);
     }
@@ -95,15 +316,76 @@ Driver::Driver(const char *portName, const DriverOpts &params)
         addInitHook(this, params.initHook);
     }
 
+    if (params.timeStampSource) {
+        pasynManager->registerTimeStampSource(pasynUserSelf, this,
+                                              timeStampSourceCallback);
+    }
+
     installInterruptRegistrars();
+    addMetricsSource(this);
+
+    if (params.asynFlags & ASYN_CANBLOCK) {
+        applyThreadOptions(portName);
+    }
+
+    if (!params.threadPool.empty()) {
+        if (params.asynFlags & ASYN_CANBLOCK) {
+            m_pool = joinThreadPool();
+        } else {
+            asynPrint(pasynUserSelf, ASYN_TRACE_ERROR,
+                      "%s: port=%s thread pools require a blocking driver\n",
+                      driverName, portName);
+        }
+    }
 }
 
 Driver::~Driver() {
+    if (m_watched) {
+        watchdogLock().lock();
+        std::vector<Driver *> &drivers = watchedDrivers();
+        drivers.erase(std::remove(drivers.begin(), drivers.end(), this),
+                      drivers.end());
+        watchdogLock().unlock();
+    }
+    removeMetricsSource(this);
+
+    // The threads committing batches refer to the variables, so they are
+    // stopped first. Collected writes that were not committed yet are
+    // discarded.
+    for (std::map<std::string, WriteBatch *>::iterator
+             i = m_batches.begin(),
+             end = m_batches.end();
+         i != end; ++i) {
+        WriteBatch *batch = i->second;
+        lock();
+        batch->m_quit = true;
+        unlock();
+        if (batch->m_threadStarted) {
+            batch->m_wakeup.signal();
+            batch->m_done.wait();
+        }
+        lock();
+        batch->clear();
+        unlock();
+        delete batch;
+    }
+
+    delete m_eventLoop;
+
     for (ParamMap::iterator i = m_params.begin(), end = m_params.end();
          i != end; ++i) {
+        delete *i;
+    }
+
+    for (std::map<std::string, Snapshot *>::iterator
+             i = m_snapshots.begin(),
+             end = m_snapshots.end();
+         i != end; ++i) {
         delete i->second;
     }
 
+    delete m_capture;
+
     while (!m_hijackedInterfaces.empty()) {
         free(m_hijackedInterfaces.back());
         m_hijackedInterfaces.pop_back();
@@ -117,8 +399,8 @@ struct cmpDeviceAddress {
 
     cmpDeviceAddress(DeviceAddress *p) : addr(p) {}
 
-    bool operator()(std::map<int, DeviceVariable *>::value_type const &x) {
-        return x.second->address() == *addr;
+    bool operator()(DeviceVariable const *x) {
+        return x != NULL && x->address() == *addr;
     }
 };
 
@@ -126,6 +408,15 @@ struct cmpDeviceAddress {
 
 asynStatus Driver::drvUserCreate(asynUser *pasynUser, const char *reason,
                                  const char **, size_t *) {
+    asynStatus status = findOrCreateVariable(pasynUser, reason);
+    AUTOPARAM_PROBE4(param__create, portName,
+                     status == asynSuccess ? pasynUser->reason : -1, reason,
+                     status);
+    return status;
+}
+
+asynStatus Driver::findOrCreateVariable(asynUser *pasynUser,
+                                        const char *reason) {
     std::string function;
     std::string arguments;
     {
@@ -148,8 +439,28 @@ asynStatus Driver::drvUserCreate(asynUser *pasynUser, const char *reason,
         arguments = os.str();
     }
 
+    // Records with the same reason share the variable. Checking for them
+    // before parsing saves allocating an address only to discard it.
+    for (ParamMap::const_iterator i = m_params.begin(), end = m_params.end();
+         i != end; ++i) {
+        if (*i != NULL && (*i)->m_reasonString == reason) {
+            asynPrint(this->pasynUserSelf, ASYN_TRACE_FLOW,
+                      "%s: port=%s reusing an existing parameter for '%s'\n",
+                      driverName, portName, reason);
+            pasynUser->reason = (*i)->asynIndex();
+            joinGroup(*i, pasynUser);
+            return asynSuccess;
+        }
+    }
+
     // Let the driver subclass parse the arguments.
-    DeviceAddress *addr = parseDeviceAddress(function, arguments);
+    DeviceAddress *addr;
+    size_t addressBytes;
+    {
+        AllocationCounter counter;
+        addr = parseDeviceAddress(function, arguments);
+        addressBytes = counter.bytes();
+    }
     if (addr == NULL) {
         asynPrint(this->pasynUserSelf, ASYN_TRACE_ERROR,
                   "%s: port=%s could not parse '%s'\n", driverName, portName,
@@ -158,48 +469,136 @@ asynStatus Driver::drvUserCreate(asynUser *pasynUser, const char *reason,
     }
 
     // Let's check if we already have the variable.
+    DeviceVariable *var;
     ParamMap::iterator varIter =
         std::find_if(m_params.begin(), m_params.end(), cmpDeviceAddress(addr));
     if (varIter != m_params.end()) {
         asynPrint(this->pasynUserSelf, ASYN_TRACE_FLOW,
                   "%s: port=%s reusing an existing parameter for '%s'\n",
                   driverName, portName, reason);
-        pasynUser->reason = varIter->second->asynIndex();
+        var = *varIter;
+        pasynUser->reason = var->asynIndex();
         delete addr;
     } else {
-        // No var found, let's create a new one. It takes ownership of `addr`.
-        DeviceVariable baseVar = DeviceVariable(reason, function, addr);
+        std::map<std::string, asynParamType>::const_iterator functionIter =
+            m_functionTypes.find(function);
+        if (functionIter == m_functionTypes.end()) {
+            asynPrint(this->pasynUserSelf, ASYN_TRACE_ERROR,
+                      "%s: port=%s no handler registered for '%s'\n",
+                      driverName, portName, function.c_str());
+            delete addr;
+            return asynError;
+        }
+
         asynPrint(this->pasynUserSelf, ASYN_TRACE_FLOW,
                   "%s: port=%s creating a new parameter for '%s'\n", driverName,
-                  portName, baseVar.asString().c_str());
-
-        try {
-            baseVar.m_asynParamType = m_functionTypes.at(baseVar.function());
-        } catch (std::out_of_range const &) {
+                  portName, reason);
+        int index;
+        if (createParam(reason, functionIter->second, &index) != asynSuccess) {
             asynPrint(this->pasynUserSelf, ASYN_TRACE_ERROR,
-                      "%s: port=%s no handler registered for '%s'\n",
-                      driverName, portName, baseVar.function().c_str());
+                      "%s: port=%s could not create parameter for '%s'\n",
+                      driverName, portName, reason);
+            delete addr;
             return asynError;
         }
 
-        createParam(baseVar.asString().c_str(), baseVar.m_asynParamType,
-                    &baseVar.m_asynParamIndex);
+        // No var found, let's create a new one. It takes ownership of `addr`.
+        // The function name is interned by pointing to the map key.
+        DeviceVariable baseVar =
+            DeviceVariable(reason, &functionIter->first, addr);
+        baseVar.m_asynParamType = functionIter->second;
+        baseVar.m_asynParamIndex = index;
+        baseVar.m_handlers =
+            findHandlers(functionIter->second, functionIter->first);
+        baseVar.m_functionInfo = &m_functionInfo[functionIter->first];
 
         // Let the derived driver construct a subclass of DeviceVariable based
         // on ours. Takes ownership of stuff in our `baseVar`.
-        DeviceVariable *var = createDeviceVariable(&baseVar);
+        size_t variableBytes;
+        {
+            AllocationCounter counter;
+            var = createDeviceVariable(&baseVar);
+            variableBytes = counter.bytes();
+        }
         if (var == NULL) {
             asynPrint(this->pasynUserSelf, ASYN_TRACE_ERROR,
                       "%s: port=%s could not create DeviceVariable for '%s'\n",
-                      driverName, portName, baseVar.asString().c_str());
+                      driverName, portName, reason);
             return asynError;
         }
+        lock();
+        m_addressBytes += addressBytes;
+        m_variableBytes += variableBytes;
+        unlock();
 
+        if (m_params.size() <= static_cast<size_t>(var->asynIndex())) {
+            m_params.resize(var->asynIndex() + 1, NULL);
+        }
         m_params[var->asynIndex()] = var;
-        m_interruptRefcount[var] = 0;
         pasynUser->reason = var->asynIndex();
+
+        if (opts.circuitFailures > 0) {
+            std::string device = var->address().deviceName();
+            if (!device.empty()) {
+                std::map<std::string, DeviceState>::iterator i =
+                    m_devices.insert(std::make_pair(device, DeviceState()))
+                        .first;
+                i->second.name = &i->first;
+                i->second.vars.push_back(var);
+                var->m_device = &i->second;
+            }
+        }
+
+        if (opts.deviceGroups) {
+            std::string group = var->address().deviceGroup();
+            if (!group.empty()) {
+                var->m_group = findOrCreateGroup(group);
+            }
+        }
+        if (var->m_group == NULL && functionInfo(*var).opts.highPriority) {
+            var->m_group = m_lane;
+        }
+
+        std::string const &snapshot = functionInfo(*var).opts.snapshotGroup;
+        if (!snapshot.empty()) {
+            // Snapshots may already be taken from another thread.
+            lock();
+            findOrCreateSnapshot(snapshot)->m_variables.push_back(var);
+            unlock();
+        }
+
+        if (functionInfo(*var).opts.shadowRegister &&
+            var->asynType() == asynParamUInt32Digital) {
+            var->m_shadow = &m_shadows[var->asynIndex()];
+        }
+
+        std::string const &batch = functionInfo(*var).opts.writeBatch;
+        if (!batch.empty()) {
+            lock();
+            WriteBatch *members = findOrCreateBatch(batch);
+            if (members->addMember(*var)) {
+                var->m_batch = members;
+            } else {
+                asynPrint(this->pasynUserSelf, ASYN_TRACE_ERROR,
+                          "%s: port=%s %s cannot be a member of write batch "
+                          "'%s'\n",
+                          driverName, portName, var->asCString(),
+                          batch.c_str());
+            }
+            unlock();
+        }
+
+        if (functionInfo(*var).opts.pollPeriod > 0) {
+            // Polling threads may already be running.
+            lock();
+            PollState &poll = m_polls[var->asynIndex()];
+            poll.var = var;
+            var->m_poll = &poll;
+            unlock();
+        }
     }
 
+    joinGroup(var, pasynUser);
     return asynSuccess;
 }
 
@@ -208,12 +607,20 @@ void Driver::handleResultStatus(asynUser *pasynUser, ResultBase const &result) {
     setParamAlarmStatus(pasynUser->reason, result.alarmStatus);
     pasynUser->alarmSeverity = result.alarmSeverity;
     setParamAlarmSeverity(pasynUser->reason, result.alarmSeverity);
+
+    // The time stamp is also used by the interrupts processed afterwards.
+    if (result.timestamp.secPastEpoch != 0 || result.timestamp.nsec != 0) {
+        setTimeStamp(&result.timestamp);
+    } else {
+        updateTimeStamp();
+    }
+    getTimeStamp(&pasynUser->timestamp);
 }
 
 DeviceVariable *Driver::deviceVariableFromUser(asynUser *pasynUser) {
-    try {
-        return m_params.at(pasynUser->reason);
-    } catch (std::out_of_range const &) {
+    if (hasParam(pasynUser->reason)) {
+        return m_params[pasynUser->reason];
+    } else {
         char const *paramName;
         asynStatus status = getParamName(pasynUser->reason, &paramName);
         if (status == asynSuccess) {
@@ -237,11 +644,108 @@ std::vector<DeviceVariable *> Driver::getAllVariables() const {
     pvs.reserve(m_params.size());
     for (ParamMap::const_iterator i = m_params.begin(), end = m_params.end();
          i != end; ++i) {
-        pvs.push_back(i->second);
+        if (*i != NULL) {
+            pvs.push_back(*i);
+        }
     }
     return pvs;
 }
 
+namespace {
+
+// Approximates the memory taken by the nodes of a std::map: the value, the
+// links to the parent and the children, and the color of the node.
+template <typename Map> size_t mapNodeBytes(Map const &map) {
+    return map.size() * (sizeof(typename Map::value_type) + 4 * sizeof(void *));
+}
+
+} // namespace
+
+void Driver::memoryReport(FILE *fp) const {
+    Driver *self = const_cast<Driver *>(this);
+    self->lock();
+
+    size_t numVars = 0;
+    size_t stringBytes = 0;
+    for (ParamMap::const_iterator i = m_params.begin(), end = m_params.end();
+         i != end; ++i) {
+        if (*i != NULL) {
+            numVars++;
+            stringBytes += (*i)->m_reasonString.capacity() + 1;
+        }
+    }
+
+    size_t functionBytes = 0;
+    for (std::map<std::string, asynParamType>::const_iterator
+             i = m_functionTypes.begin(),
+             end = m_functionTypes.end();
+         i != end; ++i) {
+        functionBytes += i->first.capacity() + 1;
+    }
+
+    size_t deviceBytes = mapNodeBytes(m_devices);
+    for (std::map<std::string, DeviceState>::const_iterator
+             i = m_devices.begin(),
+             end = m_devices.end();
+         i != end; ++i) {
+        deviceBytes += i->first.capacity() + 1 +
+                       i->second.vars.capacity() * sizeof(DeviceVariable *);
+    }
+
+    size_t groupBytes = mapNodeBytes(m_groups);
+    for (std::map<std::string, DeviceGroup *>::const_iterator
+             i = m_groups.begin(),
+             end = m_groups.end();
+         i != end; ++i) {
+        groupBytes += i->first.capacity() + 1 + sizeof(DeviceGroup) +
+                      i->second->name.capacity() + 1 +
+                      i->second->portName.capacity() + 1;
+    }
+
+    size_t shadowBytes = mapNodeBytes(m_shadows);
+    size_t pollBytes = mapNodeBytes(m_polls);
+    size_t indexBytes = m_params.capacity() * sizeof(DeviceVariable *);
+    size_t total = m_variableBytes + m_addressBytes + stringBytes +
+                   indexBytes + functionBytes + deviceBytes + groupBytes +
+                   shadowBytes + pollBytes;
+
+    fprintf(fp, "%s: port=%s\n", driverName, portName);
+    fprintf(fp, "    device variables:        %lu\n", (unsigned long)numVars);
+    fprintf(fp, "    DeviceVariable objects:  %lu bytes\n",
+            (unsigned long)m_variableBytes);
+    fprintf(fp, "    DeviceAddress objects:   %lu bytes\n",
+            (unsigned long)m_addressBytes);
+    fprintf(fp, "    reason strings:          %lu bytes\n",
+            (unsigned long)stringBytes);
+    fprintf(fp, "    parameter index:         %lu bytes\n",
+            (unsigned long)indexBytes);
+    fprintf(fp, "    interned functions (%lu): %lu bytes\n",
+            (unsigned long)m_functionTypes.size(),
+            (unsigned long)functionBytes);
+    fprintf(fp, "    devices (%lu):            %lu bytes\n",
+            (unsigned long)m_devices.size(), (unsigned long)deviceBytes);
+    fprintf(fp, "    device groups (%lu):      %lu bytes\n",
+            (unsigned long)m_groups.size(), (unsigned long)groupBytes);
+    fprintf(fp, "    shadow registers (%lu):   %lu bytes\n",
+            (unsigned long)m_shadows.size(), (unsigned long)shadowBytes);
+    fprintf(fp, "    polled variables (%lu):   %lu bytes\n",
+            (unsigned long)m_polls.size(), (unsigned long)pollBytes);
+    fprintf(fp, "    arena:                   %lu of %lu bytes used\n",
+            (unsigned long)m_arena.bytesAllocated(),
+            (unsigned long)m_arena.bytesReserved());
+    fprintf(fp, "    flight recorder:         %lu bytes\n",
+            (unsigned long)(m_recorder.capacity() *
+                            (sizeof(FlightRecorder::Entry) + sizeof(size_t))));
+    fprintf(fp, "    total:                   %lu bytes",
+            (unsigned long)total);
+    if (numVars > 0) {
+        fprintf(fp, " (%.1f bytes per variable)", double(total) / numVars);
+    }
+    fprintf(fp, "\n");
+
+    self->unlock();
+}
+
 template <typename IntType>
 void Driver::getInterruptVarsForInterface(std::vector<DeviceVariable *> &dest,
                                           int canInterrupt, void *ifacePvt) {
@@ -286,6 +790,9 @@ std::vector<DeviceVariable *> Driver::getInterruptVariables() {
         vars, ifcs->float32ArrayCanInterrupt, ifcs->float32ArrayInterruptPvt);
     getInterruptVarsForInterface<asynFloat64ArrayInterrupt>(
         vars, ifcs->float64ArrayCanInterrupt, ifcs->float64ArrayInterruptPvt);
+    getInterruptVarsForInterface<asynGenericPointerInterrupt>(
+        vars, ifcs->genericPointerCanInterrupt,
+        ifcs->genericPointerInterruptPvt);
 
     // The list contains all records, so we need to remove duplicates.
     std::sort(vars.begin(), vars.end());
@@ -294,6 +801,47 @@ std::vector<DeviceVariable *> Driver::getInterruptVariables() {
     return vars;
 }
 
+std::vector<DeviceVariable *> Driver::getPollVariables() {
+    std::vector<DeviceVariable *> vars;
+    epicsUInt64 now = epicsMonotonicGet();
+
+    lock();
+    for (std::map<int, PollState>::iterator i = m_polls.begin(),
+                                            end = m_polls.end();
+         i != end; ++i) {
+        PollState &poll = i->second;
+        if (!poll.var->hasSubscribers()) {
+            // Nobody is listening. Poll as soon as somebody subscribes.
+            poll.next = 0;
+            continue;
+        }
+        if (now < poll.next) {
+            continue;
+        }
+        FunctionOpts const &opts = functionInfo(*poll.var).opts;
+        double period = opts.pollIdlePeriod > 0 && !poll.active
+                            ? opts.pollIdlePeriod
+                            : opts.pollPeriod;
+        poll.next = now + static_cast<epicsUInt64>(period * 1e9);
+        vars.push_back(poll.var);
+    }
+    unlock();
+
+    return vars;
+}
+
+void Driver::setPollActive(DeviceVariable const &var, bool active) {
+    lock();
+    PollState *poll = static_cast<PollState *>(var.m_poll);
+    if (poll != NULL && active != poll->active) {
+        poll->active = active;
+        if (active) {
+            poll->next = 0;
+        }
+    }
+    unlock();
+}
+
 template <typename Ptr, typename Other>
 static void assignPtr(Ptr *&ptr, Other *other) {
     ptr = reinterpret_cast<Ptr *>(other);
@@ -359,65 +907,48 @@ void Driver::installInterruptRegistrars() {
         ifcs->float32Array.pinterface);
     installAnInterruptRegistrar<asynFloat64Array, Array<epicsFloat64> >(
         ifcs->float64Array.pinterface);
+    installAnInterruptRegistrar<asynGenericPointer, GenericPointer>(
+        ifcs->genericPointer.pinterface);
 }
 
+// The handlers are looked up once, when the variable is created, so that
+// dispatching requests involves neither map lookups nor string comparisons.
+// Returns NULL if `var` is not of type `T`.
 template <typename T>
-typename Handlers<T>::ReadHandler
-Driver::getReadHandler(std::string const &function) {
-    typename Handlers<T>::ReadHandler handler;
-    try {
-        handler = getHandlerMap<T>().at(function).readHandler;
-    } catch (std::out_of_range const &) {
-        handler = NULL;
-    }
-    return handler;
-}
-
-template <typename T>
-typename Handlers<T>::WriteHandler
-Driver::getWriteHandler(std::string const &function) {
-    typename Handlers<T>::WriteHandler handler;
-    try {
-        handler = getHandlerMap<T>().at(function).writeHandler;
-    } catch (std::out_of_range const &) {
-        handler = NULL;
+Handlers<T> const *Driver::getHandlers(DeviceVariable const &var) const {
+    if (var.m_asynParamType != AsynType<T>::value) {
+        return NULL;
     }
-    return handler;
+    return static_cast<Handlers<T> const *>(var.m_handlers);
 }
 
+// This is called for every request, so it must not allocate, not even when
+// printing the error: a misconfigured record can be processed periodically.
 template <typename T>
-bool Driver::checkHandlersVerbosely(std::string const &function) {
-    try {
-        getHandlerMap<T>().at(function);
-    } catch (std::out_of_range &) {
-        std::stringstream msg;
-        msg << "record of DTYP " << getDtypName(AsynType<T>::value)
-            << " cannot handle function " << function << ". ";
-
-        try {
-            asynParamType type = m_functionTypes.at(function);
-            msg << "Perhaps you meant DTYP = " << getDtypName(type) << "?\n";
-        } catch (std::out_of_range &) {
-            msg << "No other DTYP can handle this either.\n";
-        }
-
-        asynPrint(pasynUserSelf, ASYN_TRACE_ERROR, "%s: port=%s %s.",
-                  driverName, portName, msg.str().c_str());
+bool Driver::checkHandlersVerbosely(DeviceVariable const &var) {
+    if (getHandlers<T>(var) == NULL) {
+        asynPrint(pasynUserSelf, ASYN_TRACE_ERROR,
+                  "%s: port=%s record of DTYP %s cannot handle function %s. "
+                  "Perhaps you meant DTYP = %s?\n",
+                  driverName, portName, getDtypName(AsynType<T>::value),
+                  var.function().c_str(), getDtypName(var.asynType()));
         return false;
     }
     return true;
 }
 
 bool Driver::hasParam(int index) {
-    return m_params.find(index) != m_params.end();
+    return index >= 0 && static_cast<size_t>(index) < m_params.size() &&
+           m_params[index] != NULL;
 }
 
-template <typename T> bool Driver::hasReadHandler(int index) {
-    return getReadHandler<T>(m_params.at(index)->function()) != NULL;
+template <typename T> bool Driver::hasReadHandler(DeviceVariable const &var) {
+    return getHandlers<T>(var)->readHandler != NULL;
 }
 
-template <typename T> bool Driver::hasWriteHandler(int index) {
-    return getWriteHandler<T>(m_params.at(index)->function()) != NULL;
+// Writes to members of a write batch are handled by the batch.
+template <typename T> bool Driver::hasWriteHandler(DeviceVariable const &var) {
+    return var.m_batch != NULL || getHandlers<T>(var)->writeHandler != NULL;
 }
 
 bool Driver::shouldProcessInterrupts(WriteResult const &result) const {
@@ -585,11 +1116,62 @@ Driver::getHandlerMap<Array<epicsFloat64> >() {
     return m_Float64ArrayHandlerMap;
 }
 
+template <>
+std::map<std::string, Handlers<GenericPointer> > &
+Driver::getHandlerMap<GenericPointer>() {
+    return m_GenericPointerHandlerMap;
+}
+
+// Returns the address of the handlers registered for `function`, type-erased
+// according to `type`. The pointer remains valid for the lifetime of the
+// driver because map nodes are never removed.
+void const *Driver::findHandlers(asynParamType type,
+                                 std::string const &function) {
+    switch (type) {
+    case asynParamInt32:
+        return findInMap(getHandlerMap<epicsInt32>(), function);
+    case asynParamInt64:
+        return findInMap(getHandlerMap<epicsInt64>(), function);
+    case asynParamUInt32Digital:
+        return findInMap(getHandlerMap<epicsUInt32>(), function);
+    case asynParamFloat64:
+        return findInMap(getHandlerMap<epicsFloat64>(), function);
+    case asynParamOctet:
+        return findInMap(getHandlerMap<Octet>(), function);
+    case asynParamInt8Array:
+        return findInMap(getHandlerMap<Array<epicsInt8> >(), function);
+    case asynParamInt16Array:
+        return findInMap(getHandlerMap<Array<epicsInt16> >(), function);
+    case asynParamInt32Array:
+        return findInMap(getHandlerMap<Array<epicsInt32> >(), function);
+    case asynParamInt64Array:
+        return findInMap(getHandlerMap<Array<epicsInt64> >(), function);
+    case asynParamFloat32Array:
+        return findInMap(getHandlerMap<Array<epicsFloat32> >(), function);
+    case asynParamFloat64Array:
+        return findInMap(getHandlerMap<Array<epicsFloat64> >(), function);
+    case asynParamGenericPointer:
+        return findInMap(getHandlerMap<GenericPointer>(), function);
+    default:
+        return NULL;
+    }
+}
+
 template <typename T>
 void Driver::registerHandlers(std::string const &function,
                               typename Handlers<T>::ReadHandler reader,
                               typename Handlers<T>::WriteHandler writer,
                               InterruptRegistrar intrRegistrar) {
+    registerHandlers<T>(function, reader, writer, intrRegistrar,
+                        FunctionOpts());
+}
+
+template <typename T>
+void Driver::registerHandlers(std::string const &function,
+                              typename Handlers<T>::ReadHandler reader,
+                              typename Handlers<T>::WriteHandler writer,
+                              InterruptRegistrar intrRegistrar,
+                              FunctionOpts const &functionOpts) {
     if (m_functionTypes.find(function) != m_functionTypes.end() &&
         m_functionTypes[function] != Handlers<T>::type) {
         asynPrint(this->pasynUserSelf, ASYN_TRACE_ERROR,
@@ -600,11 +1182,30 @@ void Driver::registerHandlers(std::string const &function,
                   getAsynTypeName(AsynType<T>::value));
         return;
     }
+    if (!functionOpts.writeBatch.empty() &&
+        (Handlers<T>::type == asynParamOctet ||
+         Handlers<T>::type == asynParamGenericPointer)) {
+        asynPrint(this->pasynUserSelf, ASYN_TRACE_ERROR,
+                  "%s: port=%s function %s of type %s cannot be a member of "
+                  "write batch '%s'\n",
+                  driverName, portName, function.c_str(),
+                  getAsynTypeName(AsynType<T>::value),
+                  functionOpts.writeBatch.c_str());
+        return;
+    }
 
     getHandlerMap<T>()[function].readHandler = reader;
     getHandlerMap<T>()[function].writeHandler = writer;
     getHandlerMap<T>()[function].intrRegistrar = intrRegistrar;
     m_functionTypes[function] = Handlers<T>::type;
+    m_functionInfo[function].opts = functionOpts;
+    if (functionOpts.deadline > 0) {
+        watchDeadlines();
+    }
+    if (functionOpts.highPriority && m_lane == NULL &&
+        (opts.asynFlags & ASYN_CANBLOCK)) {
+        createLane();
+    }
 }
 
 template AUTOPARAMDRIVER_API void epicsStdCall
@@ -666,103 +1267,215 @@ Driver::registerHandlers<Array<epicsFloat64> >(
     Handlers<Array<epicsFloat64> >::ReadHandler reader,
     Handlers<Array<epicsFloat64> >::WriteHandler writer,
     InterruptRegistrar intrRegistrar);
+template AUTOPARAMDRIVER_API void epicsStdCall
+Driver::registerHandlers<GenericPointer>(
+    std::string const &function, Handlers<GenericPointer>::ReadHandler reader,
+    Handlers<GenericPointer>::WriteHandler writer,
+    InterruptRegistrar intrRegistrar);
+template AUTOPARAMDRIVER_API void epicsStdCall
+Driver::registerHandlers<epicsInt32>(
+    std::string const &function, Handlers<epicsInt32>::ReadHandler reader,
+    Handlers<epicsInt32>::WriteHandler writer, InterruptRegistrar intrRegistrar,
+    FunctionOpts const &functionOpts);
+template AUTOPARAMDRIVER_API void epicsStdCall
+Driver::registerHandlers<epicsInt64>(
+    std::string const &function, Handlers<epicsInt64>::ReadHandler reader,
+    Handlers<epicsInt64>::WriteHandler writer, InterruptRegistrar intrRegistrar,
+    FunctionOpts const &functionOpts);
+template AUTOPARAMDRIVER_API void epicsStdCall
+Driver::registerHandlers<epicsFloat64>(
+    std::string const &function, Handlers<epicsFloat64>::ReadHandler reader,
+    Handlers<epicsFloat64>::WriteHandler writer,
+    InterruptRegistrar intrRegistrar, FunctionOpts const &functionOpts);
+template AUTOPARAMDRIVER_API void epicsStdCall
+Driver::registerHandlers<epicsUInt32>(
+    std::string const &function, Handlers<epicsUInt32>::ReadHandler reader,
+    Handlers<epicsUInt32>::WriteHandler writer,
+    InterruptRegistrar intrRegistrar, FunctionOpts const &functionOpts);
+template AUTOPARAMDRIVER_API void epicsStdCall
+Driver::registerHandlers<Octet>(
+    std::string const &function, Handlers<Octet>::ReadHandler reader,
+    Handlers<Octet>::WriteHandler writer, InterruptRegistrar intrRegistrar,
+    FunctionOpts const &functionOpts);
+template AUTOPARAMDRIVER_API void epicsStdCall
+Driver::registerHandlers<Array<epicsInt8> >(
+    std::string const &function,
+    Handlers<Array<epicsInt8> >::ReadHandler reader,
+    Handlers<Array<epicsInt8> >::WriteHandler writer,
+    InterruptRegistrar intrRegistrar, FunctionOpts const &functionOpts);
+template AUTOPARAMDRIVER_API void epicsStdCall
+Driver::registerHandlers<Array<epicsInt16> >(
+    std::string const &function,
+    Handlers<Array<epicsInt16> >::ReadHandler reader,
+    Handlers<Array<epicsInt16> >::WriteHandler writer,
+    InterruptRegistrar intrRegistrar, FunctionOpts const &functionOpts);
+template AUTOPARAMDRIVER_API void epicsStdCall
+Driver::registerHandlers<Array<epicsInt32> >(
+    std::string const &function,
+    Handlers<Array<epicsInt32> >::ReadHandler reader,
+    Handlers<Array<epicsInt32> >::WriteHandler writer,
+    InterruptRegistrar intrRegistrar, FunctionOpts const &functionOpts);
+template AUTOPARAMDRIVER_API void epicsStdCall
+Driver::registerHandlers<Array<epicsInt64> >(
+    std::string const &function,
+    Handlers<Array<epicsInt64> >::ReadHandler reader,
+    Handlers<Array<epicsInt64> >::WriteHandler writer,
+    InterruptRegistrar intrRegistrar, FunctionOpts const &functionOpts);
+template AUTOPARAMDRIVER_API void epicsStdCall
+Driver::registerHandlers<Array<epicsFloat32> >(
+    std::string const &function,
+    Handlers<Array<epicsFloat32> >::ReadHandler reader,
+    Handlers<Array<epicsFloat32> >::WriteHandler writer,
+    InterruptRegistrar intrRegistrar, FunctionOpts const &functionOpts);
+template AUTOPARAMDRIVER_API void epicsStdCall
+Driver::registerHandlers<Array<epicsFloat64> >(
+    std::string const &function,
+    Handlers<Array<epicsFloat64> >::ReadHandler reader,
+    Handlers<Array<epicsFloat64> >::WriteHandler writer,
+    InterruptRegistrar intrRegistrar, FunctionOpts const &functionOpts);
+template AUTOPARAMDRIVER_API void epicsStdCall
+Driver::registerHandlers<GenericPointer>(
+    std::string const &function, Handlers<GenericPointer>::ReadHandler reader,
+    Handlers<GenericPointer>::WriteHandler writer,
+    InterruptRegistrar intrRegistrar, FunctionOpts const &functionOpts);
 
 template <typename T>
 asynStatus Driver::doCallbacksArray(DeviceVariable const &var, Array<T> &value,
                                     asynStatus status, int alarmStatus,
-                                    int alarmSeverity) {
-    if (!checkHandlersVerbosely<Array<T> >(var.function())) {
+                                    int alarmSeverity,
+                                    epicsTimeStamp const *timestamp) {
+    if (!checkHandlersVerbosely<Array<T> >(var)) {
         return asynError;
     }
     setParamStatus(var.asynIndex(), status);
     setParamAlarmStatus(var.asynIndex(), alarmStatus);
     setParamAlarmSeverity(var.asynIndex(), alarmSeverity);
+    if (timestamp != NULL) {
+        setTimeStamp(timestamp);
+    }
     return doCallbacksArrayDispatch(var.asynIndex(), value);
 }
 
 template AUTOPARAMDRIVER_API asynStatus epicsStdCall
 Driver::doCallbacksArray<epicsInt8>(DeviceVariable const &var,
                                     Array<epicsInt8> &value, asynStatus status,
-                                    int alarmStatus, int alarmSeverity);
+                                    int alarmStatus, int alarmSeverity,
+                                    epicsTimeStamp const *timestamp);
 template AUTOPARAMDRIVER_API asynStatus epicsStdCall
 Driver::doCallbacksArray<epicsInt16>(DeviceVariable const &var,
                                      Array<epicsInt16> &value,
                                      asynStatus status, int alarmStatus,
-                                     int alarmSeverity);
+                                     int alarmSeverity,
+                                     epicsTimeStamp const *timestamp);
 template AUTOPARAMDRIVER_API asynStatus epicsStdCall
 Driver::doCallbacksArray<epicsInt32>(DeviceVariable const &var,
                                      Array<epicsInt32> &value,
                                      asynStatus status, int alarmStatus,
-                                     int alarmSeverity);
+                                     int alarmSeverity,
+                                     epicsTimeStamp const *timestamp);
 template AUTOPARAMDRIVER_API asynStatus epicsStdCall
 Driver::doCallbacksArray<epicsInt64>(DeviceVariable const &var,
                                      Array<epicsInt64> &value,
                                      asynStatus status, int alarmStatus,
-                                     int alarmSeverity);
+                                     int alarmSeverity,
+                                     epicsTimeStamp const *timestamp);
 template AUTOPARAMDRIVER_API asynStatus epicsStdCall
 Driver::doCallbacksArray<epicsFloat32>(DeviceVariable const &var,
                                        Array<epicsFloat32> &value,
                                        asynStatus status, int alarmStatus,
-                                       int alarmSeverity);
+                                       int alarmSeverity,
+                                       epicsTimeStamp const *timestamp);
 template AUTOPARAMDRIVER_API asynStatus epicsStdCall
 Driver::doCallbacksArray<epicsFloat64>(DeviceVariable const &var,
                                        Array<epicsFloat64> &value,
                                        asynStatus status, int alarmStatus,
-                                       int alarmSeverity);
+                                       int alarmSeverity,
+                                       epicsTimeStamp const *timestamp);
+
+asynStatus Driver::doCallbacksGenericPointer(DeviceVariable const &var,
+                                             GenericPointer value,
+                                             asynStatus status, int alarmStatus,
+                                             int alarmSeverity,
+                                             epicsTimeStamp const *timestamp) {
+    if (!checkHandlersVerbosely<GenericPointer>(var)) {
+        return asynError;
+    }
+    setParamStatus(var.asynIndex(), status);
+    setParamAlarmStatus(var.asynIndex(), alarmStatus);
+    setParamAlarmSeverity(var.asynIndex(), alarmSeverity);
+    if (timestamp != NULL) {
+        setTimeStamp(timestamp);
+    }
+    return asynPortDriver::doCallbacksGenericPointer(value.get(),
+                                                     var.asynIndex(), 0);
+}
 
 template <typename T>
 asynStatus Driver::setParam(DeviceVariable const &var, T value,
                             asynStatus status, int alarmStatus,
-                            int alarmSeverity) {
-    if (!checkHandlersVerbosely<T>(var.function())) {
+                            int alarmSeverity,
+                            epicsTimeStamp const *timestamp) {
+    if (!checkHandlersVerbosely<T>(var)) {
         return asynError;
     }
     setParamStatus(var.asynIndex(), status);
     setParamAlarmStatus(var.asynIndex(), alarmStatus);
     setParamAlarmSeverity(var.asynIndex(), alarmSeverity);
+    if (timestamp != NULL) {
+        setTimeStamp(timestamp);
+    }
     return setParamDispatch(var.asynIndex(), value);
 }
 
 asynStatus Driver::setParam(DeviceVariable const &var, epicsUInt32 value,
                             epicsUInt32 mask, asynStatus status,
-                            int alarmStatus, int alarmSeverity) {
-    if (!checkHandlersVerbosely<epicsUInt32>(var.function())) {
+                            int alarmStatus, int alarmSeverity,
+                            epicsTimeStamp const *timestamp) {
+    if (!checkHandlersVerbosely<epicsUInt32>(var)) {
         return asynError;
     }
     setParamStatus(var.asynIndex(), status);
     setParamAlarmStatus(var.asynIndex(), alarmStatus);
     setParamAlarmSeverity(var.asynIndex(), alarmSeverity);
+    if (timestamp != NULL) {
+        setTimeStamp(timestamp);
+    }
     return setUIntDigitalParam(var.asynIndex(), value, mask);
 }
 
 template AUTOPARAMDRIVER_API asynStatus epicsStdCall
 Driver::setParam<epicsInt32>(DeviceVariable const &var, epicsInt32 value,
                              asynStatus status, int alarmStatus,
-                             int alarmSeverity);
+                             int alarmSeverity,
+                             epicsTimeStamp const *timestamp);
 template AUTOPARAMDRIVER_API asynStatus epicsStdCall
 Driver::setParam<epicsInt64>(DeviceVariable const &var, epicsInt64 value,
                              asynStatus status, int alarmStatus,
-                             int alarmSeverity);
+                             int alarmSeverity,
+                             epicsTimeStamp const *timestamp);
 template AUTOPARAMDRIVER_API asynStatus epicsStdCall
 Driver::setParam<epicsFloat64>(DeviceVariable const &var, epicsFloat64 value,
                                asynStatus status, int alarmStatus,
-                               int alarmSeverity);
+                               int alarmSeverity,
+                               epicsTimeStamp const *timestamp);
 template AUTOPARAMDRIVER_API asynStatus epicsStdCall
 Driver::setParam<Octet>(DeviceVariable const &var, Octet value,
-                        asynStatus status, int alarmStatus, int alarmSeverity);
+                        asynStatus status, int alarmStatus, int alarmSeverity,
+                        epicsTimeStamp const *timestamp);
 
 template <>
 AUTOPARAMDRIVER_API asynStatus epicsStdCall Driver::setParam<epicsUInt32>(
     DeviceVariable const &var, epicsUInt32 value, asynStatus status,
-    int alarmStatus, int alarmSeverity) {
-    return setParam(var, value, 0xffffffff, status, alarmStatus, alarmSeverity);
+    int alarmStatus, int alarmSeverity, epicsTimeStamp const *timestamp) {
+    return setParam(var, value, 0xffffffff, status, alarmStatus, alarmSeverity,
+                    timestamp);
 }
 
 template <typename T>
 asynStatus Driver::getParam(DeviceVariable const &var, T &value,
                             asynStatus &status, int &alarmStatus,
                             int &alarmSeverity) {
-  if (!checkHandlersVerbosely<T>(var.function())) {
+  if (!checkHandlersVerbosely<T>(var)) {
     return asynError;
   }
   getParamStatus(var.asynIndex(), &status);
@@ -774,7 +1487,7 @@ asynStatus Driver::getParam(DeviceVariable const &var, T &value,
 asynStatus Driver::getParam(DeviceVariable const &var, epicsUInt32 &value,
                             epicsUInt32 mask, asynStatus &status,
                             int &alarmStatus, int &alarmSeverity) {
-    if (!checkHandlersVerbosely<epicsUInt32>(var.function())) {
+    if (!checkHandlersVerbosely<epicsUInt32>(var)) {
         return asynError;
     }
     getParamStatus(var.asynIndex(), &status);
@@ -785,7 +1498,7 @@ asynStatus Driver::getParam(DeviceVariable const &var, epicsUInt32 &value,
 
 template <typename T>
 asynStatus Driver::getParam(DeviceVariable const &var, T &value) {
-  if (!checkHandlersVerbosely<T>(var.function())) {
+  if (!checkHandlersVerbosely<T>(var)) {
     return asynError;
   }
   return getParamDispatch(var.asynIndex(), value);
@@ -793,7 +1506,7 @@ asynStatus Driver::getParam(DeviceVariable const &var, T &value) {
 
 asynStatus Driver::getParam(DeviceVariable const &var, epicsUInt32 &value,
                             epicsUInt32 mask) {
-    if (!checkHandlersVerbosely<epicsUInt32>(var.function())) {
+    if (!checkHandlersVerbosely<epicsUInt32>(var)) {
         return asynError;
     }
     return getUIntDigitalParam(var.asynIndex(), &value, mask);
@@ -844,24 +1557,32 @@ asynStatus Driver::registerInterrupt(void *drvPvt, asynUser *pasynUser,
                                            void **registrarPvt);
     RegisterIntrFunc original = reinterpret_cast<RegisterIntrFunc>(
         self->m_originalIntrRegister.at(AsynType<T>::value).first);
+    // Interrupt sources only exist on the driver's own port.
+    bool left = self->leaveGroup(var, pasynUser);
     asynStatus status =
         original(drvPvt, pasynUser, callback, userPvt, registrarPvt);
-    if (status != asynSuccess) {
+    if (left) {
+        self->joinGroup(var, pasynUser);
+    }
+    if (status != asynSuccess || var == NULL) {
+        AUTOPARAM_PROBE4(interrupt__register, self->portName,
+                         pasynUser->reason, 0, status);
         return status;
     }
 
-    self->m_interruptRefcount[var] += 1;
+    var->m_interruptRefcount += 1;
 
-    if (self->m_interruptRefcount[var] == 1) {
-        if (!self->checkHandlersVerbosely<T>(var->function())) {
-            return asynError;
+    if (var->m_interruptRefcount == 1) {
+        InterruptRegistrar registrar = NULL;
+        if (!self->checkHandlersVerbosely<T>(*var)) {
+            status = asynError;
+        } else {
+            registrar = self->getHandlers<T>(*var)->intrRegistrar;
         }
-        InterruptRegistrar registrar =
-            self->getHandlerMap<T>().at(var->function()).intrRegistrar;
         if (registrar != NULL) {
             asynPrint(self->pasynUserSelf, ASYN_TRACE_FLOW,
                       "%s: port=%s registering interrupt handler for '%s'\n",
-                      driverName, self->portName, var->asString().c_str());
+                      driverName, self->portName, var->asCString());
             status = registrar(*var, false);
             if (status != asynSuccess) {
                 asynPrint(
@@ -869,12 +1590,13 @@ asynStatus Driver::registerInterrupt(void *drvPvt, asynUser *pasynUser,
                     "%s: port=%s error %d calling interrupt registrar for "
                     "'%s'\n",
                     driverName, self->portName, status,
-                    var->asString().c_str());
-                return status;
+                    var->asCString());
             }
         }
     }
 
+    AUTOPARAM_PROBE4(interrupt__register, self->portName, var->asynIndex(),
+                     var->m_interruptRefcount, status);
     return status;
 }
 
@@ -889,32 +1611,38 @@ asynStatus Driver::cancelInterrupt(void *drvPvt, asynUser *pasynUser,
                                          void *registrarPvt);
     CancelIntrFunc original = reinterpret_cast<CancelIntrFunc>(
         self->m_originalIntrRegister.at(AsynType<T>::value).second);
+    // Interrupt sources only exist on the driver's own port.
+    bool left = self->leaveGroup(var, pasynUser);
     asynStatus status = original(drvPvt, pasynUser, registrarPvt);
-    if (status != asynSuccess) {
+    if (left) {
+        self->joinGroup(var, pasynUser);
+    }
+    if (status != asynSuccess || var == NULL) {
+        AUTOPARAM_PROBE4(interrupt__cancel, self->portName,
+                         pasynUser->reason, 0, status);
         return status;
     }
 
-    self->m_interruptRefcount[var] -= 1;
+    var->m_interruptRefcount -= 1;
 
-    if (self->m_interruptRefcount[var] < 0) {
+    if (var->m_interruptRefcount < 0) {
         asynPrint(self->pasynUserSelf, ASYN_TRACE_ERROR,
                   "%s: port=%s logic error: interrupt refcount negative for"
                   "'%s'\n",
-                  driverName, self->portName, var->asString().c_str());
-        self->m_interruptRefcount[var] = 0;
-        return asynError;
-    }
-
-    if (self->m_interruptRefcount[var] == 0) {
-        if (!self->checkHandlersVerbosely<T>(var->function())) {
-            return asynError;
+                  driverName, self->portName, var->asCString());
+        var->m_interruptRefcount = 0;
+        status = asynError;
+    } else if (var->m_interruptRefcount == 0) {
+        InterruptRegistrar registrar = NULL;
+        if (!self->checkHandlersVerbosely<T>(*var)) {
+            status = asynError;
+        } else {
+            registrar = self->getHandlers<T>(*var)->intrRegistrar;
         }
-        InterruptRegistrar registrar =
-            self->getHandlerMap<T>().at(var->function()).intrRegistrar;
         if (registrar != NULL) {
             asynPrint(self->pasynUserSelf, ASYN_TRACE_FLOW,
                       "%s: port=%s cancelling interrupt handler for '%s'\n",
-                      driverName, self->portName, var->asString().c_str());
+                      driverName, self->portName, var->asCString());
             status = registrar(*var, true);
             if (status != asynSuccess) {
                 asynPrint(
@@ -922,12 +1650,13 @@ asynStatus Driver::cancelInterrupt(void *drvPvt, asynUser *pasynUser,
                     "%s: port=%s error %d calling interrupt registrar for "
                     "'%s'\n",
                     driverName, self->portName, status,
-                    var->asString().c_str());
-                return status;
+                    var->asCString());
             }
         }
     }
 
+    AUTOPARAM_PROBE4(interrupt__cancel, self->portName, var->asynIndex(),
+                     var->m_interruptRefcount, status);
     return status;
 }
 
@@ -945,24 +1674,32 @@ asynStatus Driver::registerInterruptDigital(void *drvPvt, asynUser *pasynUser,
         epicsUInt32 mask, void **registrarPvt);
     RegisterIntrFunc original = reinterpret_cast<RegisterIntrFunc>(
         self->m_originalIntrRegister.at(AsynType<T>::value).first);
+    // Interrupt sources only exist on the driver's own port.
+    bool left = self->leaveGroup(var, pasynUser);
     asynStatus status =
         original(drvPvt, pasynUser, callback, userPvt, mask, registrarPvt);
-    if (status != asynSuccess) {
+    if (left) {
+        self->joinGroup(var, pasynUser);
+    }
+    if (status != asynSuccess || var == NULL) {
+        AUTOPARAM_PROBE4(interrupt__register, self->portName,
+                         pasynUser->reason, 0, status);
         return status;
     }
 
-    self->m_interruptRefcount[var] += 1;
+    var->m_interruptRefcount += 1;
 
-    if (self->m_interruptRefcount[var] == 1) {
-        if (!self->checkHandlersVerbosely<T>(var->function())) {
-            return asynError;
+    if (var->m_interruptRefcount == 1) {
+        InterruptRegistrar registrar = NULL;
+        if (!self->checkHandlersVerbosely<T>(*var)) {
+            status = asynError;
+        } else {
+            registrar = self->getHandlers<T>(*var)->intrRegistrar;
         }
-        InterruptRegistrar registrar =
-            self->getHandlerMap<T>().at(var->function()).intrRegistrar;
         if (registrar != NULL) {
             asynPrint(self->pasynUserSelf, ASYN_TRACE_FLOW,
                       "%s: port=%s registering interrupt handler for '%s'\n",
-                      driverName, self->portName, var->asString().c_str());
+                      driverName, self->portName, var->asCString());
             status = registrar(*var, false);
             if (status != asynSuccess) {
                 asynPrint(
@@ -970,21 +1707,1255 @@ asynStatus Driver::registerInterruptDigital(void *drvPvt, asynUser *pasynUser,
                     "%s: port=%s error %d calling interrupt registrar for "
                     "'%s'\n",
                     driverName, self->portName, status,
-                    var->asString().c_str());
-                return status;
+                    var->asCString());
             }
         }
     }
 
+    AUTOPARAM_PROBE4(interrupt__register, self->portName, var->asynIndex(),
+                     var->m_interruptRefcount, status);
     return status;
 }
 
+namespace {
+
+char const *requestKindName(int kind) {
+    return kind == RequestRead ? "read" : "write";
+}
+
+// Converts a time given by epicsMonotonicGet() to wall clock time, relative to
+// a pair of readings of both clocks taken at the same time.
+epicsTimeStamp monotonicToWallClock(epicsUInt64 mono, epicsUInt64 monoNow,
+                                    epicsTimeStamp const &now) {
+    epicsTimeStamp ts = now;
+    epicsTimeAddSeconds(&ts, -1e-9 * static_cast<double>(monoNow - mono));
+    return ts;
+}
+
+void writeJsonString(FILE *fp, char const *str) {
+    fputc('"', fp);
+    for (; *str; ++str) {
+        unsigned char c = *str;
+        if (c == '"' || c == '\\') {
+            fprintf(fp, "\\%c", c);
+        } else if (c < 0x20) {
+            fprintf(fp, "\\u%04x", c);
+        } else {
+            fputc(c, fp);
+        }
+    }
+    fputc('"', fp);
+}
+
+} // namespace
+
+Driver::FunctionInfo &Driver::functionInfo(DeviceVariable const &var) {
+    return *static_cast<FunctionInfo *>(var.m_functionInfo);
+}
+
+void Driver::initRequest(DeviceVariable const &var, RequestKind kind,
+                         asynUser const *pasynUser, Request &request) {
+    if (kind == RequestRead) {
+        AUTOPARAM_PROBE3(read__entry, portName, var.asynIndex(),
+                         var.function().c_str());
+    } else {
+        AUTOPARAM_PROBE3(write__entry, portName, var.asynIndex(),
+                         var.function().c_str());
+    }
+
+    request.var = &var;
+    request.kind = kind;
+    request.overrunReported = false;
+    request.rejected = false;
+    request.probe = false;
+    request.groupLocked = false;
+    request.staged = false;
+    request.prev = NULL;
+    request.next = NULL;
+    request.start = epicsMonotonicGet();
+    request.end = request.start;
+    request.replay =
+        m_replay != NULL && pasynUser != NULL && pasynUser->userPvt == m_replay
+            ? m_replay
+            : NULL;
+}
+
+// The handler of a variable in a device group runs with the group locked
+// instead of the driver, unless `switchToGroup` is false.
+bool Driver::beginRequest(DeviceVariable const &var, RequestKind kind,
+                          asynUser const *pasynUser, Request &request,
+                          bool switchToGroup) {
+    initRequest(var, kind, pasynUser, request);
+    if (var.m_device != NULL &&
+        !admitRequest(*static_cast<DeviceState *>(var.m_device), request)) {
+        request.rejected = true;
+        return false;
+    }
+    epicsAtomicIncrSizeT(&m_active);
+
+    if (functionInfo(var).opts.deadline > 0) {
+        m_inFlightLock.lock();
+        request.next = m_inFlight;
+        if (m_inFlight != NULL) {
+            m_inFlight->prev = &request;
+        }
+        m_inFlight = &request;
+        m_inFlightLock.unlock();
+    }
+
+    // Let other groups proceed while the handler is running.
+    if (switchToGroup && var.m_group != NULL &&
+        static_cast<DeviceGroup *>(var.m_group)->unlocked) {
+        request.groupLocked = true;
+        unlock();
+        static_cast<DeviceGroup *>(var.m_group)->lock.lock();
+    }
+    return true;
+}
+
+void Driver::endRequest(Request &request, ResultBase &result) {
+    epicsUInt64 end = epicsMonotonicGet();
+    request.end = end;
+    DeviceVariable const &var = *request.var;
+    if (request.groupLocked) {
+        static_cast<DeviceGroup *>(var.m_group)->lock.unlock();
+        lock();
+    }
+    if (request.kind == RequestRead) {
+        AUTOPARAM_PROBE3(read__return, portName, var.asynIndex(),
+                         result.status);
+    } else {
+        AUTOPARAM_PROBE3(write__return, portName, var.asynIndex(),
+                         result.status);
+    }
+
+    FlightRecorder::Entry entry;
+    entry.start = request.start;
+    entry.duration = end - request.start;
+    entry.asynIndex = var.asynIndex();
+    entry.kind = request.kind;
+    entry.type = var.m_asynParamType;
+    entry.status = result.status;
+    m_recorder.record(entry);
+    FunctionInfo &info = functionInfo(var);
+    if (result.status != asynSuccess) {
+        epicsAtomicIncrSizeT(&info.errors[request.kind]);
+    }
+    if (request.rejected) {
+        return;
+    }
+
+    epicsAtomicDecrSizeT(&m_active);
+    bool highPriority = var.m_group != NULL && var.m_group == m_lane;
+    m_laneServiceTime[highPriority][request.kind].add(entry.duration);
+    info.latency[request.kind].add(entry.duration);
+
+    if (var.m_device != NULL && request.staged) {
+        // Only the commit tells whether the device works; it probes the
+        // device again if needed.
+        if (request.probe) {
+            m_deviceLock.lock();
+            static_cast<DeviceState *>(var.m_device)->probing = false;
+            m_deviceLock.unlock();
+        }
+    } else if (var.m_device != NULL) {
+        updateCircuit(*static_cast<DeviceState *>(var.m_device), request,
+                      result.status);
+    }
+
+    size_t suppressed;
+    if (m_slowRequests.add(entry, suppressed)) {
+        // errlog is buffered, unlike asynPrint which writes synchronously.
+        char more[40] = "";
+        if (suppressed > 0) {
+            sprintf(more, " (%lu more not logged)", (unsigned long)suppressed);
+        }
+        errlogPrintf("%s: port=%s slow %s of '%s': %.3f ms, status %d%s\n",
+                     driverName, portName, requestKindName(request.kind),
+                     var.asCString(), entry.duration / 1e6,
+                     result.status, more);
+    }
+
+    if (info.opts.deadline <= 0) {
+        return;
+    }
+
+    m_inFlightLock.lock();
+    if (request.prev != NULL) {
+        request.prev->next = request.next;
+    } else {
+        m_inFlight = request.next;
+    }
+    if (request.next != NULL) {
+        request.next->prev = request.prev;
+    }
+    bool reported = request.overrunReported;
+    m_inFlightLock.unlock();
+
+    if (entry.duration <= info.opts.deadline * 1e9) {
+        return;
+    }
+    epicsAtomicIncrSizeT(&info.overruns);
+    if (!reported) {
+        errlogPrintf("%s: port=%s %s of '%s' took %.3f s, deadline is %.3f s\n",
+                     driverName, portName, requestKindName(request.kind),
+                     var.asCString(), entry.duration / 1e9,
+                     info.opts.deadline);
+    }
+    if (info.opts.deadlineAlarm && result.alarmStatus == epicsAlarmNone) {
+        result.alarmStatus = epicsAlarmTimeout;
+        result.alarmSeverity = epicsSevInvalid;
+    }
+}
+
+asynStatus Driver::rejectRequest(asynUser *pasynUser, Request &request) {
+    ResultBase result;
+    result.status = asynDisconnected;
+    result.alarmStatus = opts.circuitAlarmStatus;
+    result.alarmSeverity = opts.circuitAlarmSeverity;
+    endRequest(request, result);
+    handleResultStatus(pasynUser, result);
+    return result.status;
+}
+
+// Requests that reach the driver through the wrong interface, e.g. a record
+// with the wrong DTYP, still show up in probes and the flight recorder.
+asynStatus Driver::rejectRequest(asynUser *pasynUser, DeviceVariable const &var,
+                                 RequestKind kind) {
+    Request request;
+    initRequest(var, kind, pasynUser, request);
+    request.rejected = true;
+    ResultBase result;
+    result.status = asynError;
+    endRequest(request, result);
+    return result.status;
+}
+
+namespace {
+
+// Copy the value of a replayed call to the result of a read handler, or to
+// the value of a replayed write request.
+template <typename T> void restoreValue(TrafficCall const &call, T &value) {
+    if (call.data.size() == sizeof(T)) {
+        std::memcpy(&value, &call.data[0], sizeof(T));
+    }
+}
+
+template <typename T>
+void restoreArray(TrafficCall const &call, Array<T> &value) {
+    size_t size = std::min(call.data.size() / sizeof(T), value.maxSize());
+    if (size > 0) {
+        std::memcpy(value.data(), &call.data[0], size * sizeof(T));
+    }
+    value.setSize(size);
+}
+
+} // namespace
+
+// Called instead of the handler; returns NULL if the handler should be called
+// after all.
+TrafficCall const *Driver::replayCall(Request &request, ResultBase &result) {
+    if (request.replay == NULL) {
+        return NULL;
+    }
+    TrafficCall const *call = request.replay->next(*request.var, request.kind);
+    if (call == NULL) {
+        return NULL;
+    }
+    if (request.replay->speed > 0 && call->duration > 0) {
+        epicsThreadSleep(call->duration * 1e-9 / request.replay->speed);
+    }
+    result.status = static_cast<asynStatus>(call->status);
+    result.alarmStatus = static_cast<epicsAlarmCondition>(call->alarmStatus);
+    result.alarmSeverity =
+        static_cast<epicsAlarmSeverity>(call->alarmSeverity);
+    result.processInterrupts.value =
+        static_cast<ProcessInterrupts::ValueType>(call->processInterrupts);
+    result.timestamp = call->timestamp;
+    return call;
+}
+
+// Called after endRequest(), so the driver is locked.
+void Driver::captureCall(Request const &request, ResultBase const &result,
+                         void const *data, size_t size, epicsUInt32 mask) {
+    if (m_capture == NULL) {
+        return;
+    }
+    TrafficCall call;
+    call.variable = request.var->asynIndex();
+    call.kind = request.kind;
+    call.status = result.status;
+    call.alarmStatus = result.alarmStatus;
+    call.alarmSeverity = result.alarmSeverity;
+    call.processInterrupts = result.processInterrupts.value;
+    call.mask = mask;
+    call.start = m_capture->sinceStart(request.start);
+    call.duration = request.end - request.start;
+    call.timestamp = result.timestamp;
+    m_capture->record(*request.var, call, data, size);
+}
+
+bool Driver::admitRequest(DeviceState &device, Request &request) {
+    bool admit = true;
+    m_deviceLock.lock();
+    if (device.open) {
+        // Let a single request through once per probe interval to find out
+        // whether the device is back.
+        if (!device.probing && request.start >= device.nextProbe) {
+            device.probing = true;
+            request.probe = true;
+        } else {
+            admit = false;
+        }
+    }
+    m_deviceLock.unlock();
+    return admit;
+}
+
+void Driver::updateCircuit(DeviceState &device, Request const &request,
+                           asynStatus status) {
+    bool failed = status == asynTimeout || status == asynDisconnected ||
+                  status == asynError;
+    epicsUInt64 nextProbe =
+        epicsMonotonicGet() +
+        static_cast<epicsUInt64>(opts.circuitProbeInterval * 1e9);
+    bool changed = false;
+
+    m_deviceLock.lock();
+    if (request.probe) {
+        device.probing = false;
+    }
+    if (failed) {
+        device.failures++;
+        if (device.open) {
+            device.nextProbe = nextProbe;
+        } else if (device.failures >= opts.circuitFailures) {
+            device.open = true;
+            device.nextProbe = nextProbe;
+            changed = true;
+        }
+    } else {
+        device.failures = 0;
+        if (device.open) {
+            device.open = false;
+            changed = true;
+        }
+    }
+    m_deviceLock.unlock();
+
+    if (changed) {
+        errlogPrintf(device.open ? "%s: port=%s device '%s' is not responding, "
+                                   "failing its requests\n"
+                                 : "%s: port=%s device '%s' is responding "
+                                   "again\n",
+                     driverName, portName, device.name->c_str());
+        setDeviceStatus(device);
+    }
+}
+
+// Called from handler dispatch, so the driver is locked.
+void Driver::setDeviceStatus(DeviceState &device) {
+    asynStatus status = device.open ? asynDisconnected : asynSuccess;
+    int alarmStatus = device.open ? opts.circuitAlarmStatus : epicsAlarmNone;
+    int alarmSeverity = device.open ? opts.circuitAlarmSeverity : epicsSevNone;
+    for (std::vector<DeviceVariable *>::const_iterator i = device.vars.begin(),
+                                                       end = device.vars.end();
+         i != end; ++i) {
+        setParamStatus((*i)->asynIndex(), status);
+        setParamAlarmStatus((*i)->asynIndex(), alarmStatus);
+        setParamAlarmSeverity((*i)->asynIndex(), alarmSeverity);
+    }
+    callParamCallbacks();
+}
+
+void Driver::deviceReport(FILE *fp) {
+    fprintf(fp, "%s: port=%s\n", driverName, portName);
+    fprintf(fp, "%-24s %-7s %9s %10s\n", "device", "circuit", "failures",
+            "variables");
+    m_deviceLock.lock();
+    for (std::map<std::string, DeviceState>::const_iterator
+             i = m_devices.begin(),
+             end = m_devices.end();
+         i != end; ++i) {
+        fprintf(fp, "%-24s %-7s %9d %10lu\n", i->first.c_str(),
+                i->second.open ? "open" : "closed", i->second.failures,
+                (unsigned long)i->second.vars.size());
+    }
+    m_deviceLock.unlock();
+}
+
+// asyn doesn't give access to the threads of ports, so the settings are applied
+// by a request which the port's thread handles, even if the port is not
+// connected.
+void Driver::applyThreadOptions(char const *port) {
+    if (opts.cpuAffinity.empty() &&
+        opts.schedPolicy == DriverOpts::SchedDefault) {
+        return;
+    }
+    asynUser *pasynUser =
+        pasynManager->createAsynUser(applyThreadOptionsCallback, NULL);
+    pasynUser->userPvt = this;
+    asynStatus status = pasynManager->connectDevice(pasynUser, port, -1);
+    if (status == asynSuccess) {
+        status =
+            pasynManager->queueRequest(pasynUser, asynQueuePriorityConnect, 0);
+    }
+    if (status != asynSuccess) {
+        asynPrint(pasynUserSelf, ASYN_TRACE_ERROR,
+                  "%s: port=%s could not set up the thread of port %s: %s\n",
+                  driverName, portName, port, pasynUser->errorMessage);
+        pasynManager->freeAsynUser(pasynUser);
+    }
+}
+
+// The priority of threads the library creates for the driver.
+unsigned int Driver::threadPriority() const {
+    return opts.priority > 0 ? opts.priority : epicsThreadPriorityMedium;
+}
+
+void Driver::adoptThreadOptions(char const *name) {
+    if (opts.cpuAffinity.empty() &&
+        opts.schedPolicy == DriverOpts::SchedDefault) {
+        return;
+    }
+    Autoparam::applyThreadOptions(name, opts.cpuAffinity, opts.schedPolicy,
+                                  opts.schedPriority);
+}
+
+void Driver::applyThreadOptionsCallback(asynUser *pasynUser) {
+    Driver *self = static_cast<Driver *>(pasynUser->userPvt);
+    char const *port;
+    if (pasynManager->getPortName(pasynUser, &port) == asynSuccess) {
+        Autoparam::applyThreadOptions(port, self->opts.cpuAffinity,
+                                      self->opts.schedPolicy,
+                                      self->opts.schedPriority);
+    }
+    pasynManager->disconnect(pasynUser);
+    pasynManager->freeAsynUser(pasynUser);
+}
+
+asynCommon Driver::groupCommon = {Driver::groupReport, Driver::groupConnect,
+                                  Driver::groupDisconnect};
+
+void Driver::groupReport(void *drvPvt, FILE *fp, int) {
+    DeviceGroup *group = static_cast<DeviceGroup *>(drvPvt);
+    fprintf(fp, "Handles %s of port %s\n", group->name.c_str(),
+            group->driver->portName);
+}
+
+asynStatus Driver::groupConnect(void *, asynUser *pasynUser) {
+    pasynManager->exceptionConnect(pasynUser);
+    return asynSuccess;
+}
+
+asynStatus Driver::groupDisconnect(void *, asynUser *pasynUser) {
+    pasynManager->exceptionDisconnect(pasynUser);
+    return asynSuccess;
+}
+
+// Each group is an asyn port of its own, so that it gets its own request queue
+// and thread. The port exposes the interfaces of the driver's port, so device
+// support doesn't notice that requests are handled by a different port.
+// Returns NULL if the port could not be created.
+Driver::DeviceGroup *Driver::createGroup(std::string const &name,
+                                         std::string const &groupPortName,
+                                         unsigned int priority, bool unlocked) {
+    DeviceGroup *group = new DeviceGroup;
+    group->driver = this;
+    group->name = name;
+    group->portName = groupPortName;
+    group->unlocked = unlocked;
+    group->common.interfaceType = asynCommonType;
+    group->common.pinterface = &groupCommon;
+    group->common.drvPvt = group;
+
+    group->addr = -1;
+    group->pasynUser = pasynManager->createAsynUser(NULL, NULL);
+
+    asynInterface *interfaces[maxForwardedInterfaces];
+    size_t numInterfaces =
+        getForwardedInterfaces(getAsynStdInterfaces(), interfaces);
+
+    char const *groupPort = group->portName.c_str();
+    asynStatus status = pasynManager->registerPort(groupPort, ASYN_CANBLOCK, 1,
+                                                   priority, opts.stackSize);
+    if (status == asynSuccess) {
+        status = pasynManager->registerInterface(groupPort, &group->common);
+    }
+    for (size_t j = 0; j < numInterfaces && status == asynSuccess; ++j) {
+        status = pasynManager->registerInterface(groupPort, interfaces[j]);
+    }
+    if (status == asynSuccess) {
+        status = pasynManager->connectDevice(group->pasynUser, groupPort, -1);
+    }
+    if (status == asynSuccess) {
+        applyThreadOptions(groupPort);
+    }
+    if (status != asynSuccess) {
+        asynPrint(pasynUserSelf, ASYN_TRACE_ERROR,
+                  "%s: port=%s could not create port %s for %s\n", driverName,
+                  portName, groupPort, name.c_str());
+        pasynManager->freeAsynUser(group->pasynUser);
+        delete group;
+        return NULL;
+    }
+    return group;
+}
+
+Driver::DeviceGroup *Driver::findOrCreateGroup(std::string const &name) {
+    std::map<std::string, DeviceGroup *>::iterator i = m_groups.find(name);
+    if (i != m_groups.end()) {
+        return i->second;
+    }
+    DeviceGroup *group =
+        createGroup("device group '" + name + "'",
+                    std::string(portName) + ":" + name, opts.priority, true);
+    m_groups[name] = group;
+    return group;
+}
+
+Snapshot *Driver::findOrCreateSnapshot(std::string const &name) {
+    std::map<std::string, Snapshot *>::iterator i = m_snapshots.find(name);
+    if (i != m_snapshots.end()) {
+        return i->second;
+    }
+    Snapshot *snapshot = new Snapshot(this, name);
+    m_snapshots[name] = snapshot;
+    return snapshot;
+}
+
+void Driver::registerSnapshotHandler(std::string const &name,
+                                     SnapshotHandler handler) {
+    lock();
+    findOrCreateSnapshot(name)->m_handler = handler;
+    unlock();
+}
+
+asynStatus Driver::takeSnapshot(std::string const &name) {
+    lock();
+    std::map<std::string, Snapshot *>::iterator i = m_snapshots.find(name);
+    if (i == m_snapshots.end() || i->second->m_handler == NULL) {
+        unlock();
+        asynPrint(pasynUserSelf, ASYN_TRACE_ERROR,
+                  "%s: port=%s no handler for snapshot group '%s'\n",
+                  driverName, portName, name.c_str());
+        return asynError;
+    }
+    Snapshot &snapshot = *i->second;
+
+    for (std::map<int, Snapshot::PendingArray>::iterator
+             j = snapshot.m_arrays.begin(),
+             end = snapshot.m_arrays.end();
+         j != end; ++j) {
+        j->second.set = false;
+    }
+    snapshot.timestamp.secPastEpoch = 0;
+    snapshot.timestamp.nsec = 0;
+
+    asynStatus status = snapshot.m_handler(snapshot);
+
+    if (snapshot.timestamp.secPastEpoch == 0 && snapshot.timestamp.nsec == 0) {
+        updateTimeStamp();
+        getTimeStamp(&snapshot.timestamp);
+    } else {
+        setTimeStamp(&snapshot.timestamp);
+    }
+
+    if (status != asynSuccess) {
+        for (std::vector<DeviceVariable *>::const_iterator
+                 j = snapshot.m_variables.begin(),
+                 end = snapshot.m_variables.end();
+             j != end; ++j) {
+            setParamStatus((*j)->asynIndex(), status);
+        }
+    }
+    callParamCallbacks();
+
+    for (std::map<int, Snapshot::PendingArray>::iterator
+             j = snapshot.m_arrays.begin(),
+             end = snapshot.m_arrays.end();
+         j != end; ++j) {
+        Snapshot::PendingArray &pending = j->second;
+        if (pending.set) {
+            pending.publish(*this, *pending.var, pending.data, pending.size,
+                            status);
+        }
+    }
+    unlock();
+    return status;
+}
+
+WriteBatch *Driver::findOrCreateBatch(std::string const &name) {
+    std::map<std::string, WriteBatch *>::iterator i = m_batches.find(name);
+    if (i != m_batches.end()) {
+        return i->second;
+    }
+    WriteBatch *batch = new WriteBatch(this, name);
+    m_batches[name] = batch;
+    return batch;
+}
+
+void Driver::registerBatchHandler(std::string const &name,
+                                  BatchWriteHandler handler, double window) {
+    lock();
+    WriteBatch *batch = findOrCreateBatch(name);
+    batch->m_handler = handler;
+    batch->m_window = window;
+    bool startThread = window > 0 && !batch->m_threadStarted;
+    batch->m_threadStarted = batch->m_threadStarted || startThread;
+    unlock();
+    if (startThread) {
+        epicsThreadCreate("autoparamBatch", threadPriority(),
+                          epicsThreadGetStackSize(epicsThreadStackSmall),
+                          runBatchWindow, batch);
+    }
+}
+
+// Called by write requests of members after beginRequest(), which leaves the
+// driver locked for them.
+void Driver::stageWrite(Request &request, void const *data, size_t bytes,
+                        size_t size, epicsUInt32 mask) {
+    DeviceVariable &var = const_cast<DeviceVariable &>(*request.var);
+    WriteBatch &batch = *static_cast<WriteBatch *>(var.m_batch);
+    bool first = batch.m_order.empty();
+    batch.stage(var, data, bytes, size, mask);
+    if (first && batch.m_window > 0) {
+        batch.m_wakeup.signal();
+    }
+    request.staged = true;
+}
+
+void Driver::runBatchWindow(void *arg) {
+    WriteBatch *batch = static_cast<WriteBatch *>(arg);
+    Driver *driver = batch->m_driver;
+    driver->adoptThreadOptions((std::string(driver->portName) + ":batch:" +
+                                batch->m_name)
+                                   .c_str());
+    for (;;) {
+        batch->m_wakeup.wait();
+        driver->lock();
+        bool quit = batch->m_quit;
+        double window = batch->m_window;
+        driver->unlock();
+        if (quit) {
+            break;
+        }
+        // Writes collected in the meantime are committed together.
+        epicsThreadSleep(window);
+        driver->commitBatch(batch->m_name);
+    }
+    batch->m_done.signal();
+}
+
+asynStatus Driver::commitBatch(std::string const &name) {
+    lock();
+    std::map<std::string, WriteBatch *>::iterator i = m_batches.find(name);
+    if (i == m_batches.end() || i->second->m_handler == NULL) {
+        unlock();
+        asynPrint(pasynUserSelf, ASYN_TRACE_ERROR,
+                  "%s: port=%s no handler for write batch '%s'\n",
+                  driverName, portName, name.c_str());
+        return asynError;
+    }
+    WriteBatch &batch = *i->second;
+    if (batch.m_order.empty() || batch.m_quit) {
+        unlock();
+        return asynSuccess;
+    }
+
+    // Each write is a request of its own, recorded and counted against its
+    // device like any other. Writes to devices that are failing are left out
+    // of the commit. The handler runs with the driver locked, so requests
+    // don't switch to device groups.
+    if (m_batchRequests.size() < batch.size()) {
+        m_batchRequests.resize(batch.size());
+    }
+    size_t admitted = 0;
+    for (size_t j = 0; j < batch.size(); ++j) {
+        WriteBatch::Write &write = batch.write(j);
+        Request &request = m_batchRequests[admitted];
+        if (beginRequest(*write.var, RequestWrite, NULL, request, false)) {
+            batch.m_order[admitted++] = batch.m_order[j];
+            continue;
+        }
+        write.result.status = asynDisconnected;
+        write.result.alarmStatus = opts.circuitAlarmStatus;
+        write.result.alarmSeverity = opts.circuitAlarmSeverity;
+        endRequest(request, write.result);
+        setParamResult(*write.var, write.result);
+        write.staged = false;
+    }
+    batch.m_order.resize(admitted);
+
+    asynStatus status = asynDisconnected;
+    if (admitted > 0) {
+        status = batch.m_handler(batch);
+    }
+
+    for (size_t j = 0; j < batch.size(); ++j) {
+        WriteBatch::Write &write = batch.write(j);
+        WriteResult &result = write.result;
+        if (status != asynSuccess && result.status == asynSuccess) {
+            result.status = status;
+        }
+        endRequest(m_batchRequests[j], result);
+        if (shouldProcessInterrupts(result)) {
+            write.publish(*this, *write.var, write.data, write.size,
+                          write.mask);
+        }
+        setParamResult(*write.var, result);
+    }
+    callParamCallbacks();
+    batch.clear();
+    unlock();
+    return status;
+}
+
+void Driver::setParamResult(DeviceVariable const &var,
+                            ResultBase const &result) {
+    setParamStatus(var.asynIndex(), result.status);
+    setParamAlarmStatus(var.asynIndex(), result.alarmStatus);
+    setParamAlarmSeverity(var.asynIndex(), result.alarmSeverity);
+}
+
+asynStatus Driver::watchDescriptor(int fd, DescriptorHandler handler,
+                                   void *arg) {
+    lock();
+    if (m_eventLoop == NULL) {
+        m_eventLoop = new EventLoop(this);
+    }
+    asynStatus status = m_eventLoop->add(fd, handler, arg);
+    unlock();
+    return status;
+}
+
+asynStatus Driver::unwatchDescriptor(int fd) {
+    lock();
+    asynStatus status =
+        m_eventLoop != NULL ? m_eventLoop->remove(fd) : asynError;
+    unlock();
+    return status;
+}
+
+// The lane's thread runs just above the driver's, so that it gets the driver
+// lock first when both are waiting for it.
+void Driver::createLane() {
+    unsigned int priority = threadPriority();
+    unsigned int higher;
+    if (epicsThreadLowestPriorityLevelAbove(priority, &higher) ==
+        epicsThreadBooleanStatusSuccess) {
+        priority = higher;
+    }
+    m_lane = createGroup("high priority functions",
+                         std::string(portName) + ":high", priority, false);
+}
+
+// Connects `pasynUser` to a different port. If that fails, `pasynUser` stays
+// connected to its current port.
+asynStatus Driver::moveUser(asynUser *pasynUser, char const *port, int addr) {
+    char const *currentPort;
+    int currentAddr;
+    asynStatus status = pasynManager->getPortName(pasynUser, &currentPort);
+    if (status == asynSuccess) {
+        status = pasynManager->getAddr(pasynUser, &currentAddr);
+    }
+    if (status == asynSuccess) {
+        status = pasynManager->disconnect(pasynUser);
+    }
+    if (status != asynSuccess) {
+        return status;
+    }
+    status = pasynManager->connectDevice(pasynUser, port, addr);
+    if (status != asynSuccess) {
+        pasynManager->connectDevice(pasynUser, currentPort, currentAddr);
+    }
+    return status;
+}
+
+// Returns the group or the thread pool that handles requests for `var`, or
+// NULL if the driver's own port does.
+Driver::DeviceGroup *Driver::groupOf(DeviceVariable const *var) const {
+    if (var == NULL) {
+        return NULL;
+    }
+    if (var->m_group != NULL) {
+        return static_cast<DeviceGroup *>(var->m_group);
+    }
+    return m_pool;
+}
+
+void Driver::joinGroup(DeviceVariable const *var, asynUser *pasynUser) {
+    DeviceGroup *group = groupOf(var);
+    if (group == NULL) {
+        return;
+    }
+    if (moveUser(pasynUser, group->portName.c_str(), group->addr) !=
+        asynSuccess) {
+        asynPrint(pasynUserSelf, ASYN_TRACE_ERROR,
+                  "%s: port=%s could not move '%s' to port %s: %s\n",
+                  driverName, portName, var->asCString(),
+                  group->portName.c_str(), pasynUser->errorMessage);
+    }
+}
+
+// Returns true if `pasynUser` was moved from the group's port to the driver's.
+bool Driver::leaveGroup(DeviceVariable const *var, asynUser *pasynUser) {
+    DeviceGroup *group = groupOf(var);
+    char const *port;
+    if (group == NULL ||
+        pasynManager->getPortName(pasynUser, &port) != asynSuccess ||
+        group->portName != port) {
+        return false;
+    }
+    return moveUser(pasynUser, portName, -1) == asynSuccess;
+}
+
+bool Driver::createThreadPool(std::string const &name, int threads,
+                              unsigned int priority, unsigned int stackSize) {
+    if (threads < 1) {
+        errlogPrintf("%s: thread pool '%s' needs at least one thread\n",
+                     driverName, name.c_str());
+        return false;
+    }
+
+    threadPoolLock().lock();
+    if (threadPools().count(name) != 0) {
+        threadPoolLock().unlock();
+        errlogPrintf("%s: thread pool '%s' already exists\n", driverName,
+                     name.c_str());
+        return false;
+    }
+
+    ThreadPool &pool = threadPools()[name];
+    for (int n = 0; n < threads; ++n) {
+        std::ostringstream os;
+        os << name << ":" << n;
+        PoolThread *thread = new PoolThread;
+        thread->portName = os.str();
+        thread->common.interfaceType = asynCommonType;
+        thread->common.pinterface = &poolCommon;
+        thread->common.drvPvt = thread;
+        thread->load = 0;
+        thread->drivers = 0;
+
+        char const *threadPort = thread->portName.c_str();
+        if (pasynManager->registerPort(threadPort,
+                                       ASYN_CANBLOCK | ASYN_MULTIDEVICE, 1,
+                                       priority, stackSize) != asynSuccess) {
+            errlogPrintf("%s: could not create port %s for thread pool "
+                         "'%s'\n",
+                         driverName, threadPort, name.c_str());
+            delete thread;
+            break;
+        }
+        pasynManager->registerInterface(threadPort, &thread->common);
+        pool.threads.push_back(thread);
+    }
+
+    bool created = !pool.threads.empty();
+    if (!created) {
+        threadPools().erase(name);
+    }
+    threadPoolLock().unlock();
+    return created;
+}
+
+// Assigns the driver to the least loaded thread of its pool, and exposes the
+// driver's interfaces as a device of the thread's port. Returns NULL if that
+// fails.
+Driver::DeviceGroup *Driver::joinThreadPool() {
+    threadPoolLock().lock();
+    if (threadPools().count(opts.threadPool) == 0) {
+        createThreadPool(opts.threadPool, std::max(epicsThreadGetCPUs(), 1),
+                         opts.priority, opts.stackSize);
+    }
+    std::map<std::string, ThreadPool>::iterator poolIter =
+        threadPools().find(opts.threadPool);
+    if (poolIter == threadPools().end()) {
+        threadPoolLock().unlock();
+        return NULL;
+    }
+    std::vector<PoolThread *> const &threads = poolIter->second.threads;
+    PoolThread *thread = threads.front();
+    for (size_t n = 1; n < threads.size(); ++n) {
+        if (threads[n]->load < thread->load) {
+            thread = threads[n];
+        }
+    }
+    thread->load += opts.threadPoolWeight;
+    int addr = thread->drivers++;
+    threadPoolLock().unlock();
+
+    DeviceGroup *group = new DeviceGroup;
+    group->driver = this;
+    group->name = opts.threadPool;
+    group->portName = thread->portName;
+    group->addr = addr;
+    group->pasynUser = pasynManager->createAsynUser(NULL, NULL);
+
+    asynInterface *interfaces[maxForwardedInterfaces];
+    size_t numInterfaces =
+        getForwardedInterfaces(getAsynStdInterfaces(), interfaces);
+
+    char const *threadPort = group->portName.c_str();
+    asynStatus status = asynSuccess;
+    for (size_t j = 0; j < numInterfaces && status == asynSuccess; ++j) {
+        asynInterface *previous;
+        status = pasynManager->interposeInterface(threadPort, addr,
+                                                  interfaces[j], &previous);
+    }
+    if (status == asynSuccess) {
+        status =
+            pasynManager->connectDevice(group->pasynUser, threadPort, addr);
+    }
+    if (status != asynSuccess) {
+        asynPrint(pasynUserSelf, ASYN_TRACE_ERROR,
+                  "%s: port=%s could not join thread pool '%s'\n", driverName,
+                  portName, opts.threadPool.c_str());
+        pasynManager->freeAsynUser(group->pasynUser);
+        delete group;
+        return NULL;
+    }
+
+    asynPrint(pasynUserSelf, ASYN_TRACE_FLOW,
+              "%s: port=%s handled by port %s, address %d\n", driverName,
+              portName, threadPort, addr);
+    return group;
+}
+
+void Driver::laneReport(FILE *fp) const {
+    static char const *const lanes[] = {"normal", "high"};
+    size_t counts[2][2][LatencyHistogram::numBuckets];
+    for (int lane = 0; lane < 2; ++lane) {
+        for (int kind = 0; kind < 2; ++kind) {
+            m_laneServiceTime[lane][kind].snapshot(counts[lane][kind]);
+        }
+    }
+
+    fprintf(fp, "%s: port=%s, lane service time\n", driverName, portName);
+    fprintf(fp, "%-13s", "service time");
+    for (int lane = 0; lane < 2; ++lane) {
+        for (int kind = 0; kind < 2; ++kind) {
+            fprintf(fp, " %6s %-5s", lanes[lane], requestKindName(kind));
+        }
+    }
+    fputc('\n', fp);
+    for (size_t bucket = 0; bucket < LatencyHistogram::numBuckets; ++bucket) {
+        size_t total = counts[0][0][bucket] + counts[0][1][bucket] +
+                       counts[1][0][bucket] + counts[1][1][bucket];
+        if (total == 0) {
+            continue;
+        }
+        LatencyHistogram::printBucket(fp, bucket);
+        for (int lane = 0; lane < 2; ++lane) {
+            for (int kind = 0; kind < 2; ++kind) {
+                fprintf(fp, " %12lu",
+                        (unsigned long)counts[lane][kind][bucket]);
+            }
+        }
+        fputc('\n', fp);
+    }
+}
+
+bool Driver::startCapture(char const *path) {
+    TrafficCapture *capture = TrafficCapture::create(path);
+    if (capture == NULL) {
+        asynPrint(pasynUserSelf, ASYN_TRACE_ERROR,
+                  "%s: port=%s cannot create capture file %s\n", driverName,
+                  portName, path);
+        return false;
+    }
+    stopCapture();
+    lock();
+    m_capture = capture;
+    unlock();
+    return true;
+}
+
+void Driver::stopCapture() {
+    lock();
+    TrafficCapture *capture = m_capture;
+    m_capture = NULL;
+    unlock();
+    if (capture == NULL) {
+        return;
+    }
+    if (capture->failed()) {
+        errlogPrintf("%s: port=%s capture stopped after %lu calls, some of "
+                     "which could not be written\n",
+                     driverName, portName, (unsigned long)capture->calls());
+    } else {
+        errlogPrintf("%s: port=%s capture stopped after %lu calls\n",
+                     driverName, portName, (unsigned long)capture->calls());
+    }
+    delete capture;
+}
+
+asynStatus Driver::replayTraffic(char const *path, double speed, FILE *fp) {
+    std::string error;
+    TrafficReplay *replay = TrafficReplay::load(path, error);
+    if (replay == NULL) {
+        fprintf(fp, "Cannot replay %s: %s\n", path, error.c_str());
+        return asynError;
+    }
+    replay->speed = speed > 0 ? speed : 0;
+
+    lock();
+    bool busy = m_replay != NULL;
+    if (!busy) {
+        m_replay = replay;
+    }
+    unlock();
+    if (busy) {
+        fprintf(fp, "Cannot replay %s: another replay is running\n", path);
+        delete replay;
+        return asynError;
+    }
+
+    // The users are tagged so that only their requests get recorded results.
+    std::vector<TrafficReplay::Variable> const &vars = replay->variables();
+    std::vector<ClientUser> users(vars.size());
+    for (size_t i = 0; i < vars.size(); ++i) {
+        connectClient(users[i], portName, vars[i].name, vars[i].type, NULL,
+                      replay);
+    }
+
+    std::vector<TrafficCall> const &calls = replay->calls();
+    std::vector<char> buffer;
+    LatencyHistogram latency;
+    size_t issued = 0;
+    size_t differing = 0;
+    epicsUInt64 begin = epicsMonotonicGet();
+    for (size_t i = 0; i < calls.size(); ++i) {
+        TrafficCall const &call = calls[i];
+        ClientUser const &user = users[call.variable];
+        if (user.iface == NULL) {
+            continue;
+        }
+        if (replay->speed > 0) {
+            double due =
+                (call.start - calls.front().start) * 1e-9 / replay->speed;
+            double now = (epicsMonotonicGet() - begin) * 1e-9;
+            if (due > now) {
+                epicsThreadSleep(due - now);
+            }
+        }
+        // A read is given as much room as the recorded value took.
+        buffer.assign(call.data.begin(), call.data.end());
+        epicsUInt64 start = epicsMonotonicGet();
+        asynStatus status = clientRequest(
+            user, static_cast<RequestKind>(call.kind), buffer, call.mask);
+        latency.add(epicsMonotonicGet() - start);
+        issued++;
+        if (status != call.status) {
+            differing++;
+        }
+    }
+    double elapsed = (epicsMonotonicGet() - begin) * 1e-9;
+
+    // Requests are issued synchronously, so none of them refers to the
+    // replay any more.
+    lock();
+    m_replay = NULL;
+    unlock();
+
+    for (size_t i = 0; i < users.size(); ++i) {
+        disconnectClient(users[i]);
+    }
+
+    fprintf(fp, "%s: port=%s replayed %lu of %lu calls in %.3f s", driverName,
+            portName, (unsigned long)issued, (unsigned long)calls.size(),
+            elapsed);
+    if (elapsed > 0) {
+        fprintf(fp, " (%.0f calls/s)", issued / elapsed);
+    }
+    fprintf(fp, ", %lu with a different status\n", (unsigned long)differing);
+    if (issued < calls.size()) {
+        fprintf(fp, "Calls of variables that could not be connected or are "
+                    "generic pointers were skipped\n");
+    }
+
+    fprintf(fp, "%-13s %12s\n", "duration", "requests");
+    latency.report(fp);
+    delete replay;
+    return asynSuccess;
+}
+
+void Driver::watchDeadlines() {
+    watchdogLock().lock();
+    if (!m_watched) {
+        m_watched = true;
+        watchedDrivers().push_back(this);
+    }
+    static bool started = false;
+    if (!started) {
+        started = true;
+        epicsThreadCreate("autoparamWatchdog", epicsThreadPriorityHigh,
+                          epicsThreadGetStackSize(epicsThreadStackSmall),
+                          runWatchdog, NULL);
+    }
+    watchdogLock().unlock();
+}
+
+void Driver::runWatchdog(void *) {
+    for (;;) {
+        epicsThreadSleep(watchdogPeriod);
+        epicsUInt64 now = epicsMonotonicGet();
+        watchdogLock().lock();
+        std::vector<Driver *> &drivers = watchedDrivers();
+        for (std::vector<Driver *>::iterator i = drivers.begin(),
+                                             end = drivers.end();
+             i != end; ++i) {
+            (*i)->checkDeadlines(now);
+        }
+        watchdogLock().unlock();
+    }
+}
+
+void Driver::checkDeadlines(epicsUInt64 now) {
+    m_inFlightLock.lock();
+    for (Request *request = m_inFlight; request != NULL;
+         request = request->next) {
+        double deadline = functionInfo(*request->var).opts.deadline;
+        if (request->overrunReported ||
+            now - request->start <= deadline * 1e9) {
+            continue;
+        }
+        request->overrunReported = true;
+        errlogPrintf("%s: port=%s %s of '%s' is still running after %.3f s, "
+                     "deadline is %.3f s\n",
+                     driverName, portName, requestKindName(request->kind),
+                     request->var->asCString(),
+                     (now - request->start) / 1e9, deadline);
+    }
+    m_inFlightLock.unlock();
+}
+
+void Driver::deadlineReport(FILE *fp) const {
+    fprintf(fp, "%s: port=%s\n", driverName, portName);
+    fprintf(fp, "%-24s %12s %10s\n", "function", "deadline/s", "overruns");
+    for (std::map<std::string, FunctionInfo>::const_iterator
+             i = m_functionInfo.begin(),
+             end = m_functionInfo.end();
+         i != end; ++i) {
+        if (i->second.opts.deadline > 0) {
+            fprintf(fp, "%-24s %12.3f %10lu\n", i->first.c_str(),
+                    i->second.opts.deadline,
+                    (unsigned long)epicsAtomicGetSizeT(&i->second.overruns));
+        }
+    }
+}
+
+char const *Driver::variableName(int index) const {
+    if (index < 0 || static_cast<size_t>(index) >= m_params.size() ||
+        m_params[index] == NULL) {
+        return "?";
+    }
+    return m_params[index]->asCString();
+}
+
+void Driver::flightRecorderReport(FILE *fp, size_t count) const {
+    std::vector<FlightRecorder::Entry> entries;
+    size_t total = m_recorder.snapshot(entries, count);
+    epicsTimeStamp now;
+    epicsTimeGetCurrent(&now);
+    epicsUInt64 monoNow = epicsMonotonicGet();
+
+    fprintf(fp, "%s: port=%s, %lu of %lu requests\n", driverName, portName,
+            (unsigned long)entries.size(), (unsigned long)total);
+    if (entries.empty()) {
+        return;
+    }
+    fprintf(fp, "%-26s %-5s %-10s %12s %6s  %s\n", "time", "kind", "type",
+            "duration/us", "status", "variable");
+    for (std::vector<FlightRecorder::Entry>::const_iterator i =
+             entries.begin();
+         i != entries.end(); ++i) {
+        char timeStr[40];
+        epicsTimeStamp ts = monotonicToWallClock(i->start, monoNow, now);
+        epicsTimeToStrftime(timeStr, sizeof(timeStr), "%Y-%m-%d %H:%M:%S.%06f",
+                            &ts);
+        fprintf(fp, "%-26s %-5s %-10s %12.3f %6d  %s\n", timeStr,
+                requestKindName(i->kind),
+                getAsynTypeName(static_cast<asynParamType>(i->type)),
+                i->duration / 1e3, i->status, variableName(i->asynIndex));
+    }
+}
+
+void Driver::flightRecorderTrace(FILE *fp) const {
+    std::vector<FlightRecorder::Entry> entries;
+    m_recorder.snapshot(entries, m_recorder.capacity());
+
+    // Timestamps are given in microseconds of the monotonic clock, which is
+    // fine because only their differences are shown.
+    fprintf(fp, "{\"traceEvents\":[\n");
+    fprintf(fp, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,"
+                "\"args\":{\"name\":");
+    writeJsonString(fp, portName);
+    fprintf(fp, "}}");
+    for (std::vector<FlightRecorder::Entry>::const_iterator i =
+             entries.begin();
+         i != entries.end(); ++i) {
+        fprintf(fp, ",\n{\"name\":");
+        writeJsonString(fp, variableName(i->asynIndex));
+        fprintf(fp,
+                ",\"cat\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":1,"
+                "\"ts\":%.3f,\"dur\":%.3f,\"args\":{\"type\":\"%s\","
+                "\"index\":%d,\"status\":%d",
+                requestKindName(i->kind), i->start / 1e3, i->duration / 1e3,
+                getAsynTypeName(static_cast<asynParamType>(i->type)),
+                i->asynIndex, i->status);
+        fprintf(fp, "}}");
+    }
+    fprintf(fp, "\n],\"displayTimeUnit\":\"ns\"}\n");
+}
+
+void Driver::slowRequestReport(FILE *fp) const {
+    std::vector<SlowRequestTracker::Entry> entries;
+    m_slowRequests.snapshot(entries);
+
+    fprintf(fp, "%s: port=%s, %lu slowest requests\n", driverName, portName,
+            (unsigned long)entries.size());
+    if (entries.empty()) {
+        return;
+    }
+    fprintf(fp, "%-26s %-5s %12s %6s  %s\n", "time", "kind", "duration/us",
+            "status", "variable");
+    for (std::vector<SlowRequestTracker::Entry>::const_iterator i =
+             entries.begin();
+         i != entries.end(); ++i) {
+        char timeStr[40];
+        epicsTimeToStrftime(timeStr, sizeof(timeStr), "%Y-%m-%d %H:%M:%S.%06f",
+                            &i->time);
+        fprintf(fp, "%-26s %-5s %12.3f %6d  %s\n", timeStr,
+                requestKindName(i->kind), i->duration / 1e3, i->status,
+                variableName(i->asynIndex));
+    }
+}
+
+void Driver::resetSlowRequests() { m_slowRequests.reset(); }
+
+void Driver::setSlowRequestLogging(double threshold, double minInterval) {
+    m_slowRequests.setLogging(threshold, minInterval);
+}
+
 template <typename T>
 asynStatus Driver::readScalar(asynUser *pasynUser, T *value) {
     DeviceVariable *var = deviceVariableFromUser(pasynUser);
     typename Handlers<T>::ReadHandler handler =
-        getReadHandler<T>(var->function());
-    typename Handlers<T>::ReadResult result = handler(*var);
+        getHandlers<T>(*var)->readHandler;
+    Request request;
+    if (!beginRequest(*var, RequestRead, pasynUser, request)) {
+        return rejectRequest(pasynUser, request);
+    }
+    typename Handlers<T>::ReadResult result;
+    if (TrafficCall const *call = replayCall(request, result)) {
+        restoreValue(*call, result.value);
+    } else {
+        result = handler(*var);
+    }
+    endRequest(request, result);
+    captureCall(request, result, &result.value, sizeof(result.value));
     handleResultStatus(pasynUser, result);
     *value = result.value;
     if (shouldProcessInterrupts(result)) {
@@ -998,8 +2969,31 @@ asynStatus Driver::readScalar(asynUser *pasynUser, epicsUInt32 *value,
                               epicsUInt32 mask) {
     DeviceVariable *var = deviceVariableFromUser(pasynUser);
     Handlers<epicsUInt32>::ReadHandler handler =
-        getReadHandler<epicsUInt32>(var->function());
-    Handlers<epicsUInt32>::ReadResult result = handler(*var, mask);
+        getHandlers<epicsUInt32>(*var)->readHandler;
+    Request request;
+    if (!beginRequest(*var, RequestRead, pasynUser, request)) {
+        return rejectRequest(pasynUser, request);
+    }
+    Handlers<epicsUInt32>::ReadResult result;
+    if (TrafficCall const *call = replayCall(request, result)) {
+        restoreValue(*call, result.value);
+        result.value &= mask;
+    } else {
+        result = handler(*var, mask);
+        ShadowRegister *shadow = static_cast<ShadowRegister *>(var->m_shadow);
+        if (shadow != NULL && result.status == asynSuccess) {
+            shadow->value = (shadow->value & ~mask) | (result.value & mask);
+            shadow->known |= mask;
+            if (mask == allBits) {
+                shadow->verified = request.start;
+            }
+        } else if (shadow != NULL) {
+            // The register may have changed without the read seeing it.
+            shadow->known = 0;
+        }
+    }
+    endRequest(request, result);
+    captureCall(request, result, &result.value, sizeof(result.value), mask);
     handleResultStatus(pasynUser, result);
     *value = result.value;
     if (shouldProcessInterrupts(result)) {
@@ -1013,10 +3007,25 @@ template <typename T>
 asynStatus Driver::writeScalar(asynUser *pasynUser, T value) {
     DeviceVariable *var = deviceVariableFromUser(pasynUser);
     typename Handlers<T>::WriteHandler handler =
-        getWriteHandler<T>(var->function());
-    typename Handlers<T>::WriteResult result = handler(*var, value);
+        getHandlers<T>(*var)->writeHandler;
+    bool batched = var->m_batch != NULL;
+    Request request;
+    if (!beginRequest(*var, RequestWrite, pasynUser, request, !batched)) {
+        return rejectRequest(pasynUser, request);
+    }
+    typename Handlers<T>::WriteResult result;
+    if (replayCall(request, result) != NULL) {
+        // The result was recorded.
+    } else if (batched) {
+        stageWrite(request, &value, sizeof(value), 1, allBits);
+    } else {
+        result = handler(*var, value);
+    }
+    endRequest(request, result);
+    captureCall(request, result, &value, sizeof(value));
     handleResultStatus(pasynUser, result);
-    if (shouldProcessInterrupts(result)) {
+    // Staged values are propagated when the batch is committed.
+    if (!request.staged && shouldProcessInterrupts(result)) {
         setParamDispatch(pasynUser->reason, value);
         callParamCallbacks();
     }
@@ -1027,24 +3036,97 @@ asynStatus Driver::writeScalar(asynUser *pasynUser, epicsUInt32 value,
                                epicsUInt32 mask) {
     DeviceVariable *var = deviceVariableFromUser(pasynUser);
     Handlers<epicsUInt32>::WriteHandler handler =
-        getWriteHandler<epicsUInt32>(var->function());
-    Handlers<epicsUInt32>::WriteResult result = handler(*var, value, mask);
+        getHandlers<epicsUInt32>(*var)->writeHandler;
+    bool batched = var->m_batch != NULL;
+    Request request;
+    if (!beginRequest(*var, RequestWrite, pasynUser, request, !batched)) {
+        return rejectRequest(pasynUser, request);
+    }
+    Handlers<epicsUInt32>::WriteResult result;
+    ShadowRegister *shadow = static_cast<ShadowRegister *>(var->m_shadow);
+    if (replayCall(request, result) != NULL) {
+        // The result was recorded.
+    } else if (batched) {
+        stageWrite(request, &value, sizeof(value), 1, mask);
+    } else if (shadow == NULL) {
+        result = handler(*var, value, mask);
+    } else {
+        // Merge the bits into the shadow and write the whole register, so
+        // that the handler doesn't need to read it first.
+        readShadow(*var, *shadow);
+        epicsUInt32 merged = (shadow->value & ~mask) | (value & mask);
+        if (shadow->known == allBits) {
+            result = handler(*var, merged, allBits);
+        } else {
+            result = handler(*var, value, mask);
+        }
+        if (result.status == asynSuccess) {
+            shadow->value = merged;
+            shadow->known |= mask;
+        } else {
+            shadow->known = 0;
+        }
+    }
+    endRequest(request, result);
+    captureCall(request, result, &value, sizeof(value), mask);
     handleResultStatus(pasynUser, result);
-    if (shouldProcessInterrupts(result)) {
+    if (!request.staged && shouldProcessInterrupts(result)) {
         setUIntDigitalParam(pasynUser->reason, value, mask);
         callParamCallbacks();
     }
     return result.status;
 }
 
+// Reads the whole register unless the shadow is complete and recent enough.
+// A failed read discards the shadow, so that the write is passed on as is.
+void Driver::readShadow(DeviceVariable &var, ShadowRegister &shadow) {
+    Handlers<epicsUInt32>::ReadHandler reader =
+        getHandlers<epicsUInt32>(var)->readHandler;
+    double verifyPeriod = functionInfo(var).opts.shadowVerify;
+    epicsUInt64 now = epicsMonotonicGet();
+    bool complete = shadow.known == allBits;
+    if (reader == NULL ||
+        (complete && (verifyPeriod <= 0 ||
+                      now - shadow.verified < verifyPeriod * 1e9))) {
+        return;
+    }
+
+    Handlers<epicsUInt32>::ReadResult result = reader(var, allBits);
+    if (result.status != asynSuccess) {
+        shadow.known = 0;
+        return;
+    }
+    if (complete && result.value != shadow.value) {
+        asynPrint(pasynUserSelf, ASYN_TRACE_WARNING,
+                  "%s: port=%s %s changed from 0x%08x to 0x%08x outside of "
+                  "the driver\n",
+                  driverName, portName, var.asCString(), shadow.value,
+                  result.value);
+    }
+    shadow.value = result.value;
+    shadow.known = allBits;
+    shadow.verified = now;
+}
+
 template <typename T>
 asynStatus Driver::readArray(asynUser *pasynUser, T *value, size_t maxSize,
                              size_t *size) {
     DeviceVariable *var = deviceVariableFromUser(pasynUser);
     Array<T> arrayRef(value, maxSize);
     typename Handlers<Array<T> >::ReadHandler handler =
-        getHandlerMap<Array<T> >().at(var->function()).readHandler;
-    typename Handlers<Array<T> >::ReadResult result = handler(*var, arrayRef);
+        getHandlers<Array<T> >(*var)->readHandler;
+    Request request;
+    if (!beginRequest(*var, RequestRead, pasynUser, request)) {
+        return rejectRequest(pasynUser, request);
+    }
+    typename Handlers<Array<T> >::ReadResult result;
+    if (TrafficCall const *call = replayCall(request, result)) {
+        restoreArray(*call, arrayRef);
+    } else {
+        result = handler(*var, arrayRef);
+    }
+    endRequest(request, result);
+    captureCall(request, result, arrayRef.data(), arrayRef.size() * sizeof(T));
     handleResultStatus(pasynUser, result);
     *size = arrayRef.size();
     if (shouldProcessInterrupts(result)) {
@@ -1058,10 +3140,24 @@ asynStatus Driver::writeArray(asynUser *pasynUser, T *value, size_t size) {
     DeviceVariable *var = deviceVariableFromUser(pasynUser);
     Array<T> arrayRef(value, size);
     typename Handlers<Array<T> >::WriteHandler handler =
-        getHandlerMap<Array<T> >().at(var->function()).writeHandler;
-    typename Handlers<Array<T> >::WriteResult result = handler(*var, arrayRef);
+        getHandlers<Array<T> >(*var)->writeHandler;
+    bool batched = var->m_batch != NULL;
+    Request request;
+    if (!beginRequest(*var, RequestWrite, pasynUser, request, !batched)) {
+        return rejectRequest(pasynUser, request);
+    }
+    typename Handlers<Array<T> >::WriteResult result;
+    if (replayCall(request, result) != NULL) {
+        // The result was recorded.
+    } else if (batched) {
+        stageWrite(request, value, size * sizeof(T), size, allBits);
+    } else {
+        result = handler(*var, arrayRef);
+    }
+    endRequest(request, result);
+    captureCall(request, result, arrayRef.data(), arrayRef.size() * sizeof(T));
     handleResultStatus(pasynUser, result);
-    if (shouldProcessInterrupts(result)) {
+    if (!request.staged && shouldProcessInterrupts(result)) {
         return doCallbacksArrayDispatch(var->asynIndex(), arrayRef);
     }
     return result.status;
@@ -1072,8 +3168,19 @@ asynStatus Driver::readOctetData(asynUser *pasynUser, char *value,
     DeviceVariable *var = deviceVariableFromUser(pasynUser);
     Octet arrayRef(value, maxSize);
     Handlers<Octet>::ReadHandler handler =
-        getHandlerMap<Octet>().at(var->function()).readHandler;
-    Handlers<Octet>::ReadResult result = handler(*var, arrayRef);
+        getHandlers<Octet>(*var)->readHandler;
+    Request request;
+    if (!beginRequest(*var, RequestRead, pasynUser, request)) {
+        return rejectRequest(pasynUser, request);
+    }
+    Handlers<Octet>::ReadResult result;
+    if (TrafficCall const *call = replayCall(request, result)) {
+        restoreArray(*call, arrayRef);
+    } else {
+        result = handler(*var, arrayRef);
+    }
+    endRequest(request, result);
+    captureCall(request, result, arrayRef.data(), arrayRef.size());
     handleResultStatus(pasynUser, result);
     *nRead = arrayRef.size();
     // The handler should have ensured termination, but we can't be sure.
@@ -1090,8 +3197,17 @@ asynStatus Driver::writeOctetData(asynUser *pasynUser, char const *value,
     DeviceVariable *var = deviceVariableFromUser(pasynUser);
     Octet const arrayRef(const_cast<char *>(value), size);
     Handlers<Octet>::WriteHandler handler =
-        getHandlerMap<Octet>().at(var->function()).writeHandler;
-    Handlers<Octet>::WriteResult result = handler(*var, arrayRef);
+        getHandlers<Octet>(*var)->writeHandler;
+    Request request;
+    if (!beginRequest(*var, RequestWrite, pasynUser, request)) {
+        return rejectRequest(pasynUser, request);
+    }
+    Handlers<Octet>::WriteResult result;
+    if (replayCall(request, result) == NULL) {
+        result = handler(*var, arrayRef);
+    }
+    endRequest(request, result);
+    captureCall(request, result, arrayRef.data(), arrayRef.size());
     handleResultStatus(pasynUser, result);
     if (shouldProcessInterrupts(result)) {
         setParamDispatch(var->asynIndex(), arrayRef);
@@ -1100,15 +3216,60 @@ asynStatus Driver::writeOctetData(asynUser *pasynUser, char const *value,
     return result.status;
 }
 
+asynStatus Driver::readPointer(asynUser *pasynUser, void *pointer) {
+    DeviceVariable *var = deviceVariableFromUser(pasynUser);
+    GenericPointer ptrRef(pointer);
+    Handlers<GenericPointer>::ReadHandler handler =
+        getHandlers<GenericPointer>(*var)->readHandler;
+    Request request;
+    if (!beginRequest(*var, RequestRead, pasynUser, request)) {
+        return rejectRequest(pasynUser, request);
+    }
+    Handlers<GenericPointer>::ReadResult result;
+    if (replayCall(request, result) == NULL) {
+        result = handler(*var, ptrRef);
+    }
+    endRequest(request, result);
+    captureCall(request, result, NULL, 0);
+    handleResultStatus(pasynUser, result);
+    if (shouldProcessInterrupts(result)) {
+        return asynPortDriver::doCallbacksGenericPointer(
+            pointer, var->asynIndex(), 0);
+    }
+    return result.status;
+}
+
+asynStatus Driver::writePointer(asynUser *pasynUser, void *pointer) {
+    DeviceVariable *var = deviceVariableFromUser(pasynUser);
+    GenericPointer ptrRef(pointer);
+    Handlers<GenericPointer>::WriteHandler handler =
+        getHandlers<GenericPointer>(*var)->writeHandler;
+    Request request;
+    if (!beginRequest(*var, RequestWrite, pasynUser, request)) {
+        return rejectRequest(pasynUser, request);
+    }
+    Handlers<GenericPointer>::WriteResult result;
+    if (replayCall(request, result) == NULL) {
+        result = handler(*var, ptrRef);
+    }
+    endRequest(request, result);
+    captureCall(request, result, NULL, 0);
+    handleResultStatus(pasynUser, result);
+    if (shouldProcessInterrupts(result)) {
+        return asynPortDriver::doCallbacksGenericPointer(
+            pointer, var->asynIndex(), 0);
+    }
+    return result.status;
+}
+
 asynStatus Driver::readInt32(asynUser *pasynUser, epicsInt32 *value) {
     if (hasParam(pasynUser->reason)) {
-        std::string const &function =
-            deviceVariableFromUser(pasynUser)->function();
-        bool handlersExist = checkHandlersVerbosely<epicsInt32>(function);
+        DeviceVariable *var = deviceVariableFromUser(pasynUser);
+        bool handlersExist = checkHandlersVerbosely<epicsInt32>(*var);
         if (!handlersExist) {
-            return asynError;
+            return rejectRequest(pasynUser, *var, RequestRead);
         }
-        if (hasReadHandler<epicsInt32>(pasynUser->reason)) {
+        if (hasReadHandler<epicsInt32>(*var)) {
             return readScalar(pasynUser, value);
         }
     }
@@ -1118,13 +3279,12 @@ asynStatus Driver::readInt32(asynUser *pasynUser, epicsInt32 *value) {
 
 asynStatus Driver::writeInt32(asynUser *pasynUser, epicsInt32 value) {
     if (hasParam(pasynUser->reason)) {
-        std::string const &function =
-            deviceVariableFromUser(pasynUser)->function();
-        bool handlersExist = checkHandlersVerbosely<epicsInt32>(function);
+        DeviceVariable *var = deviceVariableFromUser(pasynUser);
+        bool handlersExist = checkHandlersVerbosely<epicsInt32>(*var);
         if (!handlersExist) {
-            return asynError;
+            return rejectRequest(pasynUser, *var, RequestWrite);
         }
-        if (hasWriteHandler<epicsInt32>(pasynUser->reason)) {
+        if (hasWriteHandler<epicsInt32>(*var)) {
             return writeScalar(pasynUser, value);
         }
     }
@@ -1134,13 +3294,12 @@ asynStatus Driver::writeInt32(asynUser *pasynUser, epicsInt32 value) {
 
 asynStatus Driver::readInt64(asynUser *pasynUser, epicsInt64 *value) {
     if (hasParam(pasynUser->reason)) {
-        std::string const &function =
-            deviceVariableFromUser(pasynUser)->function();
-        bool handlersExist = checkHandlersVerbosely<epicsInt64>(function);
+        DeviceVariable *var = deviceVariableFromUser(pasynUser);
+        bool handlersExist = checkHandlersVerbosely<epicsInt64>(*var);
         if (!handlersExist) {
-            return asynError;
+            return rejectRequest(pasynUser, *var, RequestRead);
         }
-        if (hasReadHandler<epicsInt64>(pasynUser->reason)) {
+        if (hasReadHandler<epicsInt64>(*var)) {
             return readScalar(pasynUser, value);
         }
     }
@@ -1150,13 +3309,12 @@ asynStatus Driver::readInt64(asynUser *pasynUser, epicsInt64 *value) {
 
 asynStatus Driver::writeInt64(asynUser *pasynUser, epicsInt64 value) {
     if (hasParam(pasynUser->reason)) {
-        std::string const &function =
-            deviceVariableFromUser(pasynUser)->function();
-        bool handlersExist = checkHandlersVerbosely<epicsInt64>(function);
+        DeviceVariable *var = deviceVariableFromUser(pasynUser);
+        bool handlersExist = checkHandlersVerbosely<epicsInt64>(*var);
         if (!handlersExist) {
-            return asynError;
+            return rejectRequest(pasynUser, *var, RequestWrite);
         }
-        if (hasWriteHandler<epicsInt64>(pasynUser->reason)) {
+        if (hasWriteHandler<epicsInt64>(*var)) {
             return writeScalar(pasynUser, value);
         }
     }
@@ -1166,13 +3324,12 @@ asynStatus Driver::writeInt64(asynUser *pasynUser, epicsInt64 value) {
 
 asynStatus Driver::readFloat64(asynUser *pasynUser, epicsFloat64 *value) {
     if (hasParam(pasynUser->reason)) {
-        std::string const &function =
-            deviceVariableFromUser(pasynUser)->function();
-        bool handlersExist = checkHandlersVerbosely<epicsFloat64>(function);
+        DeviceVariable *var = deviceVariableFromUser(pasynUser);
+        bool handlersExist = checkHandlersVerbosely<epicsFloat64>(*var);
         if (!handlersExist) {
-            return asynError;
+            return rejectRequest(pasynUser, *var, RequestRead);
         }
-        if (hasReadHandler<epicsFloat64>(pasynUser->reason)) {
+        if (hasReadHandler<epicsFloat64>(*var)) {
             return readScalar(pasynUser, value);
         }
     }
@@ -1182,13 +3339,12 @@ asynStatus Driver::readFloat64(asynUser *pasynUser, epicsFloat64 *value) {
 
 asynStatus Driver::writeFloat64(asynUser *pasynUser, epicsFloat64 value) {
     if (hasParam(pasynUser->reason)) {
-        std::string const &function =
-            deviceVariableFromUser(pasynUser)->function();
-        bool handlersExist = checkHandlersVerbosely<epicsFloat64>(function);
+        DeviceVariable *var = deviceVariableFromUser(pasynUser);
+        bool handlersExist = checkHandlersVerbosely<epicsFloat64>(*var);
         if (!handlersExist) {
-            return asynError;
+            return rejectRequest(pasynUser, *var, RequestWrite);
         }
-        if (hasWriteHandler<epicsFloat64>(pasynUser->reason)) {
+        if (hasWriteHandler<epicsFloat64>(*var)) {
             return writeScalar(pasynUser, value);
         }
     }
@@ -1199,14 +3355,13 @@ asynStatus Driver::writeFloat64(asynUser *pasynUser, epicsFloat64 value) {
 asynStatus Driver::readInt8Array(asynUser *pasynUser, epicsInt8 *value,
                                  size_t maxSize, size_t *size) {
     if (hasParam(pasynUser->reason)) {
-        std::string const &function =
-            deviceVariableFromUser(pasynUser)->function();
+        DeviceVariable *var = deviceVariableFromUser(pasynUser);
         bool handlersExist =
-            checkHandlersVerbosely<Array<epicsInt8> >(function);
+            checkHandlersVerbosely<Array<epicsInt8> >(*var);
         if (!handlersExist) {
-            return asynError;
+            return rejectRequest(pasynUser, *var, RequestRead);
         }
-        if (hasReadHandler<Array<epicsInt8> >(pasynUser->reason)) {
+        if (hasReadHandler<Array<epicsInt8> >(*var)) {
             return readArray(pasynUser, value, maxSize, size);
         }
     }
@@ -1217,14 +3372,13 @@ asynStatus Driver::readInt8Array(asynUser *pasynUser, epicsInt8 *value,
 asynStatus Driver::writeInt8Array(asynUser *pasynUser, epicsInt8 *value,
                                   size_t size) {
     if (hasParam(pasynUser->reason)) {
-        std::string const &function =
-            deviceVariableFromUser(pasynUser)->function();
+        DeviceVariable *var = deviceVariableFromUser(pasynUser);
         bool handlersExist =
-            checkHandlersVerbosely<Array<epicsInt8> >(function);
+            checkHandlersVerbosely<Array<epicsInt8> >(*var);
         if (!handlersExist) {
-            return asynError;
+            return rejectRequest(pasynUser, *var, RequestWrite);
         }
-        if (hasWriteHandler<Array<epicsInt8> >(pasynUser->reason)) {
+        if (hasWriteHandler<Array<epicsInt8> >(*var)) {
             return writeArray(pasynUser, value, size);
         }
     }
@@ -1235,14 +3389,13 @@ asynStatus Driver::writeInt8Array(asynUser *pasynUser, epicsInt8 *value,
 asynStatus Driver::readInt16Array(asynUser *pasynUser, epicsInt16 *value,
                                   size_t maxSize, size_t *size) {
     if (hasParam(pasynUser->reason)) {
-        std::string const &function =
-            deviceVariableFromUser(pasynUser)->function();
+        DeviceVariable *var = deviceVariableFromUser(pasynUser);
         bool handlersExist =
-            checkHandlersVerbosely<Array<epicsInt16> >(function);
+            checkHandlersVerbosely<Array<epicsInt16> >(*var);
         if (!handlersExist) {
-            return asynError;
+            return rejectRequest(pasynUser, *var, RequestRead);
         }
-        if (hasReadHandler<Array<epicsInt16> >(pasynUser->reason)) {
+        if (hasReadHandler<Array<epicsInt16> >(*var)) {
             return readArray(pasynUser, value, maxSize, size);
         }
     }
@@ -1253,14 +3406,13 @@ asynStatus Driver::readInt16Array(asynUser *pasynUser, epicsInt16 *value,
 asynStatus Driver::writeInt16Array(asynUser *pasynUser, epicsInt16 *value,
                                    size_t size) {
     if (hasParam(pasynUser->reason)) {
-        std::string const &function =
-            deviceVariableFromUser(pasynUser)->function();
+        DeviceVariable *var = deviceVariableFromUser(pasynUser);
         bool handlersExist =
-            checkHandlersVerbosely<Array<epicsInt16> >(function);
+            checkHandlersVerbosely<Array<epicsInt16> >(*var);
         if (!handlersExist) {
-            return asynError;
+            return rejectRequest(pasynUser, *var, RequestWrite);
         }
-        if (hasWriteHandler<Array<epicsInt16> >(pasynUser->reason)) {
+        if (hasWriteHandler<Array<epicsInt16> >(*var)) {
             return writeArray(pasynUser, value, size);
         }
     }
@@ -1271,14 +3423,13 @@ asynStatus Driver::writeInt16Array(asynUser *pasynUser, epicsInt16 *value,
 asynStatus Driver::readInt32Array(asynUser *pasynUser, epicsInt32 *value,
                                   size_t maxSize, size_t *size) {
     if (hasParam(pasynUser->reason)) {
-        std::string const &function =
-            deviceVariableFromUser(pasynUser)->function();
+        DeviceVariable *var = deviceVariableFromUser(pasynUser);
         bool handlersExist =
-            checkHandlersVerbosely<Array<epicsInt32> >(function);
+            checkHandlersVerbosely<Array<epicsInt32> >(*var);
         if (!handlersExist) {
-            return asynError;
+            return rejectRequest(pasynUser, *var, RequestRead);
         }
-        if (hasReadHandler<Array<epicsInt32> >(pasynUser->reason)) {
+        if (hasReadHandler<Array<epicsInt32> >(*var)) {
             return readArray(pasynUser, value, maxSize, size);
         }
     }
@@ -1289,14 +3440,13 @@ asynStatus Driver::readInt32Array(asynUser *pasynUser, epicsInt32 *value,
 asynStatus Driver::writeInt32Array(asynUser *pasynUser, epicsInt32 *value,
                                    size_t size) {
     if (hasParam(pasynUser->reason)) {
-        std::string const &function =
-            deviceVariableFromUser(pasynUser)->function();
+        DeviceVariable *var = deviceVariableFromUser(pasynUser);
         bool handlersExist =
-            checkHandlersVerbosely<Array<epicsInt32> >(function);
+            checkHandlersVerbosely<Array<epicsInt32> >(*var);
         if (!handlersExist) {
-            return asynError;
+            return rejectRequest(pasynUser, *var, RequestWrite);
         }
-        if (hasWriteHandler<Array<epicsInt32> >(pasynUser->reason)) {
+        if (hasWriteHandler<Array<epicsInt32> >(*var)) {
             return writeArray(pasynUser, value, size);
         }
     }
@@ -1307,14 +3457,13 @@ asynStatus Driver::writeInt32Array(asynUser *pasynUser, epicsInt32 *value,
 asynStatus Driver::readInt64Array(asynUser *pasynUser, epicsInt64 *value,
                                   size_t maxSize, size_t *size) {
     if (hasParam(pasynUser->reason)) {
-        std::string const &function =
-            deviceVariableFromUser(pasynUser)->function();
+        DeviceVariable *var = deviceVariableFromUser(pasynUser);
         bool handlersExist =
-            checkHandlersVerbosely<Array<epicsInt64> >(function);
+            checkHandlersVerbosely<Array<epicsInt64> >(*var);
         if (!handlersExist) {
-            return asynError;
+            return rejectRequest(pasynUser, *var, RequestRead);
         }
-        if (hasReadHandler<Array<epicsInt64> >(pasynUser->reason)) {
+        if (hasReadHandler<Array<epicsInt64> >(*var)) {
             return readArray(pasynUser, value, maxSize, size);
         }
     }
@@ -1325,14 +3474,13 @@ asynStatus Driver::readInt64Array(asynUser *pasynUser, epicsInt64 *value,
 asynStatus Driver::writeInt64Array(asynUser *pasynUser, epicsInt64 *value,
                                    size_t size) {
     if (hasParam(pasynUser->reason)) {
-        std::string const &function =
-            deviceVariableFromUser(pasynUser)->function();
+        DeviceVariable *var = deviceVariableFromUser(pasynUser);
         bool handlersExist =
-            checkHandlersVerbosely<Array<epicsInt64> >(function);
+            checkHandlersVerbosely<Array<epicsInt64> >(*var);
         if (!handlersExist) {
-            return asynError;
+            return rejectRequest(pasynUser, *var, RequestWrite);
         }
-        if (hasWriteHandler<Array<epicsInt64> >(pasynUser->reason)) {
+        if (hasWriteHandler<Array<epicsInt64> >(*var)) {
             return writeArray(pasynUser, value, size);
         }
     }
@@ -1343,14 +3491,13 @@ asynStatus Driver::writeInt64Array(asynUser *pasynUser, epicsInt64 *value,
 asynStatus Driver::readFloat32Array(asynUser *pasynUser, epicsFloat32 *value,
                                     size_t maxSize, size_t *size) {
     if (hasParam(pasynUser->reason)) {
-        std::string const &function =
-            deviceVariableFromUser(pasynUser)->function();
+        DeviceVariable *var = deviceVariableFromUser(pasynUser);
         bool handlersExist =
-            checkHandlersVerbosely<Array<epicsFloat32> >(function);
+            checkHandlersVerbosely<Array<epicsFloat32> >(*var);
         if (!handlersExist) {
-            return asynError;
+            return rejectRequest(pasynUser, *var, RequestRead);
         }
-        if (hasReadHandler<Array<epicsFloat32> >(pasynUser->reason)) {
+        if (hasReadHandler<Array<epicsFloat32> >(*var)) {
             return readArray(pasynUser, value, maxSize, size);
         }
     }
@@ -1361,14 +3508,13 @@ asynStatus Driver::readFloat32Array(asynUser *pasynUser, epicsFloat32 *value,
 asynStatus Driver::writeFloat32Array(asynUser *pasynUser, epicsFloat32 *value,
                                      size_t size) {
     if (hasParam(pasynUser->reason)) {
-        std::string const &function =
-            deviceVariableFromUser(pasynUser)->function();
+        DeviceVariable *var = deviceVariableFromUser(pasynUser);
         bool handlersExist =
-            checkHandlersVerbosely<Array<epicsFloat32> >(function);
+            checkHandlersVerbosely<Array<epicsFloat32> >(*var);
         if (!handlersExist) {
-            return asynError;
+            return rejectRequest(pasynUser, *var, RequestWrite);
         }
-        if (hasWriteHandler<Array<epicsFloat32> >(pasynUser->reason)) {
+        if (hasWriteHandler<Array<epicsFloat32> >(*var)) {
             return writeArray(pasynUser, value, size);
         }
     }
@@ -1379,14 +3525,13 @@ asynStatus Driver::writeFloat32Array(asynUser *pasynUser, epicsFloat32 *value,
 asynStatus Driver::readFloat64Array(asynUser *pasynUser, epicsFloat64 *value,
                                     size_t maxSize, size_t *size) {
     if (hasParam(pasynUser->reason)) {
-        std::string const &function =
-            deviceVariableFromUser(pasynUser)->function();
+        DeviceVariable *var = deviceVariableFromUser(pasynUser);
         bool handlersExist =
-            checkHandlersVerbosely<Array<epicsFloat64> >(function);
+            checkHandlersVerbosely<Array<epicsFloat64> >(*var);
         if (!handlersExist) {
-            return asynError;
+            return rejectRequest(pasynUser, *var, RequestRead);
         }
-        if (hasReadHandler<Array<epicsFloat64> >(pasynUser->reason)) {
+        if (hasReadHandler<Array<epicsFloat64> >(*var)) {
             return readArray(pasynUser, value, maxSize, size);
         }
     }
@@ -1397,14 +3542,13 @@ asynStatus Driver::readFloat64Array(asynUser *pasynUser, epicsFloat64 *value,
 asynStatus Driver::writeFloat64Array(asynUser *pasynUser, epicsFloat64 *value,
                                      size_t size) {
     if (hasParam(pasynUser->reason)) {
-        std::string const &function =
-            deviceVariableFromUser(pasynUser)->function();
+        DeviceVariable *var = deviceVariableFromUser(pasynUser);
         bool handlersExist =
-            checkHandlersVerbosely<Array<epicsFloat64> >(function);
+            checkHandlersVerbosely<Array<epicsFloat64> >(*var);
         if (!handlersExist) {
-            return asynError;
+            return rejectRequest(pasynUser, *var, RequestWrite);
         }
-        if (hasWriteHandler<Array<epicsFloat64> >(pasynUser->reason)) {
+        if (hasWriteHandler<Array<epicsFloat64> >(*var)) {
             return writeArray(pasynUser, value, size);
         }
     }
@@ -1415,13 +3559,12 @@ asynStatus Driver::writeFloat64Array(asynUser *pasynUser, epicsFloat64 *value,
 asynStatus Driver::readUInt32Digital(asynUser *pasynUser, epicsUInt32 *value,
                                      epicsUInt32 mask) {
     if (hasParam(pasynUser->reason)) {
-        std::string const &function =
-            deviceVariableFromUser(pasynUser)->function();
-        bool handlersExist = checkHandlersVerbosely<epicsUInt32>(function);
+        DeviceVariable *var = deviceVariableFromUser(pasynUser);
+        bool handlersExist = checkHandlersVerbosely<epicsUInt32>(*var);
         if (!handlersExist) {
-            return asynError;
+            return rejectRequest(pasynUser, *var, RequestRead);
         }
-        if (hasReadHandler<epicsUInt32>(pasynUser->reason)) {
+        if (hasReadHandler<epicsUInt32>(*var)) {
             return readScalar(pasynUser, value, mask);
         }
     }
@@ -1432,13 +3575,12 @@ asynStatus Driver::readUInt32Digital(asynUser *pasynUser, epicsUInt32 *value,
 asynStatus Driver::writeUInt32Digital(asynUser *pasynUser, epicsUInt32 value,
                                       epicsUInt32 mask) {
     if (hasParam(pasynUser->reason)) {
-        std::string const &function =
-            deviceVariableFromUser(pasynUser)->function();
-        bool handlersExist = checkHandlersVerbosely<epicsUInt32>(function);
+        DeviceVariable *var = deviceVariableFromUser(pasynUser);
+        bool handlersExist = checkHandlersVerbosely<epicsUInt32>(*var);
         if (!handlersExist) {
-            return asynError;
+            return rejectRequest(pasynUser, *var, RequestWrite);
         }
-        if (hasWriteHandler<epicsUInt32>(pasynUser->reason)) {
+        if (hasWriteHandler<epicsUInt32>(*var)) {
             return writeScalar(pasynUser, value, mask);
         }
     }
@@ -1449,13 +3591,12 @@ asynStatus Driver::writeUInt32Digital(asynUser *pasynUser, epicsUInt32 value,
 asynStatus Driver::readOctet(asynUser *pasynUser, char *value, size_t nChars,
                              size_t *nActual, int *eomReason) {
     if (hasParam(pasynUser->reason)) {
-        std::string const &function =
-            deviceVariableFromUser(pasynUser)->function();
-        bool handlersExist = checkHandlersVerbosely<Octet>(function);
+        DeviceVariable *var = deviceVariableFromUser(pasynUser);
+        bool handlersExist = checkHandlersVerbosely<Octet>(*var);
         if (!handlersExist) {
-            return asynError;
+            return rejectRequest(pasynUser, *var, RequestRead);
         }
-        if (hasReadHandler<Octet>(pasynUser->reason)) {
+        if (hasReadHandler<Octet>(*var)) {
             // Only complete reads are supported.
             *eomReason = ASYN_EOM_END;
             return readOctetData(pasynUser, value, nChars, nActual);
@@ -1469,13 +3610,12 @@ asynStatus Driver::readOctet(asynUser *pasynUser, char *value, size_t nChars,
 asynStatus Driver::writeOctet(asynUser *pasynUser, const char *value,
                               size_t nChars, size_t *nActual) {
     if (hasParam(pasynUser->reason)) {
-        std::string const &function =
-            deviceVariableFromUser(pasynUser)->function();
-        bool handlersExist = checkHandlersVerbosely<Octet>(function);
+        DeviceVariable *var = deviceVariableFromUser(pasynUser);
+        bool handlersExist = checkHandlersVerbosely<Octet>(*var);
         if (!handlersExist) {
-            return asynError;
+            return rejectRequest(pasynUser, *var, RequestWrite);
         }
-        if (hasWriteHandler<Octet>(pasynUser->reason)) {
+        if (hasWriteHandler<Octet>(*var)) {
             // Only complete writes are supported.
             *nActual = nChars;
             return writeOctetData(pasynUser, value, nChars);
@@ -1485,6 +3625,40 @@ asynStatus Driver::writeOctet(asynUser *pasynUser, const char *value,
     return asynPortDriver::writeOctet(pasynUser, value, nChars, nActual);
 }
 
+asynStatus Driver::readGenericPointer(asynUser *pasynUser, void *pointer) {
+    if (hasParam(pasynUser->reason)) {
+        DeviceVariable *var = deviceVariableFromUser(pasynUser);
+        bool handlersExist = checkHandlersVerbosely<GenericPointer>(*var);
+        if (!handlersExist) {
+            return rejectRequest(pasynUser, *var, RequestRead);
+        }
+        if (hasReadHandler<GenericPointer>(*var)) {
+            return readPointer(pasynUser, pointer);
+        }
+    }
+
+    return asynPortDriver::readGenericPointer(pasynUser, pointer);
+}
+
+asynStatus Driver::writeGenericPointer(asynUser *pasynUser, void *pointer) {
+    if (hasParam(pasynUser->reason)) {
+        DeviceVariable *var = deviceVariableFromUser(pasynUser);
+        bool handlersExist = checkHandlersVerbosely<GenericPointer>(*var);
+        if (!handlersExist) {
+            return rejectRequest(pasynUser, *var, RequestWrite);
+        }
+        if (hasWriteHandler<GenericPointer>(*var)) {
+            return writePointer(pasynUser, pointer);
+        }
+        // There is no parameter to store the pointer in, so the default
+        // write handler simply passes it on to interrupt subscribers.
+        return asynPortDriver::doCallbacksGenericPointer(
+            pointer, pasynUser->reason, 0);
+    }
+
+    return asynPortDriver::writeGenericPointer(pasynUser, pointer);
+}
+
 const asynParamType AsynType<epicsInt32>::value;
 const asynParamType AsynType<epicsInt64>::value;
 const asynParamType AsynType<epicsFloat64>::value;
@@ -1496,5 +3670,6 @@ const asynParamType AsynType<Array<epicsInt32> >::value;
 const asynParamType AsynType<Array<epicsInt64> >::value;
 const asynParamType AsynType<Array<epicsFloat32> >::value;
 const asynParamType AsynType<Array<epicsFloat64> >::value;
+const asynParamType AsynType<GenericPointer>::value;
 
 } // namespace Autoparam
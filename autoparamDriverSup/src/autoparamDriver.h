@@ -7,11 +7,19 @@
 #include <map>
 #include <stdexcept>
 
+#include "autoparamBatch.h"
 #include "autoparamHandler.h"
+#include "autoparamRecorder.h"
+#include "autoparamSnapshot.h"
 
 namespace Autoparam {
 
 class Driver;
+class EventLoop;
+class MetricsWriter;
+class TrafficCapture;
+class TrafficReplay;
+struct TrafficCall;
 
 /*! Options controlling the behavior of `Driver`.
  *
@@ -29,6 +37,19 @@ class AUTOPARAMDRIVER_API DriverOpts {
     //! A function that can be set to run after IOC init.
     typedef void (*InitHook)(Driver *);
 
+    //! A function that provides the current time for a driver.
+    typedef void (*TimeStampSource)(Driver *, epicsTimeStamp *);
+
+    //! Scheduling policies for `setSchedulingPolicy()`.
+    enum SchedPolicy {
+        //! Leave the policy chosen by EPICS (normally `SCHED_OTHER`).
+        SchedDefault,
+        //! `SCHED_FIFO`
+        SchedFifo,
+        //! `SCHED_RR`
+        SchedRoundRobin
+    };
+
     /*! Declare whether read and write handlers can block.
      *
      * If any read or write handler can block in any situation, the driver needs
@@ -142,6 +163,40 @@ class AUTOPARAMDRIVER_API DriverOpts {
         return *this;
     }
 
+    /*! Restrict the threads of the driver to a set of CPU cores.
+     *
+     * `cpus` is a list of CPU numbers and ranges, as accepted by `taskset
+     * -c`, e.g. `"2,4-5"`. It applies to the thread of a blocking driver, the
+     * threads of its device groups (see `setDeviceGroups()`) and the threads
+     * the library creates for it, such as those of `Driver::watchDescriptor()`
+     * and write batches, but not to shared thread pools. The affinity is set
+     * by the threads themselves once they start, and the resulting settings
+     * are logged. Only supported on Linux.
+     *
+     * Default: no restriction
+     */
+    DriverOpts &setCpuAffinity(std::string const &cpus) {
+        cpuAffinity = cpus;
+        return *this;
+    }
+
+    /*! Select a real-time scheduling policy for the threads of the driver.
+     *
+     * Applies to the same threads as `setCpuAffinity()`. `priority` is the
+     * POSIX real-time priority (1 to 99 on Linux), replacing the one set by
+     * `setPriority()`. The process needs the privilege to use real-time
+     * scheduling (e.g. `CAP_SYS_NICE` or a suitable `RLIMIT_RTPRIO`);
+     * otherwise, an error is logged and the thread keeps its normal
+     * scheduling. Only supported on Linux.
+     *
+     * Default: `SchedDefault`
+     */
+    DriverOpts &setSchedulingPolicy(SchedPolicy policy, int priority) {
+        schedPolicy = policy;
+        schedPriority = priority;
+        return *this;
+    }
+
     /*! Set a function to run after IOC initialization is done.
      *
      * If the driver needs to do something (like open communication to device)
@@ -159,6 +214,165 @@ class AUTOPARAMDRIVER_API DriverOpts {
         return *this;
     }
 
+    /*! Set a function that provides time stamps for the driver.
+     *
+     * Records are given the time of the request, unless the handler sets
+     * `ResultBase::timestamp`. By default, that is the current time. If the
+     * driver has a better source, e.g. a timing system event or a clock
+     * synchronized with the device, the source can be set here. It is
+     * registered with asyn, so it is also used by
+     * `asynPortDriver::updateTimeStamp()`.
+     *
+     * The source is called with the driver locked, after each handler.
+     *
+     * Default: `NULL` (the current time)
+     */
+    DriverOpts &setTimeStampSource(TimeStampSource source = NULL) {
+        timeStampSource = source;
+        return *this;
+    }
+
+    /*! Set the number of recent requests kept by the flight recorder.
+     *
+     * The driver records the timing and outcome of each handler call in a
+     * `FlightRecorder`. The size is rounded up to a power of two; each entry
+     * takes 40 bytes. Setting the size to 0 disables recording.
+     *
+     * Default: 1024
+     */
+    DriverOpts &setFlightRecorderSize(size_t entries) {
+        flightRecorderSize = entries;
+        return *this;
+    }
+
+    /*! Set the number of slowest requests kept track of.
+     *
+     * The driver keeps the given number of slowest handler calls in a
+     * `SlowRequestTracker`. Setting it to 0 disables tracking and logging of
+     * slow requests.
+     *
+     * Default: 16
+     */
+    DriverOpts &setSlowRequestCount(size_t count) {
+        slowRequestCount = count;
+        return *this;
+    }
+
+    /*! Log handler calls that take longer than `threshold` seconds.
+     *
+     * To keep logging from becoming a bottleneck itself, at most one message
+     * is printed per `minInterval` seconds; the number of slow calls that were
+     * not logged is reported with the next message. The threshold can also be
+     * changed at runtime, see `Driver::setSlowRequestLogging()`.
+     *
+     * Default: 0 (disabled)
+     */
+    DriverOpts &setSlowRequestLogging(double threshold,
+                                      double minInterval = 1.0) {
+        slowRequestThreshold = threshold;
+        slowRequestLogInterval = minInterval;
+        return *this;
+    }
+
+    /*! Fail requests to unresponsive devices immediately.
+     *
+     * Devices are identified by `DeviceAddress::deviceName()`. When `failures`
+     * consecutive handler calls for variables of the same device return
+     * `asynTimeout`, `asynDisconnected` or `asynError`, the circuit for that
+     * device opens: its requests fail immediately with `asynDisconnected`
+     * without calling handlers, so that an unreachable device does not hold
+     * up the port by timing out on every request. Once per `probeInterval`
+     * seconds, a single request is let through to test whether the device is
+     * back. When it succeeds, the circuit closes.
+     *
+     * When the circuit opens or closes, the status and alarms of all the
+     * parameters of the device are updated at once, and `I/O Intr` records
+     * are processed.
+     *
+     * Default: 0 (disabled)
+     */
+    DriverOpts &setCircuitBreaker(int failures, double probeInterval = 5.0) {
+        circuitFailures = failures;
+        circuitProbeInterval = probeInterval;
+        return *this;
+    }
+
+    /*! Set the alarm of requests failed by the circuit breaker.
+     *
+     * See `setCircuitBreaker()`.
+     *
+     * Default: `COMM_ALARM`, `INVALID_ALARM`
+     */
+    DriverOpts &setCircuitBreakerAlarm(epicsAlarmCondition status,
+                                       epicsAlarmSeverity severity) {
+        circuitAlarmStatus = status;
+        circuitAlarmSeverity = severity;
+        return *this;
+    }
+
+    /*! Handle requests for each device group in a separate thread.
+     *
+     * Normally, a blocking driver handles all requests in a single thread, one
+     * after another. When device groups are enabled, each group returned by
+     * `DeviceAddress::deviceGroup()` gets its own asyn port named
+     * `<portName>:<group>`, with its own request queue and thread. Requests
+     * for different groups are then handled in parallel, while requests for
+     * the same group are still handled in order. Variables without a group
+     * are handled by the driver's own port, as usual.
+     *
+     * Handlers for variables in a group are called **without the driver
+     * being locked**, so that they don't wait for each other. They must lock
+     * the driver (see `asynPortDriver::lock()`) before calling e.g.
+     * `Driver::setParam()`. Handlers for the same group never run
+     * concurrently.
+     *
+     * Requires `setBlocking()`.
+     *
+     * Default: disabled
+     */
+    DriverOpts &setDeviceGroups(bool enable = true) {
+        deviceGroups = enable;
+        return *this;
+    }
+
+    /*! Handle requests in a thread pool shared with other drivers.
+     *
+     * Every blocking driver normally handles requests in a thread of its own.
+     * With many drivers in an IOC, most of these threads are idle most of the
+     * time. Drivers that join the same pool instead share the pool's threads:
+     * each driver is assigned to one thread of the pool when it is
+     * constructed, and all its requests are handled by that thread, in order.
+     * Drivers are assigned to the least loaded thread, where the load of a
+     * thread is the sum of `weight` of the drivers assigned to it. Give busy
+     * drivers a higher weight so that they get a thread to themselves.
+     * Requests for drivers sharing a thread are handled in the order they
+     * were queued.
+     *
+     * The pool should be created beforehand by `Driver::createThreadPool()`
+     * or the `autoparamThreadPool` iocshell command. Otherwise, it is created
+     * with one thread per CPU core and the priority of the first driver that
+     * joins it.
+     *
+     * asyn still creates a thread for the driver's own port, and the driver
+     * can't avoid it: it must stay blocking, because device support decides
+     * from the driver's port whether records are processed asynchronously.
+     * The pool thus adds its threads to those of the drivers; what it limits
+     * is the number of handlers running at the same time. Since the driver's
+     * own thread doesn't handle any requests, it is created with the smallest
+     * stack size.
+     * Variables in device groups (see `setDeviceGroups()`) are handled by the
+     * groups' threads, not by the pool.
+     *
+     * Requires `setBlocking()`.
+     *
+     * Default: no pool
+     */
+    DriverOpts &setThreadPool(std::string const &pool, double weight = 1.0) {
+        threadPool = pool;
+        threadPoolWeight = weight;
+        return *this;
+    }
+
     // We have a fixed interface mask. Whether an interface is implemented or
     // not is decided implicitly by which handlers are registered. That's why we
     // enable all the relevant interfaces, and let the read and write functions
@@ -168,13 +382,18 @@ class AUTOPARAMDRIVER_API DriverOpts {
         asynInt32Mask | asynInt64Mask | asynUInt32DigitalMask |
         asynFloat64Mask | asynOctetMask | asynInt8ArrayMask |
         asynInt16ArrayMask | asynInt32ArrayMask | asynInt64ArrayMask |
-        asynFloat32ArrayMask | asynFloat64ArrayMask;
+        asynFloat32ArrayMask | asynFloat64ArrayMask | asynGenericPointerMask;
 
     DriverOpts()
         : interfaceMask(minimalInterfaceMask | defaultMask),
           interruptMask(defaultMask), asynFlags(0), autoConnect(1), priority(0),
           stackSize(0), autoDestruct(false), autoInterrupts(true),
-          initHook(NULL) {}
+          initHook(NULL), timeStampSource(NULL), flightRecorderSize(1024),
+          slowRequestCount(16), slowRequestThreshold(0),
+          slowRequestLogInterval(1.0), circuitFailures(0),
+          circuitProbeInterval(5.0), circuitAlarmStatus(epicsAlarmComm),
+          circuitAlarmSeverity(epicsSevInvalid), deviceGroups(false),
+          threadPoolWeight(1.0), schedPolicy(SchedDefault), schedPriority(0) {}
 
   private:
     friend class Driver;
@@ -188,8 +407,199 @@ class AUTOPARAMDRIVER_API DriverOpts {
     bool autoDestruct;
     bool autoInterrupts;
     InitHook initHook;
+    TimeStampSource timeStampSource;
+    size_t flightRecorderSize;
+    size_t slowRequestCount;
+    double slowRequestThreshold;
+    double slowRequestLogInterval;
+    int circuitFailures;
+    double circuitProbeInterval;
+    epicsAlarmCondition circuitAlarmStatus;
+    epicsAlarmSeverity circuitAlarmSeverity;
+    bool deviceGroups;
+    std::string threadPool;
+    double threadPoolWeight;
+    std::string cpuAffinity;
+    SchedPolicy schedPolicy;
+    int schedPriority;
+};
+
+/*! Options controlling how `Driver` treats a single function.
+ *
+ * `FunctionOpts` are passed to `Driver::registerHandlers()` along with the
+ * handlers for the function, like so:
+ *
+ *     registerHandlers<epicsInt32>("VALUE", readValue, writeValue, NULL,
+ *                                  FunctionOpts().setDeadline(0.5)
+ *                                                .setDeadlineAlarm(true));
+ */
+class AUTOPARAMDRIVER_API FunctionOpts {
+  public:
+    /*! Set the time in seconds read and write handlers should complete in.
+     *
+     * A watchdog thread periodically checks the handlers that are running.
+     * When a handler runs past its deadline, a message is printed once and the
+     * overrun is counted (see `Driver::deadlineReport()`). The handler is not
+     * interrupted. The watchdog checks handlers every 0.1 seconds, so shorter
+     * overruns are only detected when the handler returns.
+     *
+     * Default: 0 (no deadline)
+     */
+    FunctionOpts &setDeadline(double seconds) {
+        deadline = seconds;
+        return *this;
+    }
+
+    /*! Raise an alarm on records whose handler overran the deadline.
+     *
+     * When enabled, a record whose read or write handler returns after the
+     * deadline set by `setDeadline()` is put into `TIMEOUT_ALARM` with
+     * `INVALID` severity, unless the handler set `ResultBase::alarmStatus`
+     * itself.
+     *
+     * Default: disabled
+     */
+    FunctionOpts &setDeadlineAlarm(bool enable = true) {
+        deadlineAlarm = enable;
+        return *this;
+    }
+
+    /*! Handle requests for this function ahead of other requests.
+     *
+     * On a busy blocking driver, a write issued by an operator would normally
+     * wait in the queue behind all the reads queued before it. Requests for
+     * high priority functions are instead queued in a separate lane: an asyn
+     * port named `<portName>:high` with a thread of its own, running at a
+     * slightly higher priority than the driver's thread. Such a request only
+     * waits for the handler that is currently running, since handlers in both
+     * lanes are called with the driver locked, as usual.
+     *
+     * Because asyn routes all requests of a record through the same port, the
+     * priority applies to both reads and writes of the function; register
+     * setpoints and readbacks as separate functions to prioritize only one of
+     * them. Within a lane, asyn serves records with a higher `PRIO` field
+     * first. Variables in device groups (see `DriverOpts::setDeviceGroups()`)
+     * are handled by their group instead. Has no effect unless the driver is
+     * blocking.
+     *
+     * Default: disabled
+     */
+    FunctionOpts &setHighPriority(bool enable = true) {
+        highPriority = enable;
+        return *this;
+    }
+
+    /*! Make this function a member of the snapshot group `name`.
+     *
+     * The values of all members of a group are set by a single
+     * `SnapshotHandler` when the driver calls `Driver::takeSnapshot()`, and
+     * share the same time stamp. See `Autoparam::Snapshot`. The group is
+     * created when the first member is, or when its handler is registered
+     * using `Driver::registerSnapshotHandler()`.
+     *
+     * Default: not a member of any group
+     */
+    FunctionOpts &setSnapshotGroup(std::string const &name) {
+        snapshotGroup = name;
+        return *this;
+    }
+
+    /*! Keep a shadow copy of `UInt32Digital` registers of this function.
+     *
+     * Records such as `bo` and `mbbo` write only some bits of a register,
+     * which the write handler typically implements by reading the register,
+     * merging the bits and writing it back: two transactions per write. With
+     * a shadow register, the driver keeps the last known value of each device
+     * variable, updated by reads and writes. Once all its bits are known,
+     * masked writes are merged into the shadow value and the write handler is
+     * called with the complete value and a mask of all ones, so it needs to
+     * do a single write.
+     *
+     * Before the first masked write, the register is read using the read
+     * handler with a mask of all ones to fill in the shadow. If
+     * `verifyPeriod` is positive, it is read again before a write whenever
+     * the previous complete read is older than `verifyPeriod` seconds;
+     * changes made behind the driver's back are then reported and picked up.
+     * A failed write discards the shadow. Without a read handler, only the
+     * bits that have been written are known.
+     *
+     * The shadow belongs to the device variable, so it should only be used
+     * for registers that are not also written through other variables, or
+     * with a short `verifyPeriod`. Has no effect for other types.
+     *
+     * Default: disabled
+     */
+    FunctionOpts &setShadowRegister(double verifyPeriod = 0) {
+        shadowRegister = true;
+        shadowVerify = verifyPeriod;
+        return *this;
+    }
+
+    /*! Make this function a member of the write batch `name`.
+     *
+     * Writes to members are not passed to the write handler, which may be
+     * NULL. They are collected and written together by the
+     * `BatchWriteHandler` of the batch when it is committed. See
+     * `Autoparam::WriteBatch` and `Driver::registerBatchHandler()`. Records
+     * complete as soon as their write is collected; the result of the commit
+     * is reflected in the status and alarms of the parameter, which `I/O
+     * Intr` and `asyn:READBACK` records see. Only scalar and array functions,
+     * excluding strings and generic pointers, can be members;
+     * `registerHandlers()` refuses to register others with this option.
+     *
+     * Default: not a member of any batch
+     */
+    FunctionOpts &setWriteBatch(std::string const &name) {
+        writeBatch = name;
+        return *this;
+    }
+
+    /*! Poll variables of this function only while records subscribe to them.
+     *
+     * Variables of the function are returned by `Driver::getPollVariables()`
+     * every `period` seconds, but only while `I/O Intr` or `asyn:READBACK`
+     * records are bound to them; a variable without subscribers is not polled
+     * at all, and is polled right away when it gains one.
+     *
+     * If `idlePeriod` is positive, subscribed variables are polled every
+     * `idlePeriod` seconds instead, unless the driver marks them as actively
+     * viewed using `Driver::setPollActive()`. This allows records that are
+     * only archived to be polled slowly and displayed ones at full rate.
+     *
+     * Default: not polled
+     */
+    FunctionOpts &setPollPeriod(double period, double idlePeriod = 0) {
+        pollPeriod = period;
+        pollIdlePeriod = idlePeriod;
+        return *this;
+    }
+
+    FunctionOpts()
+        : deadline(0), deadlineAlarm(false), highPriority(false),
+          shadowRegister(false), shadowVerify(0), pollPeriod(0),
+          pollIdlePeriod(0) {}
+
+  private:
+    friend class Driver;
+
+    double deadline;
+    bool deadlineAlarm;
+    bool highPriority;
+    std::string snapshotGroup;
+    bool shadowRegister;
+    double shadowVerify;
+    std::string writeBatch;
+    double pollPeriod;
+    double pollIdlePeriod;
 };
 
+/*! A function handling a file descriptor that became readable.
+ *
+ * See `Driver::watchDescriptor()`. Returns false to stop watching the
+ * descriptor, e.g. when `read()` returns 0 at end of file.
+ */
+typedef bool (*DescriptorHandler)(int fd, void *arg);
+
 /*! An `asynPortDriver` that dynamically creates parameters referenced by
  * records.
  *
@@ -221,16 +631,17 @@ class AUTOPARAMDRIVER_API DriverOpts {
  *   background thread or in response to hardware interrupts) by
  *   - (scalars) setting the value using `Driver::setParam()`, then calling
  *     `asynPortDriver::callParamCallbacks()`;
- *   - (arrays) calling `Driver::doCallbacksArray()`.
+ *   - (arrays) calling `Driver::doCallbacksArray()`;
+ *   - (generic pointers) calling `Driver::doCallbacksGenericPointer()`.
  *
  * To create a new driver based on `Autoparam::Driver`:
  *   1. Define a subclass of `DeviceAddress`.
  *   2. Define a subclass of `DeviceVariable`.
  *   3. Define a subclass of `Driver`.
  *     - Implement the `parseDeviceAddress()` method to instantiate the
- *       `DeviceAddress` subclass.
+ *       `DeviceAddress` subclass, optionally allocating it from `arena()`.
  *     - Implement the `createDeviceVariable()` method to instantiate the
- *       `DeviceVariable` subclass.
+ *       `DeviceVariable` subclass, optionally allocating it from `arena()`.
  *     - Define static functions that will act as read and write handlers (see
  *       `Autoparam::Handlers` for signatures) and register them as handlers in
  *       the driver's constructor (c.f. `Driver::registerHandlers()`).
@@ -282,7 +693,9 @@ class AUTOPARAMDRIVER_API Driver : public asynPortDriver {
 
     /*! Register handlers for the combination of `function` and type `T`.
      *
-     * Note that the driver is implicitly locked when when handlers are called.
+     * Note that the driver is implicitly locked when when handlers are called,
+     * except for variables in device groups; see
+     * `DriverOpts::setDeviceGroups()`.
      *
      * \tparam T A type corresponding to one of asyn interfaces/parameter types.
      *         See `Autoparam::AsynType`. It determines which EPICS device
@@ -309,13 +722,29 @@ class AUTOPARAMDRIVER_API Driver : public asynPortDriver {
                           typename Handlers<T>::WriteHandler writer,
                           InterruptRegistrar intrRegistrar);
 
+    /*! Register handlers for the combination of `function` and type `T`,
+     * with options applying to this function only.
+     *
+     * The other parameters are the same as above; `functionOpts` are described
+     * in `Autoparam::FunctionOpts`.
+     */
+    template <typename T>
+    void registerHandlers(std::string const &function,
+                          typename Handlers<T>::ReadHandler reader,
+                          typename Handlers<T>::WriteHandler writer,
+                          InterruptRegistrar intrRegistrar,
+                          FunctionOpts const &functionOpts);
+
     /*! Propagate the array data to `I/O Intr` records bound to `var`.
      *
      * Unless this function is called from a read or write handler, the driver
      * needs to be locked. See `asynPortDriver::lock()`.
      *
      * Status and alarms of the records are set according to the same principles
-     * as on completion of a write handler. See `Autoparam::ResultBase`.
+     * as on completion of a write handler. See `Autoparam::ResultBase`. If
+     * `timestamp` is given, it becomes the time stamp of the records;
+     * otherwise, the driver's current time stamp is used (see
+     * `asynPortDriver::setTimeStamp()`).
      *
      * **Note:** strings are not arrays, even though `Autoparam::Octet` derives
      * from `Autoparam::Array`. Use `setParam()` and `callParamCallbacks()`
@@ -325,7 +754,24 @@ class AUTOPARAMDRIVER_API Driver : public asynPortDriver {
     asynStatus doCallbacksArray(DeviceVariable const &var, Array<T> &value,
                                 asynStatus status = asynSuccess,
                                 int alarmStatus = epicsAlarmNone,
-                                int alarmSeverity = epicsSevNone);
+                                int alarmSeverity = epicsSevNone,
+                                epicsTimeStamp const *timestamp = NULL);
+
+    /*! Propagate the pointer to interrupt subscribers bound to `var`.
+     *
+     * Unless this function is called from a read or write handler, the driver
+     * needs to be locked. See `asynPortDriver::lock()`.
+     *
+     * Subscribers are called synchronously, so the data `value` points to only
+     * needs to remain valid until this function returns. Status and alarms are
+     * handled the same way as in `doCallbacksArray()`.
+     */
+    asynStatus
+    doCallbacksGenericPointer(DeviceVariable const &var, GenericPointer value,
+                              asynStatus status = asynSuccess,
+                              int alarmStatus = epicsAlarmNone,
+                              int alarmSeverity = epicsSevNone,
+                              epicsTimeStamp const *timestamp = NULL);
 
     /*! Set the value of the parameter represented by `var`.
      *
@@ -339,12 +785,18 @@ class AUTOPARAMDRIVER_API Driver : public asynPortDriver {
      * `asynPortDriver::callParamCallbacks()` after setting the value. This
      * allows more than one parameter to have its value set before doing record
      * processing.
+     *
+     * If `timestamp` is given, it is used for the records processed by the
+     * next `asynPortDriver::callParamCallbacks()`. asyn keeps a single time
+     * stamp per driver rather than one per parameter, so parameters whose
+     * callbacks are called together share the time stamp that was set last.
      */
     template <typename T>
     asynStatus setParam(DeviceVariable const &var, T value,
                         asynStatus status = asynSuccess,
                         int alarmStatus = epicsAlarmNone,
-                        int alarmSeverity = epicsSevNone);
+                        int alarmSeverity = epicsSevNone,
+                        epicsTimeStamp const *timestamp = NULL);
 
     /*! Set the value of the parameter represented by `var`.
      *
@@ -355,7 +807,8 @@ class AUTOPARAMDRIVER_API Driver : public asynPortDriver {
     asynStatus setParam(DeviceVariable const &var, epicsUInt32 value,
                         epicsUInt32 mask, asynStatus status = asynSuccess,
                         int alarmStatus = epicsAlarmNone,
-                        int alarmSeverity = epicsSevNone);
+                        int alarmSeverity = epicsSevNone,
+                        epicsTimeStamp const *timestamp = NULL);
 
     /*! Get the value of the parameter represented by `var`.
      *
@@ -418,6 +871,32 @@ class AUTOPARAMDRIVER_API Driver : public asynPortDriver {
      */
     std::vector<DeviceVariable *> getInterruptVariables();
 
+    /*! Obtain a list of device variables that are due to be polled.
+     *
+     * Only variables of functions with a poll period are considered, see
+     * `FunctionOpts::setPollPeriod()`. Variables that no record subscribes to
+     * are never returned. A returned variable is not due again until its
+     * period elapses, so a polling thread should call this method at least as
+     * often as the shortest period, read the variables and set their values
+     * using `setParam()` or `doCallbacksArray()`.
+     *
+     * This function is threadsafe, locking the driver is not necessary.
+     */
+    std::vector<DeviceVariable *> getPollVariables();
+
+    /*! Mark `var` as actively viewed or not.
+     *
+     * While active, a variable is polled at the full rate of its function
+     * rather than the idle rate, see `FunctionOpts::setPollPeriod()`. Whether
+     * a record is being watched by an operator or only archived cannot be
+     * told from the driver's side, so this is up to the driver, e.g. based on
+     * a record written by displays. A variable becoming active is polled
+     * right away. Has no effect for functions without an idle rate.
+     *
+     * This function is threadsafe, locking the driver is not necessary.
+     */
+    void setPollActive(DeviceVariable const &var, bool active);
+
     /*! Obtain a `DeviceVariable` given an `asynUser`.
      *
      * This facilitates overriding `asynPortDriver` methods if need be. Be
@@ -429,7 +908,290 @@ class AUTOPARAMDRIVER_API Driver : public asynPortDriver {
      */
     DeviceVariable *deviceVariableFromUser(asynUser *pasynUser);
 
+    /*! Obtain the arena owned by this driver.
+     *
+     * `parseDeviceAddress()` and `createDeviceVariable()` can allocate objects
+     * from the arena instead of the heap, which makes initialization faster
+     * and memory denser when there are many variables:
+     *
+     *     return new (arena()) MyVar(baseVar, this);
+     *
+     * All memory is released in bulk when the `Driver` is destroyed, after the
+     * destructors of all device variables have run. See `Arena`.
+     */
+    Arena &arena() { return m_arena; }
+
+    /*! Register the handler filling in the values of the snapshot group
+     * `name`.
+     *
+     * Should be called in the constructor of the derived driver, like
+     * `registerHandlers()`. Members of the group are functions registered with
+     * `FunctionOpts::setSnapshotGroup()`.
+     */
+    void registerSnapshotHandler(std::string const &name,
+                                 SnapshotHandler handler);
+
+    /*! Acquire the values of all members of the snapshot group `name`.
+     *
+     * Calls the handler of the group, sets the same time stamp on all members
+     * and processes their `I/O Intr` records, all while the driver is locked.
+     * Can be called from any thread, e.g. one waiting for the device to be
+     * triggered, or from a handler. Returns the status returned by the
+     * snapshot handler, or `asynError` if the group has no handler.
+     */
+    asynStatus takeSnapshot(std::string const &name);
+
+    /*! Register the handler writing the write batch `name` to the device.
+     *
+     * Should be called in the constructor of the derived driver, like
+     * `registerHandlers()`. Members of the batch are functions registered with
+     * `FunctionOpts::setWriteBatch()`. If `window` is positive, a thread of
+     * the driver commits the batch `window` seconds after the first write is
+     * collected, so that writes issued together, e.g. by a sequence of
+     * records or by loading a configuration, end up in the same commit.
+     * Otherwise, the batch is only committed by `commitBatch()`.
+     */
+    void registerBatchHandler(std::string const &name,
+                              BatchWriteHandler handler, double window = 0);
+
+    /*! Write the collected writes of the write batch `name` to the device.
+     *
+     * Calls the handler of the batch and propagates the results of the
+     * writes to their parameters, all while the driver is locked. Each write
+     * is accounted for like a request of its own, e.g. in the flight recorder
+     * and by the circuit breaker, which leaves writes to failing devices out
+     * of the commit. Can be called from any thread, or from a handler, e.g.
+     * the write handler of a "commit" function. Does nothing if no writes
+     * were collected. Returns the status returned by the batch handler,
+     * `asynDisconnected` if all writes were left out, or `asynError` if the
+     * batch has no handler.
+     */
+    asynStatus commitBatch(std::string const &name);
+
+    /*! Call `handler` with `arg` whenever the file descriptor `fd` is
+     * readable.
+     *
+     * Meant for devices that push data, e.g. UDP sockets, serial ports with
+     * unsolicited messages, or eventfds of kernel drivers. Instead of a thread
+     * per descriptor, a single thread of the driver waits for all watched
+     * descriptors using epoll. When it wakes up, it locks the driver once,
+     * calls the handlers of all ready descriptors, and then calls
+     * `asynPortDriver::callParamCallbacks()`, so that parameters set by the
+     * handlers with `setParam()` are propagated to `I/O Intr` records
+     * together, with a common time stamp. Arrays are propagated by the
+     * handlers with `doCallbacksArray()` as usual.
+     *
+     * The descriptor should be non-blocking: the handler is called as long
+     * as there is data to read, so it may read as much or as little as it
+     * likes, but it may also be called spuriously. Watching a descriptor
+     * again replaces its handler. The thread is started when the first
+     * descriptor is watched. Can be called from any thread or handler.
+     * Returns `asynError` if the descriptor cannot be watched, or on systems
+     * other than Linux.
+     */
+    asynStatus watchDescriptor(int fd, DescriptorHandler handler, void *arg);
+
+    /*! Stop watching the file descriptor `fd`.
+     *
+     * Must be called before the descriptor is closed, and in the destructor
+     * of the derived driver for descriptors whose handlers use its members.
+     * Once this returns, the handler is not called anymore.
+     */
+    asynStatus unwatchDescriptor(int fd);
+
+    /*! Apply the CPU affinity and scheduling policy of the driver to the
+     * calling thread.
+     *
+     * See `DriverOpts::setCpuAffinity()` and
+     * `DriverOpts::setSchedulingPolicy()`. Threads that the library creates
+     * for the driver call this when they start; threads created by the
+     * derived driver can do the same. `name` identifies the thread in the
+     * log. Does nothing if neither option is set.
+     */
+    void adoptThreadOptions(char const *name);
+
+    /*! The priority of threads created for the driver.
+     *
+     * This is the priority given by `DriverOpts::setPriority()`, or
+     * `epicsThreadPriorityMedium` if none was given. Threads that the derived
+     * driver creates can use it as well.
+     */
+    unsigned int threadPriority() const;
+
   public:
+    /*! Print a summary of memory used by device variables to `fp`.
+     *
+     * The summary covers the `DeviceVariable` and `DeviceAddress` objects,
+     * at the size of their subclasses, and the bookkeeping done by `Driver`
+     * itself for each variable, including the state of the features enabled
+     * by `FunctionOpts` and `DriverOpts`. Memory the subclasses allocate on
+     * their own is not included, nor are objects that subclasses allocate
+     * with their own `operator new`. This is the implementation of the
+     * `autoparamMemoryReport` iocshell command.
+     *
+     * This function locks the driver.
+     */
+    void memoryReport(FILE *fp) const;
+
+    /*! Print the `count` most recent requests kept by the flight recorder.
+     *
+     * For each handler call, the time, the kind of request, the duration, the
+     * status and the device variable are printed, oldest first. This is the
+     * implementation of the `autoparamFlightRecorder` iocshell command.
+     *
+     * The driver is not locked, so this can be used to inspect a driver that
+     * is stuck in a handler.
+     */
+    void flightRecorderReport(FILE *fp, size_t count) const;
+
+    /*! Write the requests kept by the flight recorder as a Chrome trace.
+     *
+     * The output is JSON in the [Trace Event
+     * Format](https://docs.google.com/document/d/1CvAClvFfyA5R-PhYUmn5OOQtYMH4h6I0nSsKchNAySU),
+     * which can be viewed as a timeline in e.g. `chrome://tracing` or
+     * [Perfetto](https://ui.perfetto.dev). This is the implementation of the
+     * `autoparamFlightRecorderTrace` iocshell command.
+     *
+     * The driver is not locked, see `flightRecorderReport()`.
+     */
+    void flightRecorderTrace(FILE *fp) const;
+
+    /*! Print the slowest handler calls since the driver was created or
+     * `resetSlowRequests()` was last called, slowest first.
+     *
+     * This is the implementation of the `autoparamSlowRequests` iocshell
+     * command. The driver is not locked, see `flightRecorderReport()`.
+     */
+    void slowRequestReport(FILE *fp) const;
+
+    /*! Forget the slowest handler calls tracked so far.
+     *
+     * This is the implementation of the `autoparamSlowRequestsReset` iocshell
+     * command.
+     */
+    void resetSlowRequests();
+
+    /*! Change the threshold for logging slow handler calls.
+     *
+     * See `DriverOpts::setSlowRequestLogging()`. This is the implementation of
+     * the `autoparamSlowRequestLog` iocshell command.
+     */
+    void setSlowRequestLogging(double threshold, double minInterval = 1.0);
+
+    /*! Print the deadlines of functions and how many times they were overrun.
+     *
+     * See `FunctionOpts::setDeadline()`. This is the implementation of the
+     * `autoparamDeadlines` iocshell command.
+     */
+    void deadlineReport(FILE *fp) const;
+
+    /*! Print the state of devices tracked by the circuit breaker.
+     *
+     * See `DriverOpts::setCircuitBreaker()`. This is the implementation of the
+     * `autoparamDevices` iocshell command.
+     */
+    void deviceReport(FILE *fp);
+
+    /*! Print histograms of the service time of each request lane.
+     *
+     * The service time is how long the handler took; the time requests wait
+     * in the queue is not included because asyn doesn't tell when they were
+     * queued. Reads and writes are counted separately for the normal lane and
+     * the lane of high priority functions (see
+     * `FunctionOpts::setHighPriority()`). This is the implementation of the
+     * `autoparamLanes` iocshell command.
+     */
+    void laneReport(FILE *fp) const;
+
+    /*! Create a thread pool that drivers can share.
+     *
+     * See `DriverOpts::setThreadPool()`. The threads are the threads of asyn
+     * ports named `<name>:<n>`, where `n` counts from 0. This is the
+     * implementation of the `autoparamThreadPool` iocshell command. Returns
+     * false if a pool with this name already exists or could not be created.
+     */
+    static bool createThreadPool(std::string const &name, int threads,
+                                 unsigned int priority,
+                                 unsigned int stackSize = 0);
+
+    /*! Periodically write the metrics of all drivers to the file at `path`,
+     * in the Prometheus text exposition format.
+     *
+     * The file is written every `period` seconds by a background thread, to a
+     * temporary file that is then renamed to `path`, so that readers such as
+     * the textfile collector of the Prometheus node exporter never see a
+     * partial file. Calling this again changes the file and the period; a
+     * `period` of 0 stops writing. See the documentation for the list of
+     * metrics. This is the implementation of the `autoparamMetrics` iocshell
+     * command.
+     */
+    static void exportMetrics(char const *path, double period);
+
+    /*! Start writing all handler calls to the file at `path`.
+     *
+     * For each call, the variable, the kind of request, the value read or
+     * written, the status, alarms and time stamp of the result, and the timing
+     * are stored in a compact binary format. A capture already in progress is
+     * stopped first. This is the implementation of the `autoparamCapture`
+     * iocshell command. Returns false if the file cannot be created.
+     */
+    bool startCapture(char const *path);
+
+    /*! Stop writing handler calls started by `startCapture()`.
+     *
+     * This is the implementation of the `autoparamCaptureStop` iocshell
+     * command.
+     */
+    void stopCapture();
+
+    /*! Issue the requests captured in the file at `path` and print a summary
+     * to `fp`.
+     *
+     * The requests of the replay do not call handlers. Instead, each gets
+     * the result recorded for the next call of the same variable and kind,
+     * starting over once those run out; requests for variables with no such
+     * calls are passed to the handlers as usual. Requests made by records
+     * while the replay runs are not affected. Only one replay can run at a
+     * time. Variables are matched
+     * by name, so the records that created them need not be loaded.
+     *
+     * With `speed` 0, requests are issued back to back and recorded results
+     * are returned immediately, which measures the overhead of dispatching
+     * requests and processing interrupts. Otherwise, both the times the
+     * requests were issued at and the durations of the handler calls are
+     * reproduced, sped up by the factor `speed`. Requests are issued
+     * synchronously from the calling thread, bypassing asyn's queues.
+     *
+     * This is the implementation of the `autoparamReplay` iocshell command.
+     */
+    asynStatus replayTraffic(char const *path, double speed, FILE *fp);
+
+    /*! Issue `count` requests for the variables of `function` from `threads`
+     * threads and print the achieved throughput and latency to `fp`.
+     *
+     * Each thread binds its own `asynUser`s to all the variables of the
+     * function that exist when the test starts, and issues requests through
+     * `pasynManager->queueRequest()` the way device support does, taking the
+     * variables in turn and waiting for each request to complete before
+     * issuing the next one. With `rate` greater than 0, requests are issued
+     * at that total rate per second; otherwise, back to back.
+     *
+     * Requests are reads, unless `write` is true. In that case, each thread
+     * reads all the variables first and then writes the values it has read
+     * back, so the state of the device is not changed. Reads of arrays and
+     * strings transfer at most 4096 bytes.
+     *
+     * The report gives percentiles of the time spent waiting in the queue,
+     * the time spent in the driver, and the end-to-end latency. With `rate`
+     * given, the latter is measured from the time the request was due rather
+     * than the time it was issued, so that a slow driver delaying later
+     * requests is not hidden by it.
+     *
+     * This is the implementation of the `autoparamLoad` iocshell command.
+     */
+    asynStatus generateLoad(char const *function, size_t count, int threads,
+                            double rate, bool write, FILE *fp);
+
     // Beyond this point, the methods are public because they are part of the
     // asyn interface, but subclasses shouldn't need to override them.
 
@@ -496,19 +1258,35 @@ class AUTOPARAMDRIVER_API Driver : public asynPortDriver {
     asynStatus writeOctet(asynUser *pasynUser, const char *value, size_t nChars,
                           size_t *nActual);
 
+    asynStatus readGenericPointer(asynUser *pasynUser, void *pointer);
+
+    asynStatus writeGenericPointer(asynUser *pasynUser, void *pointer);
+
+    // Don't hide the asynPortDriver overload taking an asyn index.
+    using asynPortDriver::doCallbacksGenericPointer;
+
   private:
+    friend class Snapshot;
+    friend class WriteBatch;
+    friend class EventLoop;
+
     static void destroyDriver(void *driver);
+    static void timeStampSourceCallback(void *driver,
+                                        epicsTimeStamp *timestamp);
 
     bool hasParam(int index);
 
+    asynStatus findOrCreateVariable(asynUser *pasynUser, const char *reason);
+
     void handleResultStatus(asynUser *pasynUser, ResultBase const &result);
+    void setParamResult(DeviceVariable const &var, ResultBase const &result);
 
     template <typename IntType>
     void getInterruptVarsForInterface(std::vector<DeviceVariable *> &dest,
                                       int canInterrupt, void *ifacePvt);
 
-    template <typename T> bool hasReadHandler(int index);
-    template <typename T> bool hasWriteHandler(int index);
+    template <typename T> bool hasReadHandler(DeviceVariable const &var);
+    template <typename T> bool hasWriteHandler(DeviceVariable const &var);
 
     bool shouldProcessInterrupts(WriteResult const &result) const;
     bool shouldProcessInterrupts(ResultBase const &result) const;
@@ -519,15 +1297,144 @@ class AUTOPARAMDRIVER_API Driver : public asynPortDriver {
     template <typename T> asynStatus setParamDispatch(int index, T value);
     template <typename T> asynStatus getParamDispatch(int index, T &value);
 
+    void const *findHandlers(asynParamType type, std::string const &function);
     template <typename T>
-    typename Handlers<T>::ReadHandler
-    getReadHandler(std::string const &function);
-    template <typename T>
-    typename Handlers<T>::WriteHandler
-    getWriteHandler(std::string const &function);
+    Handlers<T> const *getHandlers(DeviceVariable const &var) const;
 
     template <typename T>
-    bool checkHandlersVerbosely(std::string const &function);
+    bool checkHandlersVerbosely(DeviceVariable const &var);
+
+    // Settings and statistics of a function. `DeviceVariable` points to
+    // these, so they are allocated once per function and never moved.
+    struct FunctionInfo {
+        FunctionInfo() : overruns(0) { errors[0] = errors[1] = 0; }
+
+        FunctionOpts opts;
+        size_t overruns;
+        // Indexed by `RequestKind`.
+        LatencyHistogram latency[2];
+        size_t errors[2];
+    };
+
+    // The last known value of a `UInt32Digital` variable, see
+    // `FunctionOpts::setShadowRegister()`. Accessed by the handlers of the
+    // variable, with the driver or its device group locked.
+    struct ShadowRegister {
+        ShadowRegister() : value(0), known(0), verified(0) {}
+
+        epicsUInt32 value;
+        // The bits of `value` that are known.
+        epicsUInt32 known;
+        // When the whole register was last read, by epicsMonotonicGet().
+        epicsUInt64 verified;
+    };
+
+    // The polling state of a variable, see `FunctionOpts::setPollPeriod()`.
+    // Accessed with the driver locked.
+    struct PollState {
+        PollState() : var(NULL), next(0), active(false) {}
+
+        DeviceVariable *var;
+        // When the variable is next due, by epicsMonotonicGet().
+        epicsUInt64 next;
+        bool active;
+    };
+
+    // The health of a device, see `DriverOpts::setCircuitBreaker()`.
+    struct DeviceState {
+        DeviceState()
+            : name(NULL), failures(0), open(false), probing(false),
+              nextProbe(0) {}
+
+        std::string const *name;
+        std::vector<DeviceVariable *> vars;
+        int failures;
+        bool open;
+        bool probing;
+        epicsUInt64 nextProbe;
+    };
+
+    // A handler call in progress. Calls of functions with a deadline are
+    // linked into `m_inFlight` so that the watchdog can find them.
+    struct Request {
+        DeviceVariable const *var;
+        RequestKind kind;
+        epicsUInt64 start;
+        epicsUInt64 end;
+        // The replay running when the request began, if the request was
+        // issued by it.
+        TrafficReplay *replay;
+        bool overrunReported;
+        bool rejected;
+        bool probe;
+        // Whether the handler runs with the device group locked instead of
+        // the driver.
+        bool groupLocked;
+        // Whether the write was collected into a write batch instead of
+        // calling the handler.
+        bool staged;
+        Request *prev;
+        Request *next;
+    };
+
+    // An asyn port with its own queue and thread that handles the requests
+    // for a device group. asyn ports cannot be removed, so groups are never
+    // deleted.
+    struct DeviceGroup {
+        Driver *driver;
+        std::string name;
+        std::string portName;
+        int addr;
+        asynUser *pasynUser;
+        asynInterface common;
+        // Whether handlers run with the driver unlocked.
+        bool unlocked;
+        // Serializes handlers of the group in case an asynUser could not be
+        // moved to the group's port.
+        epicsMutex lock;
+    };
+
+    DeviceGroup *createGroup(std::string const &name,
+                             std::string const &groupPort,
+                             unsigned int priority, bool unlocked);
+    DeviceGroup *findOrCreateGroup(std::string const &name);
+    Snapshot *findOrCreateSnapshot(std::string const &name);
+    TrafficCall const *replayCall(Request &request, ResultBase &result);
+    void captureCall(Request const &request, ResultBase const &result,
+                     void const *data, size_t size, epicsUInt32 mask = 0);
+    void createLane();
+    DeviceGroup *joinThreadPool();
+    void applyThreadOptions(char const *port);
+    static void applyThreadOptionsCallback(asynUser *pasynUser);
+    DeviceGroup *groupOf(DeviceVariable const *var) const;
+    asynStatus moveUser(asynUser *pasynUser, char const *port, int addr);
+    void joinGroup(DeviceVariable const *var, asynUser *pasynUser);
+    bool leaveGroup(DeviceVariable const *var, asynUser *pasynUser);
+    static void groupReport(void *drvPvt, FILE *fp, int details);
+    static asynStatus groupConnect(void *drvPvt, asynUser *pasynUser);
+    static asynStatus groupDisconnect(void *drvPvt, asynUser *pasynUser);
+    static asynCommon groupCommon;
+
+    void initRequest(DeviceVariable const &var, RequestKind kind,
+                     asynUser const *pasynUser, Request &request);
+    bool beginRequest(DeviceVariable const &var, RequestKind kind,
+                      asynUser const *pasynUser, Request &request,
+                      bool switchToGroup = true);
+    void endRequest(Request &request, ResultBase &result);
+    asynStatus rejectRequest(asynUser *pasynUser, Request &request);
+    asynStatus rejectRequest(asynUser *pasynUser, DeviceVariable const &var,
+                             RequestKind kind);
+    bool admitRequest(DeviceState &device, Request &request);
+    void updateCircuit(DeviceState &device, Request const &request,
+                       asynStatus status);
+    void setDeviceStatus(DeviceState &device);
+    static FunctionInfo &functionInfo(DeviceVariable const &var);
+    void watchDeadlines();
+    void checkDeadlines(epicsUInt64 now);
+    static void runWatchdog(void *);
+    void collectMetrics(MetricsWriter &metrics);
+    static void runMetricsExport(void *);
+    char const *variableName(int index) const;
 
     template <typename T> asynStatus readScalar(asynUser *pasynUser, T *value);
     asynStatus readScalar(asynUser *pasynUser, epicsUInt32 *value,
@@ -535,6 +1442,11 @@ class AUTOPARAMDRIVER_API Driver : public asynPortDriver {
     template <typename T> asynStatus writeScalar(asynUser *pasynUser, T value);
     asynStatus writeScalar(asynUser *pasynUser, epicsUInt32 value,
                            epicsUInt32 mask);
+    void readShadow(DeviceVariable &var, ShadowRegister &shadow);
+    void stageWrite(Request &request, void const *data, size_t bytes,
+                    size_t size, epicsUInt32 mask);
+    WriteBatch *findOrCreateBatch(std::string const &name);
+    static void runBatchWindow(void *batch);
     template <typename T>
     asynStatus readArray(asynUser *pasynUser, T *value, size_t maxSize,
                          size_t *size);
@@ -544,6 +1456,8 @@ class AUTOPARAMDRIVER_API Driver : public asynPortDriver {
                              size_t *nRead);
     asynStatus writeOctetData(asynUser *pasynUser, char const *value,
                               size_t size);
+    asynStatus readPointer(asynUser *pasynUser, void *pointer);
+    asynStatus writePointer(asynUser *pasynUser, void *pointer);
 
     template <typename T> std::map<std::string, Handlers<T> > &getHandlerMap();
 
@@ -565,8 +1479,53 @@ class AUTOPARAMDRIVER_API Driver : public asynPortDriver {
 
     DriverOpts opts;
 
-    typedef std::map<int, DeviceVariable *> ParamMap;
+    // Declared before the variables it may contain; destroyed after them.
+    Arena m_arena;
+    // The sizes of the addresses and variables in use, as allocated by the
+    // derived driver. Accessed with the driver locked.
+    size_t m_addressBytes;
+    size_t m_variableBytes;
+    FlightRecorder m_recorder;
+    SlowRequestTracker m_slowRequests;
+    std::map<std::string, FunctionInfo> m_functionInfo;
+    epicsMutex m_inFlightLock;
+    Request *m_inFlight;
+    bool m_watched;
+    std::map<std::string, DeviceState> m_devices;
+    epicsMutex m_deviceLock;
+    std::map<std::string, DeviceGroup *> m_groups;
+    // The thread of the pool that handles requests for the variables not in a
+    // group, if the driver is in a pool.
+    DeviceGroup *m_pool;
+    // The port handling high priority functions, if there are any.
+    DeviceGroup *m_lane;
+    // How long handlers take, indexed by lane (normal, high priority) and
+    // `RequestKind`. Time spent in the queue is not known.
+    LatencyHistogram m_laneServiceTime[2][2];
+    // The number of handler calls in progress.
+    size_t m_active;
+    std::map<std::string, Snapshot *> m_snapshots;
+    // Indexed by asyn parameter index.
+    std::map<int, ShadowRegister> m_shadows;
+    std::map<std::string, WriteBatch *> m_batches;
+    // The requests of the writes of the batch being committed. Reused, as
+    // batches are committed with the driver locked.
+    std::vector<Request> m_batchRequests;
+    // Indexed by asyn parameter index.
+    std::map<int, PollState> m_polls;
+    // Created when the first descriptor is watched.
+    EventLoop *m_eventLoop;
+    TrafficCapture *m_capture;
+    // The replay in progress, if any. Only requests of its own asynUsers,
+    // whose `userPvt` points to it, get recorded results.
+    TrafficReplay *m_replay;
+
+    // Indexed by asyn parameter index. Parameters not created via
+    // drvUserCreate() have NULL entries.
+    typedef std::vector<DeviceVariable *> ParamMap;
     ParamMap m_params;
+    // Keys of this map also serve as interned function names that
+    // `DeviceVariable`s point to.
     std::map<std::string, asynParamType> m_functionTypes;
 
     // Type erasure for function pointers.
@@ -574,7 +1533,6 @@ class AUTOPARAMDRIVER_API Driver : public asynPortDriver {
     std::map<asynParamType, std::pair<VoidFuncPtr, VoidFuncPtr> >
         m_originalIntrRegister;
     std::vector<void*> m_hijackedInterfaces;
-    std::map<DeviceVariable *, int> m_interruptRefcount;
 
     std::map<std::string, Handlers<epicsInt32> > m_Int32HandlerMap;
     std::map<std::string, Handlers<epicsInt64> > m_Int64HandlerMap;
@@ -592,6 +1550,8 @@ class AUTOPARAMDRIVER_API Driver : public asynPortDriver {
         m_Float32ArrayHandlerMap;
     std::map<std::string, Handlers<Array<epicsFloat64 > > >
         m_Float64ArrayHandlerMap;
+    std::map<std::string, Handlers<GenericPointer> >
+        m_GenericPointerHandlerMap;
 };
 
 } // namespace Autoparam
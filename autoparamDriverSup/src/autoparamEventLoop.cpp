@@ -0,0 +1,190 @@
+// SPDX-FileCopyrightText: 2022 Cosylab d.d. https://www.cosylab.com
+//
+// SPDX-License-Identifier: MIT
+
+#include <cerrno>
+#include <cstring>
+#include <string>
+
+#include <errlog.h>
+#include <epicsThread.h>
+
+#ifdef __linux__
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+#endif
+
+#include "autoparamEventLoop.h"
+
+namespace Autoparam {
+
+namespace {
+
+char const *className = "Autoparam::EventLoop";
+
+// The most descriptors handled per wakeup. More ready descriptors are
+// handled in the next one.
+int const maxEvents = 64;
+
+} // namespace
+
+EventLoop::EventLoop(Driver *driver)
+    : m_driver(driver), m_epoll(-1), m_wakeup(-1), m_quit(false) {}
+
+// Called by the thread with the driver locked. Updates made by all handlers
+// are propagated to records at once.
+void EventLoop::dispatch(int const *fds, size_t count) {
+    m_driver->updateTimeStamp();
+    for (size_t i = 0; i < count; ++i) {
+        // The descriptor may have been removed since the events were
+        // collected.
+        std::map<int, Watch>::iterator w = m_watches.find(fds[i]);
+        if (w == m_watches.end()) {
+            continue;
+        }
+        if (!w->second.handler(fds[i], w->second.arg)) {
+            remove(fds[i]);
+        }
+    }
+    m_driver->callParamCallbacks();
+}
+
+#ifdef __linux__
+
+bool EventLoop::start() {
+    m_epoll = epoll_create1(EPOLL_CLOEXEC);
+    if (m_epoll < 0) {
+        errlogPrintf("%s: cannot create epoll instance: %s\n", className,
+                     strerror(errno));
+        return false;
+    }
+    m_wakeup = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    epoll_event event;
+    event.events = EPOLLIN;
+    event.data.fd = m_wakeup;
+    if (m_wakeup < 0 ||
+        epoll_ctl(m_epoll, EPOLL_CTL_ADD, m_wakeup, &event) != 0) {
+        errlogPrintf("%s: cannot create eventfd: %s\n", className,
+                     strerror(errno));
+        if (m_wakeup >= 0) {
+            close(m_wakeup);
+        }
+        close(m_epoll);
+        m_epoll = -1;
+        m_wakeup = -1;
+        return false;
+    }
+    if (epicsThreadCreate("autoparamEvents", m_driver->threadPriority(),
+                          epicsThreadGetStackSize(epicsThreadStackMedium), run,
+                          this) == NULL) {
+        // The destructor would wait for the thread forever.
+        errlogPrintf("%s: cannot create thread\n", className);
+        close(m_wakeup);
+        close(m_epoll);
+        m_epoll = -1;
+        m_wakeup = -1;
+        return false;
+    }
+    return true;
+}
+
+EventLoop::~EventLoop() {
+    if (m_epoll < 0) {
+        return;
+    }
+    m_driver->lock();
+    m_quit = true;
+    m_driver->unlock();
+    epicsUInt64 one = 1;
+    if (write(m_wakeup, &one, sizeof(one)) != sizeof(one)) {
+        errlogPrintf("%s: cannot wake up the thread: %s\n", className,
+                     strerror(errno));
+    }
+    m_done.wait();
+    close(m_wakeup);
+    close(m_epoll);
+}
+
+asynStatus EventLoop::add(int fd, DescriptorHandler handler, void *arg) {
+    if (m_epoll < 0 && !start()) {
+        return asynError;
+    }
+    epoll_event event;
+    event.events = EPOLLIN;
+    event.data.fd = fd;
+    int op = m_watches.count(fd) > 0 ? EPOLL_CTL_MOD : EPOLL_CTL_ADD;
+    if (epoll_ctl(m_epoll, op, fd, &event) != 0) {
+        errlogPrintf("%s: cannot watch descriptor %d: %s\n", className, fd,
+                     strerror(errno));
+        return asynError;
+    }
+    Watch &watch = m_watches[fd];
+    watch.handler = handler;
+    watch.arg = arg;
+    return asynSuccess;
+}
+
+asynStatus EventLoop::remove(int fd) {
+    if (m_watches.erase(fd) == 0) {
+        return asynError;
+    }
+    // Fails harmlessly if the descriptor was already closed.
+    epoll_ctl(m_epoll, EPOLL_CTL_DEL, fd, NULL);
+    return asynSuccess;
+}
+
+void EventLoop::run(void *arg) {
+    EventLoop *self = static_cast<EventLoop *>(arg);
+    self->m_driver->adoptThreadOptions(
+        (std::string(self->m_driver->portName) + ":events").c_str());
+    epoll_event events[maxEvents];
+    int fds[maxEvents];
+    for (;;) {
+        int count = epoll_wait(self->m_epoll, events, maxEvents, -1);
+        if (count < 0 && errno != EINTR) {
+            errlogPrintf("%s: epoll_wait failed: %s\n", className,
+                         strerror(errno));
+            epicsThreadSleep(1);
+        }
+        size_t ready = 0;
+        for (int i = 0; i < count; ++i) {
+            if (events[i].data.fd != self->m_wakeup) {
+                fds[ready++] = events[i].data.fd;
+            }
+        }
+
+        self->m_driver->lock();
+        bool quit = self->m_quit;
+        if (!quit && ready > 0) {
+            self->dispatch(fds, ready);
+        }
+        self->m_driver->unlock();
+        if (quit) {
+            break;
+        }
+    }
+    self->m_done.signal();
+}
+
+#else
+
+bool EventLoop::start() {
+    errlogPrintf("%s: not supported on this system\n", className);
+    return false;
+}
+
+EventLoop::~EventLoop() {}
+
+asynStatus EventLoop::add(int, DescriptorHandler, void *) {
+    start();
+    return asynError;
+}
+
+asynStatus EventLoop::remove(int) { return asynError; }
+
+void EventLoop::run(void *) {}
+
+#endif
+
+} // namespace Autoparam
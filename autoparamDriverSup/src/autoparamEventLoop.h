@@ -0,0 +1,54 @@
+// SPDX-FileCopyrightText: 2022 Cosylab d.d. https://www.cosylab.com
+//
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+// The thread of a driver waiting for file descriptors to become readable, see
+// `Driver::watchDescriptor()`. This header is private to the library.
+
+#include <map>
+
+#include <epicsEvent.h>
+
+#include "autoparamDriver.h"
+
+namespace Autoparam {
+
+class EventLoop {
+  public:
+    explicit EventLoop(Driver *driver);
+
+    // Stops the thread. Descriptors are not closed.
+    ~EventLoop();
+
+    // Called with the driver locked. The thread is started when the first
+    // descriptor is added.
+    asynStatus add(int fd, DescriptorHandler handler, void *arg);
+    asynStatus remove(int fd);
+
+  private:
+    struct Watch {
+        DescriptorHandler handler;
+        void *arg;
+    };
+
+    EventLoop(EventLoop const &);
+    EventLoop &operator=(EventLoop const &);
+
+    bool start();
+    static void run(void *loop);
+    void dispatch(int const *fds, size_t count);
+
+    Driver *m_driver;
+    // The epoll instance, or -1 if the thread is not running.
+    int m_epoll;
+    // An eventfd that wakes up the thread to make it quit.
+    int m_wakeup;
+    // The rest is only accessed with the driver locked.
+    std::map<int, Watch> m_watches;
+    bool m_quit;
+    epicsEvent m_done;
+};
+
+} // namespace Autoparam
@@ -12,11 +12,14 @@
 // EPICS includes
 #include <asynPortDriver.h>
 #include <alarm.h>
+#include <epicsTime.h>
 #include <epicsTypes.h>
 
 // API definition
 #include <autoparamDriverAPI.h>
 
+#include "autoparamArena.h"
+
 namespace Autoparam {
 
 /*! Represents parsed device address information.
@@ -36,13 +39,53 @@ namespace Autoparam {
  *
  * A `DeviceAddress` must be equality-comparable to other addresses. Two
  * addresses shall compare equal when they refer to the same device variable.
+ *
+ * Instances may be allocated from the driver's `Arena`; see `Driver::arena()`.
  */
 class AUTOPARAMDRIVER_API DeviceAddress {
   public:
     virtual ~DeviceAddress() {}
 
+    //! Allocates memory from the heap.
+    static void *operator new(size_t size);
+
+    //! Allocates memory from `arena`.
+    static void *operator new(size_t size, Arena &arena);
+
+    //! Frees memory, or gives it back to the `Arena` it was allocated from.
+    static void operator delete(void *ptr);
+
+    //! Called only if a constructor throws.
+    static void operator delete(void *ptr, Arena &arena);
+
     //! Compare to another address. Must be overridden.
     virtual bool operator==(DeviceAddress const &other) const = 0;
+
+    /*! Name the device this address belongs to.
+     *
+     * Addresses returning the same non-empty name belong to the same physical
+     * device, e.g. a controller reached over a network connection. The
+     * `Driver` uses this to track the health of devices; see
+     * `DriverOpts::setCircuitBreaker()`. It is called once per
+     * `DeviceVariable`, when the variable is created.
+     *
+     * The default implementation returns an empty string, meaning that the
+     * address is not associated with a particular device.
+     */
+    virtual std::string deviceName() const { return std::string(); }
+
+    /*! Name the group of devices this address belongs to.
+     *
+     * If enabled by `DriverOpts::setDeviceGroups()`, requests for each group
+     * are queued and handled separately from other groups, so that a slow
+     * device doesn't hold up devices in other groups. Like `deviceName()`, it
+     * is called once per `DeviceVariable`.
+     *
+     * The default implementation returns `deviceName()`, so each device is a
+     * group of its own. An empty string means that requests are handled by
+     * the `Driver`'s own asyn port.
+     */
+    virtual std::string deviceGroup() const { return deviceName(); }
 };
 
 /*! Represents a device variable and is a handle for asyn parameters.
@@ -57,7 +100,8 @@ class AUTOPARAMDRIVER_API DeviceAddress {
  *
  * `DeviceVariable` instances are created only once per device variable, and are
  * shared between records referring to the same device variable. They are
- * destroyed when the driver is destroyed.
+ * destroyed when the driver is destroyed. Like `DeviceAddress`, they may be
+ * allocated from the driver's `Arena`; see `Driver::arena()`.
  */
 class AUTOPARAMDRIVER_API DeviceVariable {
   public:
@@ -86,14 +130,29 @@ class AUTOPARAMDRIVER_API DeviceVariable {
 
     virtual ~DeviceVariable();
 
+    //! Allocates memory from the heap.
+    static void *operator new(size_t size);
+
+    //! Allocates memory from `arena`.
+    static void *operator new(size_t size, Arena &arena);
+
+    //! Frees memory, or gives it back to the `Arena` it was allocated from.
+    static void operator delete(void *ptr);
+
+    //! Called only if a constructor throws.
+    static void operator delete(void *ptr, Arena &arena);
+
     //! Returns the "function" given in the record.
-    std::string const &function() const { return m_function; }
+    std::string const &function() const { return *m_function; }
 
     /*! Returns the "function+arguments" string representation.
      *
      * The resulting string is used for display only, e.g. in error messages.
      */
-    std::string const &asString() const { return m_reasonString; };
+    std::string const &asString() const { return m_reasonString; }
+
+    //! Like `asString()`, for use with `printf()`-style functions.
+    char const *asCString() const { return m_reasonString.c_str(); }
 
     /*! Returns the index of the underlying asyn parameter.
      *
@@ -119,20 +178,46 @@ class AUTOPARAMDRIVER_API DeviceVariable {
      */
     DeviceAddress const &address() const { return *m_address; }
 
+    /*! Returns whether any `I/O Intr` or `asyn:READBACK` records are bound
+     * to the variable.
+     *
+     * Polling code can use it to skip variables nobody is listening to.
+     */
+    bool hasSubscribers() const { return m_interruptRefcount > 0; }
+
   private:
     friend class Driver;
 
     // Only the `Driver` has access to the reason string, so this constructor is
     // private. It also doesn't completely initialize `DeviceVariable`. That job
     // is up to `Driver::drvUserCreate()`. DeviceVariable takes ownership of the
-    // provided DeviceAddress object.
-    DeviceVariable(char const *reason, std::string const &function,
+    // provided DeviceAddress object. The function name is interned by the
+    // `Driver` and must outlive the variable.
+    DeviceVariable(char const *reason, std::string const *function,
                    DeviceAddress *addr);
 
     std::string m_reasonString;
-    std::string m_function;
+    std::string const *m_function;
     asynParamType m_asynParamType;
     int m_asynParamIndex;
+    int m_interruptRefcount;
+    // Points to the `Handlers<T>` registered for the function.
+    void const *m_handlers;
+    // Points to the `Driver`'s settings and statistics for the function.
+    void *m_functionInfo;
+    // Points to the `Driver`'s state of the device the variable belongs to,
+    // if the driver tracks it.
+    void *m_device;
+    // Points to the `Driver`'s device group the variable belongs to, if any.
+    void *m_group;
+    // Points to the `Driver`'s shadow register of the variable, if its
+    // function keeps one.
+    void *m_shadow;
+    // Points to the `Driver`'s write batch the variable belongs to, if any.
+    void *m_batch;
+    // Points to the `Driver`'s polling state of the variable, if its function
+    // is polled.
+    void *m_poll;
     DeviceAddress *m_address;
 };
 
@@ -243,6 +328,35 @@ class Octet : public Array<char> {
     }
 };
 
+/*! A non-owning reference to structured data passed around by pointer.
+ *
+ * `GenericPointer` corresponds to the `asynGenericPointer` interface. It allows
+ * the driver to hand large structured payloads (e.g. images or event packets)
+ * to consumers in the same IOC without serializing them into arrays or
+ * strings. The meaning of the pointed-to data is a matter of agreement between
+ * the driver and its consumers; autoparamDriver never dereferences it.
+ *
+ * **Note:** the asyn parameter library cannot store pointers. Consequently,
+ * `GenericPointer` values are not cached by `Driver` and cannot be used with
+ * `Driver::setParam()` and `Driver::getParam()`; use
+ * `Driver::doCallbacksGenericPointer()` to propagate them to interrupt
+ * subscribers.
+ */
+class GenericPointer {
+  public:
+    //! Construct a `GenericPointer` referring to `pointer`.
+    explicit GenericPointer(void *pointer) : m_pointer(pointer) {}
+
+    //! Returns the raw pointer.
+    void *get() const { return m_pointer; }
+
+    //! Returns the pointer cast to the type agreed upon with the consumer.
+    template <typename T> T *as() const { return static_cast<T *>(m_pointer); }
+
+  private:
+    void *m_pointer;
+};
+
 /*! A tri-state determining whether `I/O Intr` records should be processed.
  *
  * Used in `ResultBase` to determine whether interrupts should be processed.
@@ -323,9 +437,19 @@ struct ResultBase {
      */
     ProcessInterrupts processInterrupts;
 
+    /*! The time the value was acquired or written by the device.
+     *
+     * If set by the handler, it is passed to the record (which uses it when
+     * its `TSE` field is -2) and to `I/O Intr` records processed as a result
+     * of this request. If left at zero (the default), the time given by the
+     * driver's time stamp source is used instead; see
+     * `DriverOpts::setTimeStampSource()`.
+     */
+    epicsTimeStamp timestamp;
+
     ResultBase()
         : status(asynSuccess), alarmStatus(epicsAlarmNone),
-          alarmSeverity(epicsSevNone), processInterrupts() {}
+          alarmSeverity(epicsSevNone), processInterrupts(), timestamp() {}
 };
 
 //! %Result returned from a write handler, status only.
@@ -348,6 +472,12 @@ template <typename T> struct Result : ResultBase {
  */
 template <> struct Result<Octet> : ResultBase {};
 
+/*! %Result returned from `GenericPointer` read handler, status only.
+ *
+ * The read handler fills in the data pointed to by its argument.
+ */
+template <> struct Result<GenericPointer> : ResultBase {};
+
 //! Return string representation of the given asyn parameter type.
 char const *getAsynTypeName(asynParamType type);
 
@@ -367,6 +497,7 @@ char const *getAsynTypeName(asynParamType type);
  *   - `Array<epicsInt64>` → `asynParamInt64Array`
  *   - `Array<epicsFloat32>` → `asynParamFloat32Array`
  *   - `Array<epicsFloat64>` → `asynParamFloat64Array`
+ *   - `GenericPointer` → `asynParamGenericPointer`
  */
 #ifdef DOXYGEN_RUNNING
 template <typename T> struct AsynType { static const asynParamType value; };
@@ -497,6 +628,11 @@ template <> struct AsynType<Array<epicsFloat64> > {
     static const asynParamType value = asynParamFloat64Array;
 };
 
+typedef Handlers<GenericPointer> GenericPointerHandlers;
+template <> struct AsynType<GenericPointer> {
+    static const asynParamType value = asynParamGenericPointer;
+};
+
 /*! Signatures of handlers for `epicsUInt32`.
  *
  * `epicsUInt32` (a.k.a. `asynParamUInt32Digital`) is used for digital (i.e.
@@ -552,6 +688,35 @@ template <> struct Handlers<Octet, false> {
     Handlers() : writeHandler(NULL), readHandler(NULL), intrRegistrar(NULL) {}
 };
 
+/*! Signatures of handlers for `GenericPointer`.
+ *
+ * Both handlers receive the pointer provided by the caller. The write handler
+ * reads the structure it points to, while the read handler fills it in.
+ *
+ * Because pointers cannot be stored in asyn parameters, the default (`NULL`)
+ * write handler only passes the pointer on to interrupt subscribers, and there
+ * is no default read handler.
+ */
+template <> struct Handlers<GenericPointer, false> {
+    typedef Autoparam::WriteResult WriteResult;
+    //! %Result type for `GenericPointer` reads (essentially `ArrayResult`).
+    typedef Result<GenericPointer> ReadResult;
+    //! Writes the data referred to by `value` to the device.
+    typedef WriteResult (*WriteHandler)(DeviceVariable &var,
+                                        GenericPointer value);
+    //! Reads data from the device, storing it where `value` points to.
+    typedef ReadResult (*ReadHandler)(DeviceVariable &var,
+                                      GenericPointer value);
+
+    static const asynParamType type = AsynType<GenericPointer>::value;
+
+    WriteHandler writeHandler;
+    ReadHandler readHandler;
+    InterruptRegistrar intrRegistrar;
+
+    Handlers() : writeHandler(NULL), readHandler(NULL), intrRegistrar(NULL) {}
+};
+
 /*! Symbols that are often needed when implementing drivers.
  *
  * This namespace is meant to be used as
@@ -564,6 +729,7 @@ template <> struct Handlers<Octet, false> {
  *   - `Autoparam::DeviceVariable`
  *   - `Autoparam::Array`
  *   - `Autoparam::Octet`
+ *   - `Autoparam::GenericPointer`
  *   - `Autoparam::Result`
  */
 namespace Convenience {
@@ -571,6 +737,7 @@ namespace Convenience {
 using Autoparam::Array;
 using Autoparam::DeviceAddress;
 using Autoparam::DeviceVariable;
+using Autoparam::GenericPointer;
 using Autoparam::Octet;
 using Autoparam::Result;
 typedef Autoparam::WriteResult WriteResult;
@@ -580,6 +747,7 @@ typedef Result<epicsInt64> Int64ReadResult;
 typedef Result<epicsUInt32> UInt32ReadResult;
 typedef Result<epicsFloat64> Float64ReadResult;
 typedef Result<Octet> OctetReadResult;
+typedef Result<GenericPointer> GenericPointerReadResult;
 } // namespace Convenience
 
 } // namespace Autoparam
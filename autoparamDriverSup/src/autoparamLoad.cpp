@@ -0,0 +1,296 @@
+// SPDX-FileCopyrightText: 2022 Cosylab d.d. https://www.cosylab.com
+//
+// SPDX-License-Identifier: MIT
+
+#include <algorithm>
+#include <cstdio>
+
+#include <epicsEvent.h>
+#include <epicsThread.h>
+#include <epicsTime.h>
+
+#include "autoparamDriver.h"
+#include "autoparamClient.h"
+
+namespace Autoparam {
+
+namespace {
+
+char const *driverName = "Autoparam::Driver";
+
+// How much of an array or string a read transfers.
+size_t const readBytes = 4096;
+
+struct LoadTarget {
+    std::string name;
+    asynParamType type;
+};
+
+// One thread of a load test, issuing its share of the requests through its
+// own asynUsers.
+class LoadWorker {
+  public:
+    LoadWorker(char const *port, std::vector<LoadTarget> const &targets,
+               size_t first, size_t count, double interval, bool write)
+        : m_port(port), m_targets(targets), m_first(first), m_count(count),
+          m_interval(interval), m_write(write), m_failed(0) {
+        m_wait.reserve(count);
+        m_service.reserve(count);
+        m_total.reserve(count);
+    }
+
+    ~LoadWorker() {
+        for (size_t i = 0; i < m_users.size(); ++i) {
+            disconnectClient(m_users[i]);
+        }
+    }
+
+    // Connects the asynUsers. Returns false if none could be connected.
+    bool connect() {
+        m_users.resize(m_targets.size());
+        bool any = false;
+        for (size_t i = 0; i < m_targets.size(); ++i) {
+            any |= connectClient(m_users[i], m_port, m_targets[i].name,
+                                 m_targets[i].type, process, this);
+        }
+        return any;
+    }
+
+    void start() {
+        epicsThreadCreate("autoparamLoad", epicsThreadPriorityMedium,
+                          epicsThreadGetStackSize(epicsThreadStackMedium), run,
+                          this);
+    }
+
+    void join() { m_finished.wait(); }
+
+    std::vector<epicsUInt64> const &wait() const { return m_wait; }
+    std::vector<epicsUInt64> const &service() const { return m_service; }
+    std::vector<epicsUInt64> const &total() const { return m_total; }
+    size_t failed() const { return m_failed; }
+
+  private:
+    static void run(void *arg) {
+        LoadWorker *worker = static_cast<LoadWorker *>(arg);
+        worker->issueAll();
+        worker->m_finished.signal();
+    }
+
+    // Called by asyn when a request is dequeued.
+    static void process(asynUser *pasynUser) {
+        LoadWorker *worker = static_cast<LoadWorker *>(pasynUser->userPvt);
+        worker->m_started = epicsMonotonicGet();
+        worker->m_status =
+            clientRequest(worker->m_users[worker->m_current], worker->m_kind,
+                          worker->m_buffer, 0xffffffff);
+        worker->m_completed = epicsMonotonicGet();
+        worker->m_done.signal();
+    }
+
+    // Queues a request and waits for it to complete.
+    asynStatus issue(size_t target, RequestKind kind) {
+        m_current = target;
+        m_kind = kind;
+        m_queued = epicsMonotonicGet();
+        asynStatus status = pasynManager->queueRequest(
+            m_users[target].pasynUser, asynQueuePriorityLow, 0);
+        if (status != asynSuccess) {
+            m_started = m_completed = epicsMonotonicGet();
+            return status;
+        }
+        m_done.wait();
+        return m_status;
+    }
+
+    void issueAll() {
+        std::vector<size_t> targets;
+        for (size_t i = 0; i < m_users.size(); ++i) {
+            if (m_users[i].iface != NULL) {
+                targets.push_back(i);
+            }
+        }
+
+        // Values to write back, by target. Variables that cannot be read are
+        // not written to, as there is no value that would leave them as they
+        // were.
+        std::vector<std::vector<char> > values(m_users.size());
+        if (m_write) {
+            std::vector<size_t> readable;
+            for (size_t i = 0; i < targets.size(); ++i) {
+                m_buffer.assign(readBytes, 0);
+                if (issue(targets[i], RequestRead) == asynSuccess) {
+                    values[targets[i]].swap(m_buffer);
+                    readable.push_back(targets[i]);
+                }
+            }
+            targets.swap(readable);
+        }
+        if (targets.empty()) {
+            m_failed = m_count;
+            return;
+        }
+
+        epicsUInt64 begin = epicsMonotonicGet();
+        for (size_t i = 0; i < m_count; ++i) {
+            epicsUInt64 due = begin;
+            if (m_interval > 0) {
+                due += static_cast<epicsUInt64>(i * m_interval * 1e9);
+                epicsUInt64 now = epicsMonotonicGet();
+                if (due > now) {
+                    epicsThreadSleep((due - now) * 1e-9);
+                }
+            }
+            size_t target = targets[(m_first + i) % targets.size()];
+            if (m_write) {
+                m_buffer = values[target];
+            } else {
+                m_buffer.assign(readBytes, 0);
+            }
+            asynStatus status =
+                issue(target, m_write ? RequestWrite : RequestRead);
+            if (status != asynSuccess) {
+                m_failed++;
+            }
+            m_wait.push_back(m_started - m_queued);
+            m_service.push_back(m_completed - m_started);
+            m_total.push_back(m_completed - (m_interval > 0 ? due : m_queued));
+        }
+    }
+
+    char const *m_port;
+    std::vector<LoadTarget> const &m_targets;
+    size_t m_first;
+    size_t m_count;
+    double m_interval;
+    bool m_write;
+
+    std::vector<ClientUser> m_users;
+    epicsEvent m_done;
+    epicsEvent m_finished;
+
+    // The request in progress, shared with `process()`, which runs on the
+    // thread of the port. Access is ordered by `m_done`.
+    size_t m_current;
+    RequestKind m_kind;
+    std::vector<char> m_buffer;
+    asynStatus m_status;
+    epicsUInt64 m_queued;
+    epicsUInt64 m_started;
+    epicsUInt64 m_completed;
+
+    std::vector<epicsUInt64> m_wait;
+    std::vector<epicsUInt64> m_service;
+    std::vector<epicsUInt64> m_total;
+    size_t m_failed;
+};
+
+// Sorts `samples` and prints their percentiles in microseconds.
+void printPercentiles(FILE *fp, char const *label,
+                      std::vector<epicsUInt64> &samples) {
+    static double const percentiles[] = {0.5, 0.9, 0.99, 0.999};
+    size_t const numPercentiles = sizeof(percentiles) / sizeof(percentiles[0]);
+
+    if (samples.empty()) {
+        return;
+    }
+    std::sort(samples.begin(), samples.end());
+    fprintf(fp, "%-13s", label);
+    for (size_t i = 0; i < numPercentiles; ++i) {
+        // The sample at the given fraction of the sorted samples.
+        size_t rank = static_cast<size_t>(percentiles[i] * samples.size());
+        rank = std::min(rank, samples.size() - 1);
+        fprintf(fp, " %12.1f", samples[rank] * 1e-3);
+    }
+    fprintf(fp, " %12.1f\n", samples.back() * 1e-3);
+}
+
+} // namespace
+
+asynStatus Driver::generateLoad(char const *function, size_t count,
+                                int threads, double rate, bool write,
+                                FILE *fp) {
+    std::vector<LoadTarget> targets;
+    lock();
+    std::vector<DeviceVariable *> vars = getAllVariables();
+    for (size_t i = 0; i < vars.size(); ++i) {
+        if (vars[i]->function() == function) {
+            LoadTarget target;
+            target.name = vars[i]->asString();
+            target.type = vars[i]->asynType();
+            targets.push_back(target);
+        }
+    }
+    unlock();
+
+    if (targets.empty()) {
+        fprintf(fp, "%s: port=%s has no variables of function %s\n",
+                driverName, portName, function);
+        return asynError;
+    }
+    threads = std::max(threads, 1);
+    if (count == 0) {
+        return asynSuccess;
+    }
+
+    // Each thread gets its share of the rate, and starts with a different
+    // variable so they don't all hit the same one at once.
+    double interval = rate > 0 ? threads / rate : 0;
+    std::vector<LoadWorker *> workers;
+    for (int i = 0; i < threads; ++i) {
+        size_t share =
+            count / threads + (static_cast<size_t>(i) < count % threads);
+        workers.push_back(new LoadWorker(portName, targets, i, share, interval,
+                                         write));
+    }
+    if (!workers.front()->connect()) {
+        fprintf(fp, "%s: port=%s cannot issue requests for function %s\n",
+                driverName, portName, function);
+        for (size_t i = 0; i < workers.size(); ++i) {
+            delete workers[i];
+        }
+        return asynError;
+    }
+    for (size_t i = 1; i < workers.size(); ++i) {
+        workers[i]->connect();
+    }
+
+    epicsUInt64 begin = epicsMonotonicGet();
+    for (size_t i = 0; i < workers.size(); ++i) {
+        workers[i]->start();
+    }
+    std::vector<epicsUInt64> wait, service, total;
+    size_t failed = 0;
+    for (size_t i = 0; i < workers.size(); ++i) {
+        workers[i]->join();
+        wait.insert(wait.end(), workers[i]->wait().begin(),
+                    workers[i]->wait().end());
+        service.insert(service.end(), workers[i]->service().begin(),
+                       workers[i]->service().end());
+        total.insert(total.end(), workers[i]->total().begin(),
+                     workers[i]->total().end());
+        failed += workers[i]->failed();
+    }
+    double elapsed = (epicsMonotonicGet() - begin) * 1e-9;
+    for (size_t i = 0; i < workers.size(); ++i) {
+        delete workers[i];
+    }
+
+    fprintf(fp,
+            "%s: port=%s issued %lu %s of %lu variables from %d threads in "
+            "%.3f s",
+            driverName, portName, (unsigned long)total.size(),
+            write ? "writes" : "reads", (unsigned long)targets.size(), threads,
+            elapsed);
+    if (elapsed > 0) {
+        fprintf(fp, " (%.0f requests/s)", total.size() / elapsed);
+    }
+    fprintf(fp, ", %lu failed\n", (unsigned long)failed);
+    fprintf(fp, "%-13s %12s %12s %12s %12s %12s\n", "[us]", "p50", "p90",
+            "p99", "p99.9", "max");
+    printPercentiles(fp, "queue wait", wait);
+    printPercentiles(fp, "service", service);
+    printPercentiles(fp, "end to end", total);
+    return failed == 0 ? asynSuccess : asynError;
+}
+
+} // namespace Autoparam
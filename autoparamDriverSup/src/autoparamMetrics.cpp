@@ -0,0 +1,317 @@
+// SPDX-FileCopyrightText: 2022 Cosylab d.d. https://www.cosylab.com
+//
+// SPDX-License-Identifier: MIT
+
+#include <algorithm>
+#include <cstdio>
+
+#include <epicsAtomic.h>
+#include <epicsEvent.h>
+#include <epicsMutex.h>
+#include <epicsThread.h>
+#include <errlog.h>
+
+#include "autoparamDriver.h"
+#include "autoparamMetrics.h"
+
+namespace Autoparam {
+
+namespace {
+
+char const *driverName = "Autoparam::Driver";
+
+char const *const durationFamily = "autoparam_request_duration_seconds";
+char const *const errorsFamily = "autoparam_request_errors_total";
+char const *const overrunsFamily = "autoparam_deadline_overruns_total";
+char const *const variablesFamily = "autoparam_variables";
+char const *const subscribersFamily = "autoparam_interrupt_subscribers";
+char const *const activeFamily = "autoparam_requests_in_progress";
+char const *const circuitFamily = "autoparam_circuit_open";
+char const *const failuresFamily = "autoparam_device_failures";
+
+// Guards the sources and the settings of the export.
+epicsMutex &metricsLock() {
+    static epicsMutex lock;
+    return lock;
+}
+
+std::vector<Driver *> &metricsSources() {
+    static std::vector<Driver *> drivers;
+    return drivers;
+}
+
+struct MetricsExport {
+    MetricsExport() : period(0), started(false), collecting(NULL) {}
+
+    std::string path;
+    double period;
+    bool started;
+    // Signalled when the settings change.
+    epicsEvent wakeup;
+    // The driver whose metrics are being collected, without holding the
+    // lock. It is not destroyed until the collection is done.
+    Driver *collecting;
+    // Signalled when a collection is done.
+    epicsEvent collected;
+};
+
+MetricsExport &metricsExport() {
+    static MetricsExport settings;
+    return settings;
+}
+
+void declareMetrics(MetricsWriter &metrics) {
+    metrics.declare(durationFamily, "histogram",
+                    "Duration of handler calls.");
+    metrics.declare(errorsFamily, "counter",
+                    "Requests that failed, including those rejected by the "
+                    "circuit breaker.");
+    metrics.declare(overrunsFamily, "counter",
+                    "Handler calls that exceeded the deadline of the "
+                    "function.");
+    metrics.declare(variablesFamily, "gauge", "Device variables.");
+    metrics.declare(subscribersFamily, "gauge",
+                    "I/O Intr subscriptions to device variables.");
+    metrics.declare(activeFamily, "gauge", "Handler calls in progress.");
+    metrics.declare(circuitFamily, "gauge",
+                    "Whether the circuit breaker of a device is open.");
+    metrics.declare(failuresFamily, "gauge",
+                    "Consecutive failed requests of a device.");
+}
+
+} // namespace
+
+void MetricsWriter::declare(char const *name, char const *type,
+                            char const *help) {
+    Family &family = m_families[name];
+    family.header = std::string("# HELP ") + name + " " + help + "\n# TYPE " +
+                    name + " " + type + "\n";
+    m_order.push_back(name);
+}
+
+void MetricsWriter::sample(char const *family, std::string const &labels,
+                           double value, char const *suffix) {
+    std::map<std::string, Family>::iterator i = m_families.find(family);
+    if (i == m_families.end()) {
+        return;
+    }
+    char number[32];
+    sprintf(number, "%.15g", value);
+    i->second.samples += std::string(family) + suffix + "{" + labels + "} " +
+                         number + "\n";
+}
+
+std::string MetricsWriter::label(char const *name, std::string const &value) {
+    std::string result = name;
+    result += "=\"";
+    for (size_t i = 0; i < value.size(); ++i) {
+        if (value[i] == '\\' || value[i] == '"') {
+            result += '\\';
+            result += value[i];
+        } else if (value[i] == '\n') {
+            result += "\\n";
+        } else {
+            result += value[i];
+        }
+    }
+    result += '"';
+    return result;
+}
+
+bool MetricsWriter::write(std::string const &path) const {
+    std::string tmp = path + ".tmp";
+    FILE *file = fopen(tmp.c_str(), "w");
+    if (file == NULL) {
+        return false;
+    }
+    for (size_t i = 0; i < m_order.size(); ++i) {
+        Family const &family = m_families.find(m_order[i])->second;
+        fputs(family.header.c_str(), file);
+        fputs(family.samples.c_str(), file);
+    }
+    bool ok = !ferror(file);
+    ok = fclose(file) == 0 && ok;
+    if (!ok) {
+        remove(tmp.c_str());
+        return false;
+    }
+    if (rename(tmp.c_str(), path.c_str()) != 0) {
+        // Windows doesn't replace existing files.
+        remove(path.c_str());
+        if (rename(tmp.c_str(), path.c_str()) != 0) {
+            remove(tmp.c_str());
+            return false;
+        }
+    }
+    return true;
+}
+
+void addMetricsSource(Driver *driver) {
+    metricsLock().lock();
+    metricsSources().push_back(driver);
+    metricsLock().unlock();
+}
+
+void removeMetricsSource(Driver *driver) {
+    MetricsExport &settings = metricsExport();
+    metricsLock().lock();
+    std::vector<Driver *> &drivers = metricsSources();
+    drivers.erase(std::remove(drivers.begin(), drivers.end(), driver),
+                  drivers.end());
+    while (settings.collecting == driver) {
+        metricsLock().unlock();
+        // Another driver being destroyed may consume the signal.
+        settings.collected.wait(0.1);
+        metricsLock().lock();
+    }
+    metricsLock().unlock();
+}
+
+void Driver::exportMetrics(char const *path, double period) {
+    MetricsExport &settings = metricsExport();
+    metricsLock().lock();
+    settings.path = path != NULL ? path : "";
+    settings.period = settings.path.empty() ? 0 : std::max(period, 0.0);
+    bool start = !settings.started && settings.period > 0;
+    if (start) {
+        settings.started = true;
+    }
+    metricsLock().unlock();
+
+    if (start) {
+        epicsThreadCreate("autoparamMetrics", epicsThreadPriorityLow,
+                          epicsThreadGetStackSize(epicsThreadStackSmall),
+                          runMetricsExport, NULL);
+    } else {
+        settings.wakeup.signal();
+    }
+}
+
+void Driver::runMetricsExport(void *) {
+    MetricsExport &settings = metricsExport();
+    bool failing = false;
+    for (;;) {
+        metricsLock().lock();
+        std::string path = settings.path;
+        double period = settings.period;
+        if (period <= 0) {
+            metricsLock().unlock();
+            settings.wakeup.wait();
+            continue;
+        }
+        std::vector<Driver *> drivers = metricsSources();
+        metricsLock().unlock();
+
+        // Drivers are collected without holding the lock, so that a driver
+        // that stays locked for long does not hold up the others or the
+        // construction of new drivers.
+        MetricsWriter metrics;
+        declareMetrics(metrics);
+        for (std::vector<Driver *>::iterator i = drivers.begin(),
+                                             end = drivers.end();
+             i != end; ++i) {
+            metricsLock().lock();
+            std::vector<Driver *> const &current = metricsSources();
+            bool present = std::find(current.begin(), current.end(), *i) !=
+                           current.end();
+            settings.collecting = present ? *i : NULL;
+            metricsLock().unlock();
+            if (!present) {
+                // Destroyed in the meantime.
+                continue;
+            }
+            (*i)->collectMetrics(metrics);
+            metricsLock().lock();
+            settings.collecting = NULL;
+            metricsLock().unlock();
+            settings.collected.signal();
+        }
+
+        // Only report the first of consecutive failures.
+        bool ok = metrics.write(path);
+        if (!ok && !failing) {
+            errlogPrintf("%s: cannot write metrics to %s\n", driverName,
+                         path.c_str());
+        }
+        failing = !ok;
+        settings.wakeup.wait(period);
+    }
+}
+
+void Driver::collectMetrics(MetricsWriter &metrics) {
+    std::string port = MetricsWriter::label("port", portName);
+
+    // Variables and subscribers by function.
+    std::map<std::string, std::pair<size_t, size_t> > counts;
+    lock();
+    for (ParamMap::const_iterator i = m_params.begin(), end = m_params.end();
+         i != end; ++i) {
+        if (*i != NULL) {
+            std::pair<size_t, size_t> &count = counts[(*i)->function()];
+            count.first++;
+            count.second += (*i)->m_interruptRefcount;
+        }
+    }
+    // Entries are never removed or moved, so they can be used unlocked.
+    std::vector<std::pair<std::string, FunctionInfo *> > functions;
+    for (std::map<std::string, FunctionInfo>::iterator
+             i = m_functionInfo.begin(),
+             end = m_functionInfo.end();
+         i != end; ++i) {
+        functions.push_back(std::make_pair(i->first, &i->second));
+    }
+    unlock();
+
+    for (size_t f = 0; f < functions.size(); ++f) {
+        std::string const &function = functions[f].first;
+        FunctionInfo &info = *functions[f].second;
+        std::string labels =
+            port + "," + MetricsWriter::label("function", function);
+        for (int kind = RequestRead; kind <= RequestWrite; ++kind) {
+            std::string kindLabels =
+                labels + "," +
+                MetricsWriter::label("kind",
+                                     kind == RequestRead ? "read" : "write");
+            size_t buckets[LatencyHistogram::numBuckets];
+            info.latency[kind].snapshot(buckets);
+            size_t total = 0;
+            for (size_t b = 0; b < LatencyHistogram::numBuckets; ++b) {
+                total += buckets[b];
+                char le[32] = "+Inf";
+                if (b + 1 < LatencyHistogram::numBuckets) {
+                    sprintf(le, "%g",
+                            LatencyHistogram::bucketLimit(b) * 1e-6);
+                }
+                metrics.sample(durationFamily,
+                               kindLabels + "," +
+                                   MetricsWriter::label("le", le),
+                               total, "_bucket");
+            }
+            metrics.sample(durationFamily, kindLabels,
+                           info.latency[kind].sum() * 1e-6, "_sum");
+            metrics.sample(durationFamily, kindLabels, total, "_count");
+            metrics.sample(errorsFamily, kindLabels,
+                           epicsAtomicGetSizeT(&info.errors[kind]));
+        }
+        metrics.sample(overrunsFamily, labels,
+                       epicsAtomicGetSizeT(&info.overruns));
+        metrics.sample(variablesFamily, labels, counts[function].first);
+        metrics.sample(subscribersFamily, labels, counts[function].second);
+    }
+
+    metrics.sample(activeFamily, port, epicsAtomicGetSizeT(&m_active));
+
+    m_deviceLock.lock();
+    for (std::map<std::string, DeviceState>::const_iterator
+             i = m_devices.begin(),
+             end = m_devices.end();
+         i != end; ++i) {
+        std::string labels =
+            port + "," + MetricsWriter::label("device", i->first);
+        metrics.sample(circuitFamily, labels, i->second.open);
+        metrics.sample(failuresFamily, labels, i->second.failures);
+    }
+    m_deviceLock.unlock();
+}
+
+} // namespace Autoparam
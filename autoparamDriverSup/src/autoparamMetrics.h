@@ -0,0 +1,54 @@
+// SPDX-FileCopyrightText: 2022 Cosylab d.d. https://www.cosylab.com
+//
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+// Metrics of all drivers in the Prometheus text exposition format, written
+// for the textfile collector of the node exporter. This header is private to
+// the library.
+
+#include <map>
+#include <string>
+#include <vector>
+
+namespace Autoparam {
+
+class Driver;
+
+// Collects samples grouped by metric family, so that the samples of all
+// drivers can be added one driver at a time.
+class MetricsWriter {
+  public:
+    // Adds a family. Families are written in the order they were declared.
+    void declare(char const *name, char const *type, char const *help);
+
+    // Adds a sample to a declared family. `labels` is a comma-separated list
+    // of labels made by `label()`, and `suffix` is appended to the name of
+    // the family, e.g. "_bucket" for histograms.
+    void sample(char const *family, std::string const &labels, double value,
+                char const *suffix = "");
+
+    // Returns `name="value"`, with `value` escaped.
+    static std::string label(char const *name, std::string const &value);
+
+    // Writes all families to a temporary file next to `path` and renames it
+    // to `path`. Returns false if that fails.
+    bool write(std::string const &path) const;
+
+  private:
+    struct Family {
+        std::string header;
+        std::string samples;
+    };
+
+    std::vector<std::string> m_order;
+    std::map<std::string, Family> m_families;
+};
+
+// Drivers whose metrics are exported. Drivers add themselves when they are
+// created and remove themselves when they are destroyed.
+void addMetricsSource(Driver *driver);
+void removeMetricsSource(Driver *driver);
+
+} // namespace Autoparam
@@ -0,0 +1,43 @@
+// SPDX-FileCopyrightText: 2022 Cosylab d.d. https://www.cosylab.com
+//
+// SPDX-License-Identifier: MIT
+
+#include <cerrno>
+#include <cstdlib>
+
+#include "autoparamParse.h"
+
+namespace Autoparam {
+
+bool parseNumber(std::string const &text, unsigned long &value) {
+    // strtoul() accepts a sign and negates the result.
+    if (text.empty() || text[0] == '-' || text[0] == '+') {
+        return false;
+    }
+    char *end;
+    errno = 0;
+    value = strtoul(text.c_str(), &end, 0);
+    return errno == 0 && *end == 0;
+}
+
+bool parseDouble(std::string const &text, double &value) {
+    char *end;
+    value = strtod(text.c_str(), &end);
+    return !text.empty() && *end == 0;
+}
+
+bool parseBitfield(std::string const &text, unsigned maxBits, unsigned &shift,
+                   unsigned &bits) {
+    size_t colon = text.find(':');
+    unsigned long lsb, msb;
+    if (colon == std::string::npos || !parseNumber(text.substr(0, colon), lsb) ||
+        !parseNumber(text.substr(colon + 1), msb) || msb < lsb ||
+        msb >= maxBits) {
+        return false;
+    }
+    shift = lsb;
+    bits = msb - lsb + 1;
+    return true;
+}
+
+} // namespace Autoparam
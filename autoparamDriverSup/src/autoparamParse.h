@@ -0,0 +1,24 @@
+// SPDX-FileCopyrightText: 2022 Cosylab d.d. https://www.cosylab.com
+//
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+// Parsing of numbers in record arguments and description files. This header
+// is private to the library.
+
+#include <string>
+
+namespace Autoparam {
+
+// Parses a non-negative number in decimal or, with the 0x prefix, hex.
+bool parseNumber(std::string const &text, unsigned long &value);
+
+// Parses a floating point number.
+bool parseDouble(std::string const &text, double &value);
+
+// Parses a bitfield given as <lsb>:<msb>, where msb is below `maxBits`.
+bool parseBitfield(std::string const &text, unsigned maxBits, unsigned &shift,
+                   unsigned &bits);
+
+} // namespace Autoparam
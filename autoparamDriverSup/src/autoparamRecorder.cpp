@@ -0,0 +1,225 @@
+// SPDX-FileCopyrightText: 2022 Cosylab d.d. https://www.cosylab.com
+//
+// SPDX-License-Identifier: MIT
+
+#include <algorithm>
+#include <cstdlib>
+#include <new>
+
+#include <epicsAtomic.h>
+
+#include "autoparamRecorder.h"
+
+namespace Autoparam {
+
+FlightRecorder::FlightRecorder(size_t capacity)
+    : m_slots(NULL), m_capacity(0), m_next(0) {
+    if (capacity == 0) {
+        return;
+    }
+    m_capacity = 1;
+    while (m_capacity < capacity) {
+        m_capacity <<= 1;
+    }
+    m_slots = static_cast<Slot *>(calloc(m_capacity, sizeof(Slot)));
+    if (m_slots == NULL) {
+        throw std::bad_alloc();
+    }
+    for (size_t i = 0; i < m_capacity; ++i) {
+        m_slots[i].sequence = emptySlot;
+    }
+}
+
+FlightRecorder::~FlightRecorder() { free(m_slots); }
+
+void FlightRecorder::record(Entry const &entry) {
+    if (m_slots == NULL) {
+        return;
+    }
+    // Writers only contend on the counter and get consecutive slots. Readers
+    // detect torn entries by checking the sequence number before and after
+    // copying a slot.
+    size_t ticket = epicsAtomicIncrSizeT(&m_next) - 1;
+    size_t sequence = ticket + 1;
+    Slot &slot = m_slots[ticket & (m_capacity - 1)];
+
+    // Writers a whole lap apart get the same slot. Claim it only if it holds
+    // an older entry that is not being written; otherwise, drop this entry.
+    // The sequence number that would mark the slot as being written when the
+    // counter wraps around is skipped the same way.
+    size_t previous = epicsAtomicGetSizeT(&slot.sequence);
+    if (sequence == 0 || previous == 0 ||
+        static_cast<ptrdiff_t>(sequence - previous) <= 0 ||
+        epicsAtomicCmpAndSwapSizeT(&slot.sequence, previous, 0) != previous) {
+        return;
+    }
+    epicsAtomicWriteMemoryBarrier();
+    slot.entry = entry;
+    epicsAtomicWriteMemoryBarrier();
+    epicsAtomicSetSizeT(&slot.sequence, sequence);
+}
+
+size_t FlightRecorder::snapshot(std::vector<Entry> &dest, size_t count) const {
+    size_t end = epicsAtomicGetSizeT(&m_next);
+    if (count > m_capacity) {
+        count = m_capacity;
+    }
+    if (count > end) {
+        count = end;
+    }
+
+    dest.reserve(dest.size() + count);
+    for (size_t ticket = end - count; ticket != end; ++ticket) {
+        Slot const &slot = m_slots[ticket & (m_capacity - 1)];
+        if (epicsAtomicGetSizeT(&slot.sequence) != ticket + 1) {
+            continue;
+        }
+        epicsAtomicReadMemoryBarrier();
+        Entry entry = slot.entry;
+        epicsAtomicReadMemoryBarrier();
+        if (epicsAtomicGetSizeT(&slot.sequence) != ticket + 1) {
+            continue;
+        }
+        dest.push_back(entry);
+    }
+    return end;
+}
+
+namespace {
+
+size_t clampToSize(epicsUInt64 value) {
+    size_t const max = static_cast<size_t>(-1);
+    return value > max ? max : static_cast<size_t>(value);
+}
+
+} // namespace
+
+SlowRequestTracker::SlowRequestTracker(size_t capacity)
+    : m_capacity(capacity), m_floor(0), m_logThreshold(0), m_logInterval(0),
+      m_lastLog(0), m_suppressed(0) {
+    m_heap.reserve(capacity);
+}
+
+bool SlowRequestTracker::slower(Entry const &a, Entry const &b) {
+    return a.duration > b.duration;
+}
+
+bool SlowRequestTracker::add(FlightRecorder::Entry const &entry,
+                             size_t &suppressed) {
+    // Most calls are faster than any of the tracked ones and not worth
+    // logging. Reject them before taking the lock.
+    size_t duration = clampToSize(entry.duration);
+    size_t logThreshold = epicsAtomicGetSizeT(&m_logThreshold);
+    bool overThreshold = logThreshold > 0 && duration >= logThreshold;
+    if (m_capacity == 0 ||
+        (duration <= epicsAtomicGetSizeT(&m_floor) && !overThreshold)) {
+        return false;
+    }
+
+    epicsUInt64 monoNow = epicsMonotonicGet();
+    Entry slow;
+    epicsTimeGetCurrent(&slow.time);
+    epicsTimeAddSeconds(&slow.time,
+                        -1e-9 * static_cast<double>(monoNow - entry.start));
+    slow.duration = entry.duration;
+    slow.asynIndex = entry.asynIndex;
+    slow.kind = entry.kind;
+    slow.status = entry.status;
+
+    bool log = false;
+    m_lock.lock();
+    if (m_heap.size() < m_capacity) {
+        m_heap.push_back(slow);
+        std::push_heap(m_heap.begin(), m_heap.end(), slower);
+    } else if (slow.duration > m_heap.front().duration) {
+        std::pop_heap(m_heap.begin(), m_heap.end(), slower);
+        m_heap.back() = slow;
+        std::push_heap(m_heap.begin(), m_heap.end(), slower);
+    }
+    if (m_heap.size() == m_capacity) {
+        epicsAtomicSetSizeT(&m_floor, clampToSize(m_heap.front().duration));
+    }
+
+    if (overThreshold) {
+        if (m_lastLog == 0 || monoNow - m_lastLog >= m_logInterval) {
+            log = true;
+            suppressed = m_suppressed;
+            m_suppressed = 0;
+            m_lastLog = monoNow;
+        } else {
+            m_suppressed++;
+        }
+    }
+    m_lock.unlock();
+    return log;
+}
+
+void SlowRequestTracker::setLogging(double threshold, double minInterval) {
+    m_lock.lock();
+    m_logInterval = static_cast<epicsUInt64>(std::max(minInterval, 0.0) * 1e9);
+    m_suppressed = 0;
+    epicsAtomicSetSizeT(&m_logThreshold,
+                        clampToSize(static_cast<epicsUInt64>(
+                            std::max(threshold, 0.0) * 1e9)));
+    m_lock.unlock();
+}
+
+void SlowRequestTracker::reset() {
+    m_lock.lock();
+    m_heap.clear();
+    epicsAtomicSetSizeT(&m_floor, 0);
+    m_lock.unlock();
+}
+
+void SlowRequestTracker::snapshot(std::vector<Entry> &dest) const {
+    m_lock.lock();
+    size_t first = dest.size();
+    dest.insert(dest.end(), m_heap.begin(), m_heap.end());
+    m_lock.unlock();
+    std::sort(dest.begin() + first, dest.end(), slower);
+}
+
+LatencyHistogram::LatencyHistogram() : m_sum(0) {
+    std::fill(m_counts, m_counts + numBuckets, 0);
+}
+
+void LatencyHistogram::add(epicsUInt64 duration) {
+    epicsUInt64 micros = duration / 1000;
+    size_t bucket = 0;
+    while (bucket < numBuckets - 1 && micros >= bucketLimit(bucket)) {
+        bucket++;
+    }
+    epicsAtomicIncrSizeT(&m_counts[bucket]);
+    epicsAtomicAddSizeT(&m_sum, static_cast<size_t>(micros));
+}
+
+void LatencyHistogram::snapshot(size_t dest[numBuckets]) const {
+    for (size_t i = 0; i < numBuckets; ++i) {
+        dest[i] = epicsAtomicGetSizeT(&m_counts[i]);
+    }
+}
+
+size_t LatencyHistogram::sum() const { return epicsAtomicGetSizeT(&m_sum); }
+
+void LatencyHistogram::report(FILE *fp, char const *indent) const {
+    size_t counts[numBuckets];
+    snapshot(counts);
+    for (size_t bucket = 0; bucket < numBuckets; ++bucket) {
+        if (counts[bucket] == 0) {
+            continue;
+        }
+        fputs(indent, fp);
+        printBucket(fp, bucket);
+        fprintf(fp, " %12lu\n", (unsigned long)counts[bucket]);
+    }
+}
+
+void LatencyHistogram::printBucket(FILE *fp, size_t bucket) {
+    if (bucket + 1 < numBuckets) {
+        fprintf(fp, "< %8lu us", (unsigned long)bucketLimit(bucket));
+    } else {
+        fprintf(fp, "%-13s", "longer");
+    }
+}
+
+} // namespace Autoparam
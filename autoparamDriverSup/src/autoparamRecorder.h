@@ -0,0 +1,217 @@
+// SPDX-FileCopyrightText: 2022 Cosylab d.d. https://www.cosylab.com
+//
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+#include <cstddef>
+#include <cstdio>
+#include <vector>
+
+#include <epicsMutex.h>
+#include <epicsTime.h>
+#include <epicsTypes.h>
+
+// API definition
+#include <autoparamDriverAPI.h>
+
+namespace Autoparam {
+
+//! The kind of request dispatched to a handler.
+enum RequestKind { RequestRead, RequestWrite };
+
+/*! A fixed-size record of the most recent requests processed by a `Driver`.
+ *
+ * Each `Driver` owns a `FlightRecorder` and adds an entry to it for every call
+ * of a read or write handler. Once the recorder is full, the oldest entries are
+ * overwritten. Recording an entry takes neither locks nor memory allocations,
+ * so the recorder can always stay enabled, and the entries can be inspected
+ * even when the driver is stuck. See `Driver::flightRecorderReport()` and
+ * `Driver::flightRecorderTrace()`.
+ *
+ * The recorder can be sized or disabled by
+ * `DriverOpts::setFlightRecorderSize()`.
+ */
+class AUTOPARAMDRIVER_API FlightRecorder {
+  public:
+    //! Information about one handler call.
+    struct Entry {
+        //! When the handler was called, as given by `epicsMonotonicGet()`.
+        epicsUInt64 start;
+        //! How long the handler took, in nanoseconds.
+        epicsUInt64 duration;
+        //! The asyn index of the `DeviceVariable`.
+        epicsInt32 asynIndex;
+        //! A `RequestKind`.
+        epicsUInt8 kind;
+        //! An `asynParamType`.
+        epicsUInt8 type;
+        //! The `asynStatus` returned by the handler.
+        epicsInt16 status;
+    };
+
+    /*! Construct a recorder keeping the last `capacity` entries.
+     *
+     * `capacity` is rounded up to a power of two. If it is zero, nothing is
+     * recorded.
+     */
+    explicit FlightRecorder(size_t capacity);
+    ~FlightRecorder();
+
+    /*! Add an entry, overwriting the oldest one if the recorder is full.
+     *
+     * If the slot for the entry is still being written by a call a whole
+     * recorder length behind, the entry is dropped instead.
+     */
+    void record(Entry const &entry);
+
+    /*! Copy up to `count` most recent entries to `dest`, oldest first.
+     *
+     * Entries that are being overwritten while copying are skipped. Returns the
+     * total number of entries recorded so far, including the overwritten ones.
+     */
+    size_t snapshot(std::vector<Entry> &dest, size_t count) const;
+
+    //! The number of entries that can be kept.
+    size_t capacity() const { return m_capacity; }
+
+  private:
+    FlightRecorder(FlightRecorder const &);
+    FlightRecorder &operator=(FlightRecorder const &);
+
+    struct Slot {
+        // 0 while the slot is being written, emptySlot before it is first
+        // written, otherwise the index of the entry in the slot plus one.
+        size_t sequence;
+        Entry entry;
+    };
+
+    static size_t const emptySlot = ~static_cast<size_t>(0);
+
+    Slot *m_slots;
+    size_t m_capacity;
+    size_t m_next;
+};
+
+/*! Keeps track of the slowest handler calls of a `Driver`.
+ *
+ * Each `Driver` owns a `SlowRequestTracker` which keeps the `capacity` slowest
+ * handler calls since it was created or last reset. Calls that are faster than
+ * all the tracked ones are rejected without locking. See
+ * `Driver::slowRequestReport()`.
+ *
+ * Optionally, calls slower than a threshold can be logged. Logging is rate
+ * limited, so that it cannot slow down the driver when many calls are slow.
+ * See `DriverOpts::setSlowRequestLogging()`.
+ */
+class AUTOPARAMDRIVER_API SlowRequestTracker {
+  public:
+    //! Information about one slow handler call.
+    struct Entry {
+        //! When the handler was called.
+        epicsTimeStamp time;
+        //! How long the handler took, in nanoseconds.
+        epicsUInt64 duration;
+        //! The asyn index of the `DeviceVariable`.
+        epicsInt32 asynIndex;
+        //! A `RequestKind`.
+        epicsUInt8 kind;
+        //! The `asynStatus` returned by the handler.
+        epicsInt16 status;
+    };
+
+    //! Construct a tracker keeping `capacity` slowest calls.
+    explicit SlowRequestTracker(size_t capacity);
+
+    /*! Consider a handler call for tracking and logging.
+     *
+     * Returns true if the call should be logged: it took longer than the log
+     * threshold, and no other call was logged within the minimum log interval.
+     * In that case, `suppressed` is set to the number of calls over the
+     * threshold that were not logged since the last logged one.
+     */
+    bool add(FlightRecorder::Entry const &entry, size_t &suppressed);
+
+    /*! Set the log threshold and the minimum interval between log messages,
+     * both in seconds. A threshold of 0 disables logging.
+     */
+    void setLogging(double threshold, double minInterval);
+
+    //! Forget all tracked calls.
+    void reset();
+
+    //! Copy the tracked calls to `dest`, slowest first.
+    void snapshot(std::vector<Entry> &dest) const;
+
+    //! The number of calls that can be tracked.
+    size_t capacity() const { return m_capacity; }
+
+  private:
+    static bool slower(Entry const &a, Entry const &b);
+
+    mutable epicsMutex m_lock;
+    size_t m_capacity;
+    // A min-heap ordered by duration, so that the fastest tracked call is at
+    // the front.
+    std::vector<Entry> m_heap;
+    // Durations in nanoseconds, read without locking on every call. Clamped to
+    // the range of size_t, which only matters on 32-bit systems.
+    size_t m_floor;
+    size_t m_logThreshold;
+    epicsUInt64 m_logInterval;
+    epicsUInt64 m_lastLog;
+    size_t m_suppressed;
+};
+
+/*! Counts handler calls by their duration.
+ *
+ * The durations are counted in buckets whose limits are powers of two
+ * microseconds. Adding a call takes neither locks nor memory allocations. Each
+ * `Driver` keeps histograms for each request lane; see
+ * `FunctionOpts::setHighPriority()` and `Driver::laneReport()`.
+ */
+class AUTOPARAMDRIVER_API LatencyHistogram {
+  public:
+    //! The number of buckets.
+    static size_t const numBuckets = 24;
+
+    LatencyHistogram();
+
+    //! Count a call that took `duration` nanoseconds.
+    void add(epicsUInt64 duration);
+
+    //! Copy the counts of all buckets to `dest`.
+    void snapshot(size_t dest[numBuckets]) const;
+
+    /*! The total duration of the calls counted, in microseconds.
+     *
+     * On 32-bit systems, this wraps around after about an hour of calls.
+     */
+    size_t sum() const;
+
+    /*! The duration in microseconds that calls in `bucket` are shorter than.
+     *
+     * The last bucket has no limit; it counts all calls longer than the limit
+     * of the bucket before it.
+     */
+    static epicsUInt64 bucketLimit(size_t bucket) {
+        return static_cast<epicsUInt64>(1) << bucket;
+    }
+
+    /*! Print the count of each bucket that is not empty to `fp`, one per
+     * line preceded by `indent`.
+     */
+    void report(FILE *fp, char const *indent = "") const;
+
+    /*! Print the label of `bucket` to `fp`, 13 characters wide.
+     *
+     * For reports that show several histograms side by side.
+     */
+    static void printBucket(FILE *fp, size_t bucket);
+
+  private:
+    size_t m_counts[numBuckets];
+    size_t m_sum;
+};
+
+} // namespace Autoparam
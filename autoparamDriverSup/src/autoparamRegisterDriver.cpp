@@ -0,0 +1,766 @@
+// SPDX-FileCopyrightText: 2022 Cosylab d.d. https://www.cosylab.com
+//
+// SPDX-License-Identifier: MIT
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <vector>
+
+#include <epicsEvent.h>
+#include <epicsThread.h>
+
+#include "autoparamParse.h"
+#include "autoparamRegisterDriver.h"
+
+namespace Autoparam {
+
+namespace {
+
+enum RegisterType {
+    TypeInt8,
+    TypeUInt8,
+    TypeInt16,
+    TypeUInt16,
+    TypeInt32,
+    TypeUInt32,
+    TypeInt64,
+    TypeUInt64,
+    TypeFloat32,
+    TypeFloat64
+};
+
+struct TypeInfo {
+    char const *name;
+    size_t width;
+    bool isSigned;
+    bool isFloat;
+};
+
+// Indexed by `RegisterType`.
+TypeInfo const typeInfo[] = {
+    {"int8", 1, true, false},     {"uint8", 1, false, false},
+    {"int16", 2, true, false},    {"uint16", 2, false, false},
+    {"int32", 4, true, false},    {"uint32", 4, false, false},
+    {"int64", 8, true, false},    {"uint64", 8, false, false},
+    {"float32", 4, true, true},   {"float64", 8, true, true},
+};
+
+size_t const numTypes = sizeof(typeInfo) / sizeof(typeInfo[0]);
+
+char const *driverName = "Autoparam::RegisterDriver";
+
+} // namespace
+
+struct RegisterGroup;
+
+// A line of the description.
+struct RegisterEntry {
+    std::string name;
+    size_t offset;
+    RegisterType type;
+    bool readable;
+    bool writable;
+    unsigned shift;
+    // 0 for the whole register.
+    unsigned bits;
+    bool scaled;
+    double eslo;
+    double eoff;
+    RegisterGroup *group;
+
+    size_t width() const { return typeInfo[type].width; }
+
+    asynParamType asynType() const {
+        if (scaled || typeInfo[type].isFloat) {
+            return asynParamFloat64;
+        }
+        return width() == 8 ? asynParamInt64 : asynParamInt32;
+    }
+};
+
+struct RegisterGroup {
+    RegisterGroup()
+        : driver(NULL), bus(NULL), period(0), gap(0), quit(false),
+          transfers(0), cycles(0) {}
+
+    RegisterDriver *driver;
+    RegisterBus *bus;
+    std::string name;
+    double period;
+    size_t gap;
+    // Set by the driver, while locked, when it is destroyed.
+    bool quit;
+    epicsEvent wakeup;
+    epicsEvent done;
+    // The rest is only accessed while the driver is locked.
+    std::vector<char> buffer;
+    size_t transfers;
+    size_t cycles;
+};
+
+struct RegisterTable {
+    ~RegisterTable() {
+        for (size_t i = 0; i < entries.size(); ++i) {
+            delete entries[i];
+        }
+        for (size_t i = 0; i < groups.size(); ++i) {
+            delete groups[i];
+        }
+    }
+
+    // Returns false and sets `error` if the line is not valid.
+    bool parseLine(std::string const &line, std::string &error);
+    bool parseGroup(std::istringstream &is, std::string &error);
+    bool parseRegister(std::string const &name, std::istringstream &is,
+                       std::string &error);
+
+    std::vector<RegisterEntry *> entries;
+    std::map<std::string, RegisterEntry *> byName;
+    std::vector<RegisterGroup *> groups;
+    std::map<std::string, RegisterGroup *> groupsByName;
+};
+
+bool RegisterTable::parseLine(std::string const &line, std::string &error) {
+    std::istringstream is(line);
+    std::string first;
+    if (!(is >> first) || first[0] == '#') {
+        return true;
+    }
+    if (first == "group") {
+        return parseGroup(is, error);
+    }
+    return parseRegister(first, is, error);
+}
+
+bool RegisterTable::parseGroup(std::istringstream &is, std::string &error) {
+    RegisterGroup *group = new RegisterGroup;
+    std::string period;
+    std::string gap;
+    unsigned long value = 0;
+    if (!(is >> group->name >> period) ||
+        !parseDouble(period, group->period) || group->period <= 0 ||
+        ((is >> gap) && !parseNumber(gap, value))) {
+        error = "expected group <name> <period> [<gap>]";
+        delete group;
+        return false;
+    }
+    group->gap = value;
+    if (groupsByName.count(group->name) > 0) {
+        error = "duplicate group " + group->name;
+        delete group;
+        return false;
+    }
+    groups.push_back(group);
+    groupsByName[group->name] = group;
+    return true;
+}
+
+bool RegisterTable::parseRegister(std::string const &name,
+                                  std::istringstream &is,
+                                  std::string &error) {
+    std::string offset, type, access;
+    unsigned long value;
+    if (!(is >> offset >> type >> access)) {
+        error = "expected <name> <offset> <type> <access>";
+        return false;
+    }
+    if (byName.count(name) > 0) {
+        error = "duplicate register " + name;
+        return false;
+    }
+
+    RegisterEntry entry;
+    entry.name = name;
+    entry.shift = 0;
+    entry.bits = 0;
+    entry.scaled = false;
+    entry.eslo = 1;
+    entry.eoff = 0;
+    entry.group = NULL;
+    if (!parseNumber(offset, value)) {
+        error = "bad offset " + offset;
+        return false;
+    }
+    entry.offset = value;
+
+    size_t t = 0;
+    while (t < numTypes && type != typeInfo[t].name) {
+        ++t;
+    }
+    if (t == numTypes) {
+        error = "unknown type " + type;
+        return false;
+    }
+    entry.type = static_cast<RegisterType>(t);
+
+    if (access != "ro" && access != "wo" && access != "rw") {
+        error = "access must be ro, wo or rw";
+        return false;
+    }
+    entry.readable = access != "wo";
+    entry.writable = access != "ro";
+
+    std::string token;
+    while (is >> token) {
+        size_t eq = token.find('=');
+        std::string key = token.substr(0, eq);
+        std::string arg = eq == std::string::npos ? "" : token.substr(eq + 1);
+        if (key == "bits") {
+            if (!parseBitfield(arg, entry.width() * 8, entry.shift,
+                               entry.bits)) {
+                error = "bits must be <lsb>:<msb> within the register";
+                return false;
+            }
+        } else if (key == "eslo" && parseDouble(arg, entry.eslo) &&
+                   entry.eslo != 0) {
+            entry.scaled = true;
+        } else if (key == "eoff" && parseDouble(arg, entry.eoff)) {
+            entry.scaled = true;
+        } else if (key == "group" && groupsByName.count(arg) > 0) {
+            entry.group = groupsByName[arg];
+        } else {
+            error = "bad or unknown argument " + token;
+            return false;
+        }
+    }
+
+    if (typeInfo[entry.type].isFloat && (entry.bits > 0 || entry.scaled)) {
+        error = "floating point registers have no bitfields or conversion";
+        return false;
+    }
+    if (entry.offset % entry.width() != 0) {
+        error = "offset is not aligned to the width";
+        return false;
+    }
+    if (entry.group != NULL && !entry.readable) {
+        error = "write-only registers cannot be polled";
+        return false;
+    }
+    if (entry.bits > 0 && !entry.readable) {
+        // A bitfield write keeps the other bits, which requires reading them.
+        error = "write-only registers cannot have bitfields";
+        return false;
+    }
+
+    RegisterEntry *copy = new RegisterEntry(entry);
+    entries.push_back(copy);
+    byName[name] = copy;
+    return true;
+}
+
+namespace {
+
+class TableAddress : public DeviceAddress {
+  public:
+    explicit TableAddress(RegisterEntry const *entry) : entry(entry) {}
+
+    bool operator==(DeviceAddress const &other) const {
+        return entry == static_cast<TableAddress const &>(other).entry;
+    }
+
+    RegisterEntry const *entry;
+};
+
+class TableVariable : public DeviceVariable {
+  public:
+    TableVariable(DeviceVariable *baseVar, RegisterBus *bus)
+        : DeviceVariable(baseVar),
+          entry(static_cast<TableAddress const &>(address()).entry),
+          bus(bus) {}
+
+    RegisterEntry const *entry;
+    RegisterBus *bus;
+};
+
+epicsUInt64 loadRaw(char const *src, size_t width) {
+    switch (width) {
+    case 1: {
+        epicsUInt8 value;
+        std::memcpy(&value, src, sizeof(value));
+        return value;
+    }
+    case 2: {
+        epicsUInt16 value;
+        std::memcpy(&value, src, sizeof(value));
+        return value;
+    }
+    case 4: {
+        epicsUInt32 value;
+        std::memcpy(&value, src, sizeof(value));
+        return value;
+    }
+    default: {
+        epicsUInt64 value;
+        std::memcpy(&value, src, sizeof(value));
+        return value;
+    }
+    }
+}
+
+void storeRaw(char *dest, size_t width, epicsUInt64 raw) {
+    switch (width) {
+    case 1: {
+        epicsUInt8 value = static_cast<epicsUInt8>(raw);
+        std::memcpy(dest, &value, sizeof(value));
+        break;
+    }
+    case 2: {
+        epicsUInt16 value = static_cast<epicsUInt16>(raw);
+        std::memcpy(dest, &value, sizeof(value));
+        break;
+    }
+    case 4: {
+        epicsUInt32 value = static_cast<epicsUInt32>(raw);
+        std::memcpy(dest, &value, sizeof(value));
+        break;
+    }
+    default:
+        std::memcpy(dest, &raw, sizeof(raw));
+    }
+}
+
+// The number of bits of the value of a register or bitfield.
+unsigned fieldBits(RegisterEntry const &reg) {
+    return reg.bits > 0 ? reg.bits : static_cast<unsigned>(reg.width() * 8);
+}
+
+epicsUInt64 fieldMask(RegisterEntry const &reg) {
+    unsigned bits = fieldBits(reg);
+    return bits >= 64 ? ~static_cast<epicsUInt64>(0)
+                      : (static_cast<epicsUInt64>(1) << bits) - 1;
+}
+
+epicsInt64 toInteger(RegisterEntry const &reg, epicsUInt64 raw) {
+    epicsUInt64 field = (raw >> reg.shift) & fieldMask(reg);
+    unsigned bits = fieldBits(reg);
+    if (typeInfo[reg.type].isSigned && bits < 64 &&
+        (field >> (bits - 1)) & 1) {
+        field |= ~fieldMask(reg);
+    }
+    return static_cast<epicsInt64>(field);
+}
+
+double toDouble(RegisterEntry const &reg, epicsUInt64 raw) {
+    if (reg.type == TypeFloat32) {
+        epicsUInt32 bits = static_cast<epicsUInt32>(raw);
+        epicsFloat32 value;
+        std::memcpy(&value, &bits, sizeof(value));
+        return value;
+    }
+    if (reg.type == TypeFloat64) {
+        epicsFloat64 value;
+        std::memcpy(&value, &raw, sizeof(value));
+        return value;
+    }
+    return toInteger(reg, raw) * reg.eslo + reg.eoff;
+}
+
+// The value of the field, not yet shifted into place.
+epicsUInt64 fromInteger(RegisterEntry const &reg, epicsInt64 value) {
+    return static_cast<epicsUInt64>(value) & fieldMask(reg);
+}
+
+epicsUInt64 fromDouble(RegisterEntry const &reg, double value) {
+    if (reg.type == TypeFloat32) {
+        epicsFloat32 single = static_cast<epicsFloat32>(value);
+        epicsUInt32 bits;
+        std::memcpy(&bits, &single, sizeof(bits));
+        return bits;
+    }
+    if (reg.type == TypeFloat64) {
+        epicsUInt64 bits;
+        std::memcpy(&bits, &value, sizeof(bits));
+        return bits;
+    }
+    double raw = std::floor((value - reg.eoff) / reg.eslo + 0.5);
+    return fromInteger(reg, static_cast<epicsInt64>(raw));
+}
+
+template <typename T> T decode(RegisterEntry const &reg, epicsUInt64 raw);
+
+template <>
+epicsInt32 decode<epicsInt32>(RegisterEntry const &reg, epicsUInt64 raw) {
+    return static_cast<epicsInt32>(toInteger(reg, raw));
+}
+
+template <>
+epicsInt64 decode<epicsInt64>(RegisterEntry const &reg, epicsUInt64 raw) {
+    return toInteger(reg, raw);
+}
+
+template <>
+epicsFloat64 decode<epicsFloat64>(RegisterEntry const &reg, epicsUInt64 raw) {
+    return toDouble(reg, raw);
+}
+
+epicsUInt64 encode(RegisterEntry const &reg, epicsInt32 value) {
+    return fromInteger(reg, value);
+}
+
+epicsUInt64 encode(RegisterEntry const &reg, epicsInt64 value) {
+    return fromInteger(reg, value);
+}
+
+epicsUInt64 encode(RegisterEntry const &reg, epicsFloat64 value) {
+    return fromDouble(reg, value);
+}
+
+asynStatus readRegister(TableVariable &var, epicsUInt64 &raw) {
+    char buffer[8];
+    RegisterEntry const &reg = *var.entry;
+    asynStatus status = var.bus->read(reg.offset, reg.width(), 1, buffer);
+    raw = status == asynSuccess ? loadRaw(buffer, reg.width()) : 0;
+    return status;
+}
+
+// Bitfields are read, modified and written back; parseRegister() makes sure
+// their registers are readable.
+asynStatus writeRegister(TableVariable &var, epicsUInt64 field) {
+    RegisterEntry const &reg = *var.entry;
+    epicsUInt64 raw = field << reg.shift;
+    if (reg.bits > 0) {
+        epicsUInt64 old;
+        asynStatus status = readRegister(var, old);
+        if (status != asynSuccess) {
+            return status;
+        }
+        epicsUInt64 mask = fieldMask(reg) << reg.shift;
+        raw = (old & ~mask) | (raw & mask);
+    }
+    char buffer[8];
+    storeRaw(buffer, reg.width(), raw);
+    return var.bus->write(reg.offset, reg.width(), 1, buffer);
+}
+
+template <typename T> Result<T> readHandler(DeviceVariable &baseVar) {
+    Result<T> result;
+    TableVariable &var = static_cast<TableVariable &>(baseVar);
+    epicsUInt64 raw;
+    result.status = readRegister(var, raw);
+    result.value = decode<T>(*var.entry, raw);
+    return result;
+}
+
+template <typename T>
+WriteResult writeHandler(DeviceVariable &baseVar, T value) {
+    WriteResult result;
+    TableVariable &var = static_cast<TableVariable &>(baseVar);
+    result.status = writeRegister(var, encode(*var.entry, value));
+    return result;
+}
+
+template <typename T> WriteResult refuseWrite(DeviceVariable &, T) {
+    WriteResult result;
+    result.status = asynError;
+    result.alarmStatus = epicsAlarmWrite;
+    result.alarmSeverity = epicsSevInvalid;
+    return result;
+}
+
+bool byOffset(DeviceVariable const *a, DeviceVariable const *b) {
+    return static_cast<TableVariable const *>(a)->entry->offset <
+           static_cast<TableVariable const *>(b)->entry->offset;
+}
+
+template <typename T>
+asynStatus setMember(Snapshot &snapshot, TableVariable const &var,
+                     epicsUInt64 raw) {
+    return snapshot.setValue(var, decode<T>(*var.entry, raw));
+}
+
+// Reads the members of a polling group, coalescing registers of the same
+// width that are at most `gap` bytes apart into block transfers.
+asynStatus pollGroup(Snapshot &snapshot) {
+    // Registers that no record subscribes to are not read; passive records
+    // read them on their own.
+    std::vector<DeviceVariable *> vars;
+    std::vector<DeviceVariable *> const &members = snapshot.variables();
+    for (size_t i = 0; i < members.size(); ++i) {
+        if (members[i]->hasSubscribers()) {
+            vars.push_back(members[i]);
+        }
+    }
+    if (vars.empty()) {
+        return asynSuccess;
+    }
+
+    std::sort(vars.begin(), vars.end(), byOffset);
+    RegisterGroup &group =
+        *static_cast<TableVariable *>(vars.front())->entry->group;
+
+    size_t transfers = 0;
+    size_t first = 0;
+    while (first < vars.size()) {
+        RegisterEntry const &start =
+            *static_cast<TableVariable *>(vars[first])->entry;
+        size_t width = start.width();
+        size_t end = start.offset + width;
+        size_t last = first + 1;
+        for (; last < vars.size(); ++last) {
+            RegisterEntry const &next =
+                *static_cast<TableVariable *>(vars[last])->entry;
+            if (next.width() != width || next.offset > end + group.gap) {
+                break;
+            }
+            end = std::max(end, next.offset + width);
+        }
+
+        size_t count = (end - start.offset) / width;
+        group.buffer.resize(count * width);
+        asynStatus status =
+            group.bus->read(start.offset, width, count, &group.buffer[0]);
+        transfers++;
+        if (status != asynSuccess) {
+            group.transfers = transfers;
+            return status;
+        }
+        for (size_t i = first; i < last; ++i) {
+            TableVariable const &var = *static_cast<TableVariable *>(vars[i]);
+            epicsUInt64 raw = loadRaw(
+                &group.buffer[var.entry->offset - start.offset], width);
+            switch (var.asynType()) {
+            case asynParamInt32:
+                setMember<epicsInt32>(snapshot, var, raw);
+                break;
+            case asynParamInt64:
+                setMember<epicsInt64>(snapshot, var, raw);
+                break;
+            default:
+                setMember<epicsFloat64>(snapshot, var, raw);
+            }
+        }
+        first = last;
+    }
+    group.transfers = transfers;
+    group.cycles++;
+    return asynSuccess;
+}
+
+} // namespace
+
+asynStatus MappedRegisterBus::read(size_t offset, size_t width, size_t count,
+                                   void *dest) {
+    if (!m_map->contains(offset, width, count)) {
+        return asynError;
+    }
+    switch (width) {
+    case 1:
+        m_map->copyOut(offset, static_cast<epicsUInt8 *>(dest), count);
+        break;
+    case 2:
+        m_map->copyOut(offset, static_cast<epicsUInt16 *>(dest), count);
+        break;
+    case 4:
+        m_map->copyOut(offset, static_cast<epicsUInt32 *>(dest), count);
+        break;
+    case 8:
+        m_map->copyOut(offset, static_cast<epicsUInt64 *>(dest), count);
+        break;
+    default:
+        return asynError;
+    }
+    return asynSuccess;
+}
+
+asynStatus MappedRegisterBus::write(size_t offset, size_t width, size_t count,
+                                    void const *src) {
+    if (!m_map->contains(offset, width, count)) {
+        return asynError;
+    }
+    switch (width) {
+    case 1:
+        m_map->copyIn(offset, static_cast<epicsUInt8 const *>(src), count);
+        break;
+    case 2:
+        m_map->copyIn(offset, static_cast<epicsUInt16 const *>(src), count);
+        break;
+    case 4:
+        m_map->copyIn(offset, static_cast<epicsUInt32 const *>(src), count);
+        break;
+    case 8:
+        m_map->copyIn(offset, static_cast<epicsUInt64 const *>(src), count);
+        break;
+    default:
+        return asynError;
+    }
+    return asynSuccess;
+}
+
+MappedRegisterBus::~MappedRegisterBus() { delete m_map; }
+
+asynStatus SimulatedRegisterBus::read(size_t offset, size_t width,
+                                      size_t count, void *dest) {
+    if (width != sizeof(epicsUInt32) || offset % width != 0) {
+        return asynError;
+    }
+    return m_device->read(offset / width, static_cast<epicsUInt32 *>(dest),
+                          count);
+}
+
+asynStatus SimulatedRegisterBus::write(size_t offset, size_t width,
+                                       size_t count, void const *src) {
+    if (width != sizeof(epicsUInt32) || offset % width != 0) {
+        return asynError;
+    }
+    return m_device->write(offset / width,
+                           static_cast<epicsUInt32 const *>(src), count);
+}
+
+RegisterDriver *RegisterDriver::create(char const *portName, char const *path,
+                                       RegisterBus *bus,
+                                       DriverOpts const &opts) {
+    std::ifstream file(path);
+    if (!file) {
+        printf("Cannot open register description %s\n", path);
+        delete bus;
+        return NULL;
+    }
+    RegisterTable *table = new RegisterTable;
+    std::string line;
+    bool ok = true;
+    for (int lineNumber = 1; std::getline(file, line); ++lineNumber) {
+        std::string error;
+        if (!table->parseLine(line, error)) {
+            printf("%s:%d: %s\n", path, lineNumber, error.c_str());
+            ok = false;
+        }
+    }
+    if (!ok) {
+        delete table;
+        delete bus;
+        return NULL;
+    }
+    return new RegisterDriver(portName, table, bus, opts);
+}
+
+RegisterDriver::RegisterDriver(char const *portName, RegisterTable *table,
+                               RegisterBus *bus, DriverOpts const &opts)
+    : Driver(portName, opts), m_table(table), m_bus(bus) {
+    for (size_t i = 0; i < m_table->entries.size(); ++i) {
+        RegisterEntry const &reg = *m_table->entries[i];
+        FunctionOpts functionOpts;
+        if (reg.group != NULL) {
+            functionOpts.setSnapshotGroup(reg.group->name);
+        }
+        switch (reg.asynType()) {
+        case asynParamInt32:
+            registerHandlers<epicsInt32>(
+                reg.name, reg.readable ? readHandler<epicsInt32> : NULL,
+                reg.writable ? writeHandler<epicsInt32>
+                             : refuseWrite<epicsInt32>,
+                NULL, functionOpts);
+            break;
+        case asynParamInt64:
+            registerHandlers<epicsInt64>(
+                reg.name, reg.readable ? readHandler<epicsInt64> : NULL,
+                reg.writable ? writeHandler<epicsInt64>
+                             : refuseWrite<epicsInt64>,
+                NULL, functionOpts);
+            break;
+        default:
+            registerHandlers<epicsFloat64>(
+                reg.name, reg.readable ? readHandler<epicsFloat64> : NULL,
+                reg.writable ? writeHandler<epicsFloat64>
+                             : refuseWrite<epicsFloat64>,
+                NULL, functionOpts);
+        }
+    }
+
+    for (size_t i = 0; i < m_table->groups.size(); ++i) {
+        RegisterGroup *group = m_table->groups[i];
+        group->driver = this;
+        group->bus = m_bus;
+        registerSnapshotHandler(group->name, pollGroup);
+        if (epicsThreadCreate("autoparamRegPoll", threadPriority(),
+                              epicsThreadGetStackSize(epicsThreadStackSmall),
+                              runPoller, group) == NULL) {
+            asynPrint(pasynUserSelf, ASYN_TRACE_ERROR,
+                      "%s: port=%s cannot create the poller of group %s\n",
+                      driverName, portName, group->name.c_str());
+            // Nothing to wait for in the destructor.
+            group->done.signal();
+        }
+    }
+}
+
+RegisterDriver::~RegisterDriver() {
+    lock();
+    for (size_t i = 0; i < m_table->groups.size(); ++i) {
+        m_table->groups[i]->quit = true;
+        m_table->groups[i]->wakeup.signal();
+    }
+    unlock();
+    for (size_t i = 0; i < m_table->groups.size(); ++i) {
+        m_table->groups[i]->done.wait();
+    }
+    delete m_table;
+    delete m_bus;
+}
+
+void RegisterDriver::runPoller(void *arg) {
+    RegisterGroup *group = static_cast<RegisterGroup *>(arg);
+    group->driver->adoptThreadOptions(
+        (std::string(group->driver->portName) + ":poll:" + group->name)
+            .c_str());
+    for (;;) {
+        group->wakeup.wait(group->period);
+        group->driver->lock();
+        bool quit = group->quit;
+        group->driver->unlock();
+        if (quit) {
+            break;
+        }
+        group->driver->takeSnapshot(group->name);
+    }
+    group->done.signal();
+}
+
+DeviceAddress *RegisterDriver::parseDeviceAddress(
+    std::string const &function, std::string const &arguments) {
+    std::map<std::string, RegisterEntry *>::const_iterator i =
+        m_table->byName.find(function);
+    if (i == m_table->byName.end()) {
+        return NULL;
+    }
+    if (arguments.find_first_not_of(" \t\r\n") != std::string::npos) {
+        asynPrint(pasynUserSelf, ASYN_TRACE_ERROR,
+                  "%s: port=%s register %s takes no arguments, got '%s'\n",
+                  driverName, portName, function.c_str(), arguments.c_str());
+        return NULL;
+    }
+    return new (arena()) TableAddress(i->second);
+}
+
+DeviceVariable *RegisterDriver::createDeviceVariable(DeviceVariable *baseVar) {
+    return new (arena()) TableVariable(baseVar, m_bus);
+}
+
+void RegisterDriver::report(FILE *fp, int details) {
+    Driver::report(fp, details);
+    lock();
+    fprintf(fp, "%lu registers\n", (unsigned long)m_table->entries.size());
+    for (size_t i = 0; i < m_table->groups.size(); ++i) {
+        RegisterGroup const &group = *m_table->groups[i];
+        fprintf(fp,
+                "Group %s: period %g s, %lu cycles, %lu transfers in the "
+                "last cycle\n",
+                group.name.c_str(), group.period,
+                (unsigned long)group.cycles, (unsigned long)group.transfers);
+    }
+    if (details > 0) {
+        for (size_t i = 0; i < m_table->entries.size(); ++i) {
+            RegisterEntry const &reg = *m_table->entries[i];
+            fprintf(fp, "  %-24s 0x%06lx %-7s %s%s %s\n", reg.name.c_str(),
+                    (unsigned long)reg.offset, typeInfo[reg.type].name,
+                    reg.readable ? "r" : "-", reg.writable ? "w" : "-",
+                    reg.group != NULL ? reg.group->name.c_str() : "");
+        }
+    }
+    unlock();
+}
+
+} // namespace Autoparam
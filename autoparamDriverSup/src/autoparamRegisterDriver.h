@@ -0,0 +1,160 @@
+// SPDX-FileCopyrightText: 2022 Cosylab d.d. https://www.cosylab.com
+//
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+#include <cstddef>
+#include <cstdio>
+#include <string>
+
+#include <asynDriver.h>
+
+#include "autoparamDriver.h"
+#include "autoparamRegisters.h"
+#include "autoparamSimulator.h"
+
+// API definition
+#include <autoparamDriverAPI.h>
+
+namespace Autoparam {
+
+/*! The transport a `RegisterDriver` reads and writes registers through.
+ *
+ * Registers are transferred as consecutive blocks of registers of the same
+ * width, in the byte order of the host. Implementations are called with the
+ * driver locked.
+ */
+class AUTOPARAMDRIVER_API RegisterBus {
+  public:
+    virtual ~RegisterBus() {}
+
+    /*! Read `count` consecutive registers of `width` bytes, starting at
+     * `offset` bytes, into `dest`.
+     */
+    virtual asynStatus read(size_t offset, size_t width, size_t count,
+                            void *dest) = 0;
+
+    /*! Write `count` consecutive registers of `width` bytes, starting at
+     * `offset` bytes, from `src`.
+     */
+    virtual asynStatus write(size_t offset, size_t width, size_t count,
+                             void const *src) = 0;
+};
+
+//! A `RegisterBus` accessing a `RegisterMap`, which it takes ownership of.
+class AUTOPARAMDRIVER_API MappedRegisterBus : public RegisterBus {
+  public:
+    explicit MappedRegisterBus(RegisterMap *map) : m_map(map) {}
+    ~MappedRegisterBus();
+
+    asynStatus read(size_t offset, size_t width, size_t count, void *dest);
+    asynStatus write(size_t offset, size_t width, size_t count,
+                     void const *src);
+
+  private:
+    MappedRegisterBus(MappedRegisterBus const &);
+    MappedRegisterBus &operator=(MappedRegisterBus const &);
+
+    RegisterMap *m_map;
+};
+
+/*! A `RegisterBus` accessing a `SimulatedDevice`, which it doesn't own.
+ *
+ * The registers of the simulator are 32 bits wide, so that is the only width
+ * supported. Each block of registers is one transaction of the simulator.
+ */
+class AUTOPARAMDRIVER_API SimulatedRegisterBus : public RegisterBus {
+  public:
+    explicit SimulatedRegisterBus(SimulatedDevice *device)
+        : m_device(device) {}
+
+    asynStatus read(size_t offset, size_t width, size_t count, void *dest);
+    asynStatus write(size_t offset, size_t width, size_t count,
+                     void const *src);
+
+  private:
+    SimulatedDevice *m_device;
+};
+
+struct RegisterTable;
+
+/*! A driver for a device whose registers are listed in a description file.
+ *
+ * Each register in the description is a function of the same name, taking no
+ * arguments, e.g. `@asyn(PORT) TEMPERATURE`. Handlers are registered for all
+ * of them when the driver is created, so there is no code to write for a new
+ * device. The description is a text file with one register per line:
+ *
+ *     <name> <offset> <type> <access> [bits=<lsb>:<msb>] [eslo=<x>]
+ *            [eoff=<y>] [group=<group>]
+ *
+ * - `offset` is in bytes; numbers may be given in hex with the `0x` prefix.
+ * - `type` is one of `int8`, `uint8`, `int16`, `uint16`, `int32`, `uint32`,
+ *   `int64`, `uint64`, `float32` and `float64`, giving the width of the
+ *   register and how its value is interpreted.
+ * - `access` is `ro`, `wo` or `rw`.
+ * - `bits` selects a bitfield of an integer register, from bit `lsb` to bit
+ *   `msb` inclusive. Signed types are sign-extended from the top bit of the
+ *   field. Writing a bitfield reads the register to keep the other bits, so
+ *   `wo` registers cannot have bitfields.
+ * - `eslo` and `eoff` convert the raw integer value to engineering units,
+ *   `value = raw * eslo + eoff`, like the fields of the same name in analog
+ *   records.
+ * - `group` makes the register a member of a polling group.
+ *
+ * Registers with a floating point type or a conversion are `Float64`
+ * parameters, 64-bit integers are `Int64`, and all others are `Int32`. Values
+ * of `uint32` registers above 2^31 thus appear negative, unless converted.
+ *
+ * A polling group is declared on a line of its own, before its members:
+ *
+ *     group <group> <period> [<gap>]
+ *
+ * A thread reads the members of each group every `period` seconds and
+ * updates their `I/O Intr` records with a common time stamp, as a snapshot
+ * group (see `FunctionOpts::setSnapshotGroup()`). Only registers with `I/O
+ * Intr` records are read. Registers of the same width whose offsets are at
+ * most `gap` bytes apart (default 0, i.e. adjacent) are read in a single
+ * block transfer, so a cycle typically takes a handful of transfers
+ * regardless of the number of registers. Records of group members can also
+ * be processed passively, which reads the register on its own.
+ *
+ * Blank lines and lines starting with `#` are ignored.
+ */
+class AUTOPARAMDRIVER_API RegisterDriver : public Driver {
+  public:
+    /*! Create a driver for the registers described in the file at `path`.
+     *
+     * The driver takes ownership of `bus`. Returns NULL, after printing the
+     * errors and deleting `bus`, if the description cannot be read.
+     */
+    static RegisterDriver *create(char const *portName, char const *path,
+                                  RegisterBus *bus,
+                                  DriverOpts const &opts = DriverOpts());
+
+    ~RegisterDriver();
+
+    //! Print the registers and polling groups in addition to the base report.
+    void report(FILE *fp, int details);
+
+  protected:
+    RegisterDriver(char const *portName, RegisterTable *table,
+                   RegisterBus *bus, DriverOpts const &opts);
+
+    DeviceAddress *parseDeviceAddress(std::string const &function,
+                                      std::string const &arguments);
+
+    DeviceVariable *createDeviceVariable(DeviceVariable *baseVar);
+
+  private:
+    RegisterDriver(RegisterDriver const &);
+    RegisterDriver &operator=(RegisterDriver const &);
+
+    static void runPoller(void *group);
+
+    RegisterTable *m_table;
+    RegisterBus *m_bus;
+};
+
+} // namespace Autoparam
@@ -0,0 +1,316 @@
+// SPDX-FileCopyrightText: 2022 Cosylab d.d. https://www.cosylab.com
+//
+// SPDX-License-Identifier: MIT
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <sstream>
+
+#include <errlog.h>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "autoparamParse.h"
+#include "autoparamRegisters.h"
+
+namespace Autoparam {
+
+namespace {
+
+char const *className = "Autoparam::RegisterMap";
+
+} // namespace
+
+RegisterMap::RegisterMap(void *mapping, size_t length, size_t skip,
+                         size_t size)
+    : m_mapping(mapping), m_length(length),
+      m_base(static_cast<char volatile *>(mapping) + skip), m_size(size) {}
+
+#ifndef _WIN32
+
+RegisterMap *RegisterMap::open(char const *path, size_t size, size_t offset) {
+    // O_SYNC makes /dev/mem map the registers uncached.
+    int fd = ::open(path, O_RDWR | O_SYNC);
+    if (fd < 0) {
+        errlogPrintf("%s: cannot open %s: %s\n", className, path,
+                     strerror(errno));
+        return NULL;
+    }
+    RegisterMap *registers = map(fd, size, offset);
+    close(fd);
+    return registers;
+}
+
+RegisterMap *RegisterMap::map(int fd, size_t size, size_t offset) {
+    struct stat info;
+    if (fstat(fd, &info) == 0 && S_ISREG(info.st_mode) &&
+        static_cast<epicsUInt64>(info.st_size) <
+            static_cast<epicsUInt64>(offset) + size) {
+        errlogPrintf("%s: file is shorter than %lu bytes\n", className,
+                     (unsigned long)(offset + size));
+        return NULL;
+    }
+
+    // The offset of a mapping must be a multiple of the page size.
+    size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    size_t skip = offset % page;
+    size_t length = skip + size;
+    void *mapping = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_SHARED, fd,
+                         static_cast<off_t>(offset - skip));
+    if (mapping == MAP_FAILED) {
+        errlogPrintf("%s: cannot map %lu bytes at offset %lu: %s\n", className,
+                     (unsigned long)size, (unsigned long)offset,
+                     strerror(errno));
+        return NULL;
+    }
+    return new RegisterMap(mapping, length, skip, size);
+}
+
+RegisterMap::~RegisterMap() { munmap(m_mapping, m_length); }
+
+#else
+
+RegisterMap *RegisterMap::open(char const *, size_t, size_t) {
+    errlogPrintf("%s: not supported on this system\n", className);
+    return NULL;
+}
+
+RegisterMap *RegisterMap::map(int, size_t, size_t) {
+    errlogPrintf("%s: not supported on this system\n", className);
+    return NULL;
+}
+
+RegisterMap::~RegisterMap() {}
+
+#endif
+
+bool RegisterAddress::operator==(DeviceAddress const &other) const {
+    RegisterAddress const &o = static_cast<RegisterAddress const &>(other);
+    return offset == o.offset && width == o.width && shift == o.shift &&
+           bits == o.bits && count == o.count;
+}
+
+bool RegisterAddress::parse(std::string const &arguments,
+                            RegisterMap const &map, std::string &error) {
+    std::istringstream is(arguments);
+    std::string token;
+    unsigned long value;
+    if (!(is >> token) || !parseNumber(token, value)) {
+        error = "missing offset";
+        return false;
+    }
+    offset = value;
+
+    while (is >> token) {
+        size_t eq = token.find('=');
+        std::string key = token.substr(0, eq);
+        std::string arg = eq == std::string::npos ? "" : token.substr(eq + 1);
+        if (key == "width") {
+            if (!parseNumber(arg, value) ||
+                (value != 8 && value != 16 && value != 32 && value != 64)) {
+                error = "width must be 8, 16, 32 or 64";
+                return false;
+            }
+            width = value / 8;
+        } else if (key == "bits") {
+            if (!parseBitfield(arg, 64, shift, bits)) {
+                error = "bits must be <lsb>:<msb>";
+                return false;
+            }
+        } else if (key == "count") {
+            if (!parseNumber(arg, value) || value == 0) {
+                error = "count must be positive";
+                return false;
+            }
+            count = value;
+        } else {
+            error = "unknown argument " + token;
+            return false;
+        }
+    }
+
+    if (shift + bits > width * 8) {
+        error = "bits are outside the register";
+        return false;
+    }
+    if (offset % width != 0) {
+        error = "offset is not aligned to the width";
+        return false;
+    }
+    if (!map.contains(offset, width, count)) {
+        error = "registers are outside the map";
+        return false;
+    }
+    return true;
+}
+
+epicsUInt64 Registers::loadRaw(RegisterVariable const &var) {
+    RegisterAddress const &addr = var.registerAddress();
+    switch (addr.width) {
+    case 1:
+        return var.map->load<epicsUInt8>(addr.offset);
+    case 2:
+        return var.map->load<epicsUInt16>(addr.offset);
+    case 4:
+        return var.map->load<epicsUInt32>(addr.offset);
+    default:
+        return var.map->load<epicsUInt64>(addr.offset);
+    }
+}
+
+void Registers::storeRaw(RegisterVariable &var, epicsUInt64 value) {
+    RegisterAddress const &addr = var.registerAddress();
+    switch (addr.width) {
+    case 1:
+        var.map->store<epicsUInt8>(addr.offset, value);
+        break;
+    case 2:
+        var.map->store<epicsUInt16>(addr.offset, value);
+        break;
+    case 4:
+        var.map->store<epicsUInt32>(addr.offset, value);
+        break;
+    default:
+        var.map->store<epicsUInt64>(addr.offset, value);
+    }
+}
+
+epicsUInt64 Registers::loadField(RegisterVariable const &var) {
+    RegisterAddress const &addr = var.registerAddress();
+    return (loadRaw(var) >> addr.shift) & addr.fieldMask();
+}
+
+// Replaces the bits of the field selected by `mask`. Whole registers are
+// stored without reading them first, since reads may have side effects.
+void Registers::storeField(RegisterVariable &var, epicsUInt64 value,
+                           epicsUInt64 mask) {
+    RegisterAddress const &addr = var.registerAddress();
+    epicsUInt64 registerMask =
+        addr.width == 8 ? ~static_cast<epicsUInt64>(0)
+                        : (static_cast<epicsUInt64>(1) << addr.width * 8) - 1;
+    mask = ((mask & addr.fieldMask()) << addr.shift) & registerMask;
+    value <<= addr.shift;
+    if (mask == registerMask) {
+        storeRaw(var, value);
+        return;
+    }
+    storeRaw(var, (loadRaw(var) & ~mask) | (value & mask));
+}
+
+Result<epicsInt32> Registers::readInt32(DeviceVariable &var) {
+    Result<epicsInt32> result;
+    RegisterVariable &regVar = static_cast<RegisterVariable &>(var);
+    result.value = static_cast<epicsInt32>(loadField(regVar));
+    return result;
+}
+
+WriteResult Registers::writeInt32(DeviceVariable &var, epicsInt32 value) {
+    storeField(static_cast<RegisterVariable &>(var),
+               static_cast<epicsUInt32>(value), ~static_cast<epicsUInt64>(0));
+    return WriteResult();
+}
+
+Result<epicsInt64> Registers::readInt64(DeviceVariable &var) {
+    Result<epicsInt64> result;
+    RegisterVariable &regVar = static_cast<RegisterVariable &>(var);
+    result.value = static_cast<epicsInt64>(loadField(regVar));
+    return result;
+}
+
+WriteResult Registers::writeInt64(DeviceVariable &var, epicsInt64 value) {
+    storeField(static_cast<RegisterVariable &>(var),
+               static_cast<epicsUInt64>(value), ~static_cast<epicsUInt64>(0));
+    return WriteResult();
+}
+
+Result<epicsUInt32> Registers::readDigital(DeviceVariable &var,
+                                           epicsUInt32 mask) {
+    Result<epicsUInt32> result;
+    result.value = static_cast<epicsUInt32>(
+                       loadField(static_cast<RegisterVariable &>(var))) &
+                   mask;
+    return result;
+}
+
+WriteResult Registers::writeDigital(DeviceVariable &var, epicsUInt32 value,
+                                    epicsUInt32 mask) {
+    storeField(static_cast<RegisterVariable &>(var), value, mask);
+    return WriteResult();
+}
+
+template <typename T>
+ArrayResult Registers::readArray(DeviceVariable &baseVar, Array<T> &value) {
+    ArrayResult result;
+    RegisterVariable &var = static_cast<RegisterVariable &>(baseVar);
+    RegisterAddress const &addr = var.registerAddress();
+    if (addr.width != sizeof(T)) {
+        result.status = asynError;
+        value.setSize(0);
+        return result;
+    }
+    size_t count = std::min(addr.count, value.maxSize());
+    var.map->copyOut(addr.offset, value.data(), count);
+    value.setSize(count);
+    return result;
+}
+
+template <typename T>
+WriteResult Registers::writeArray(DeviceVariable &baseVar,
+                                  Array<T> const &value) {
+    WriteResult result;
+    RegisterVariable &var = static_cast<RegisterVariable &>(baseVar);
+    RegisterAddress const &addr = var.registerAddress();
+    if (addr.width != sizeof(T)) {
+        result.status = asynError;
+        return result;
+    }
+    var.map->copyIn(addr.offset, value.data(),
+                    std::min(addr.count, value.size()));
+    return result;
+}
+
+template AUTOPARAMDRIVER_API ArrayResult epicsStdCall
+Registers::readArray<epicsInt8>(DeviceVariable &var, Array<epicsInt8> &value);
+template AUTOPARAMDRIVER_API ArrayResult epicsStdCall
+Registers::readArray<epicsInt16>(DeviceVariable &var,
+                                 Array<epicsInt16> &value);
+template AUTOPARAMDRIVER_API ArrayResult epicsStdCall
+Registers::readArray<epicsInt32>(DeviceVariable &var,
+                                 Array<epicsInt32> &value);
+template AUTOPARAMDRIVER_API ArrayResult epicsStdCall
+Registers::readArray<epicsInt64>(DeviceVariable &var,
+                                 Array<epicsInt64> &value);
+template AUTOPARAMDRIVER_API ArrayResult epicsStdCall
+Registers::readArray<epicsFloat32>(DeviceVariable &var,
+                                   Array<epicsFloat32> &value);
+template AUTOPARAMDRIVER_API ArrayResult epicsStdCall
+Registers::readArray<epicsFloat64>(DeviceVariable &var,
+                                   Array<epicsFloat64> &value);
+
+template AUTOPARAMDRIVER_API WriteResult epicsStdCall
+Registers::writeArray<epicsInt8>(DeviceVariable &var,
+                                 Array<epicsInt8> const &value);
+template AUTOPARAMDRIVER_API WriteResult epicsStdCall
+Registers::writeArray<epicsInt16>(DeviceVariable &var,
+                                  Array<epicsInt16> const &value);
+template AUTOPARAMDRIVER_API WriteResult epicsStdCall
+Registers::writeArray<epicsInt32>(DeviceVariable &var,
+                                  Array<epicsInt32> const &value);
+template AUTOPARAMDRIVER_API WriteResult epicsStdCall
+Registers::writeArray<epicsInt64>(DeviceVariable &var,
+                                  Array<epicsInt64> const &value);
+template AUTOPARAMDRIVER_API WriteResult epicsStdCall
+Registers::writeArray<epicsFloat32>(DeviceVariable &var,
+                                    Array<epicsFloat32> const &value);
+template AUTOPARAMDRIVER_API WriteResult epicsStdCall
+Registers::writeArray<epicsFloat64>(DeviceVariable &var,
+                                    Array<epicsFloat64> const &value);
+
+} // namespace Autoparam
@@ -0,0 +1,221 @@
+// SPDX-FileCopyrightText: 2022 Cosylab d.d. https://www.cosylab.com
+//
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+#include <epicsTypes.h>
+
+#include "autoparamHandler.h"
+
+// API definition
+#include <autoparamDriverAPI.h>
+
+namespace Autoparam {
+
+/*! Device registers mapped into memory.
+ *
+ * Many devices expose their registers through a file that can be mapped into
+ * memory, e.g. a UIO device (`/dev/uioN`) or a PCIe BAR
+ * (`/sys/bus/pci/devices/.../resourceN`). Accessing a register is then a
+ * single load or store instruction, without a system call. A regular file or
+ * a `memfd` can be mapped in the same way, which allows testing a driver
+ * without the device.
+ *
+ * Registers are accessed with volatile loads and stores of the register's
+ * width, so that the compiler neither merges nor splits them. Accesses must be
+ * aligned to the width. 64-bit accesses may be split in two on 32-bit systems.
+ *
+ * `RegisterAddress`, `RegisterVariable` and `Registers` build on this class to
+ * provide ready-made handlers for drivers of such devices. Only supported on
+ * POSIX systems.
+ */
+class AUTOPARAMDRIVER_API RegisterMap {
+  public:
+    /*! Map `size` bytes of the file at `path`, starting at `offset` bytes.
+     *
+     * For UIO devices, the n-th memory region is selected by an offset of n
+     * times the page size. Returns NULL and logs the reason if the file
+     * cannot be opened or mapped, or if it is a regular file shorter than
+     * `offset + size`, which would crash the IOC on access.
+     */
+    static RegisterMap *open(char const *path, size_t size, size_t offset = 0);
+
+    /*! Map `size` bytes of the open file descriptor `fd`, starting at
+     * `offset` bytes.
+     *
+     * Like `open()`, but the file is opened by the caller, e.g. with
+     * `memfd_create()`. The descriptor may be closed afterwards.
+     */
+    static RegisterMap *map(int fd, size_t size, size_t offset = 0);
+
+    //! Unmap the registers.
+    ~RegisterMap();
+
+    //! The number of bytes mapped.
+    size_t size() const { return m_size; }
+
+    //! Whether `count` registers of `width` bytes at `offset` are mapped.
+    bool contains(size_t offset, size_t width, size_t count = 1) const {
+        return offset <= m_size && width * count <= m_size - offset;
+    }
+
+    //! Load the register of type `T` at `offset` bytes.
+    template <typename T> T load(size_t offset) const {
+        return *reinterpret_cast<T const volatile *>(m_base + offset);
+    }
+
+    //! Store `value` to the register of type `T` at `offset` bytes.
+    template <typename T> void store(size_t offset, T value) {
+        *reinterpret_cast<T volatile *>(m_base + offset) = value;
+    }
+
+    //! Load `count` consecutive registers at `offset` bytes into `dest`.
+    template <typename T>
+    void copyOut(size_t offset, T *dest, size_t count) const {
+        T const volatile *src =
+            reinterpret_cast<T const volatile *>(m_base + offset);
+        for (size_t i = 0; i < count; ++i) {
+            dest[i] = src[i];
+        }
+    }
+
+    //! Store `count` values from `src` to consecutive registers at `offset`.
+    template <typename T>
+    void copyIn(size_t offset, T const *src, size_t count) {
+        T volatile *dest = reinterpret_cast<T volatile *>(m_base + offset);
+        for (size_t i = 0; i < count; ++i) {
+            dest[i] = src[i];
+        }
+    }
+
+  private:
+    RegisterMap(void *mapping, size_t length, size_t skip, size_t size);
+    RegisterMap(RegisterMap const &);
+    RegisterMap &operator=(RegisterMap const &);
+
+    void *m_mapping;
+    size_t m_length;
+    char volatile *m_base;
+    size_t m_size;
+};
+
+/*! The address of a register, a bitfield of a register or a block of
+ * registers in a `RegisterMap`.
+ *
+ * Parsed by `parse()` from arguments of the form
+ *
+ *     <offset> [width=<bits>] [bits=<lsb>:<msb>] [count=<n>]
+ *
+ * where `offset` is in bytes, and all numbers may be given in hex with the
+ * `0x` prefix. `width` is the width of the register, 8, 16, 32 or 64 bits
+ * (default 32). `bits` selects a bitfield, from bit `lsb` to bit `msb`
+ * inclusive; scalar values are shifted and masked accordingly. `count` is
+ * the number of consecutive registers read or written by array handlers.
+ */
+class AUTOPARAMDRIVER_API RegisterAddress : public DeviceAddress {
+  public:
+    RegisterAddress() : offset(0), width(4), shift(0), bits(0), count(1) {}
+
+    bool operator==(DeviceAddress const &other) const;
+
+    /*! Parse `arguments` and check that the registers are within `map`.
+     *
+     * Returns false and sets `error` if the arguments are not valid.
+     */
+    bool parse(std::string const &arguments, RegisterMap const &map,
+               std::string &error);
+
+    //! The mask of the bitfield, before shifting.
+    epicsUInt64 fieldMask() const {
+        return bits == 0 || bits >= 64
+                   ? ~static_cast<epicsUInt64>(0)
+                   : (static_cast<epicsUInt64>(1) << bits) - 1;
+    }
+
+    //! The offset of the register in bytes.
+    size_t offset;
+    //! The width of the register in bytes.
+    size_t width;
+    //! The position of the lowest bit of the bitfield.
+    unsigned shift;
+    //! The number of bits of the bitfield; 0 for the whole register.
+    unsigned bits;
+    //! The number of registers of an array.
+    size_t count;
+};
+
+/*! A `DeviceVariable` bound to a `RegisterAddress` in a `RegisterMap`.
+ *
+ * Return this from `Driver::createDeviceVariable()` to use the handlers
+ * provided by `Registers`.
+ */
+class AUTOPARAMDRIVER_API RegisterVariable : public DeviceVariable {
+  public:
+    RegisterVariable(DeviceVariable *baseVar, RegisterMap *map)
+        : DeviceVariable(baseVar), map(map) {}
+
+    RegisterAddress const &registerAddress() const {
+        return static_cast<RegisterAddress const &>(address());
+    }
+
+    //! The registers the variable is in.
+    RegisterMap *map;
+};
+
+/*! Read and write handlers for `RegisterVariable`s.
+ *
+ * These handlers access the registers directly and never block. Register them
+ * with `Driver::registerHandlers()` for functions whose variables are
+ * `RegisterVariable`s, e.g.
+ *
+ *     registerHandlers<epicsInt32>("REG", Registers::readInt32,
+ *                                  Registers::writeInt32, NULL);
+ *
+ * Writing a bitfield reads, modifies and writes back the register. This is
+ * not atomic with respect to the device or to other programs mapping the same
+ * registers, but the `Driver` doesn't call handlers concurrently unless they
+ * are in device groups that are handled unlocked.
+ */
+class AUTOPARAMDRIVER_API Registers {
+  public:
+    //! Read the register or bitfield, zero-extended.
+    static Result<epicsInt32> readInt32(DeviceVariable &var);
+    //! Write the register or bitfield, truncating the value to its width.
+    static WriteResult writeInt32(DeviceVariable &var, epicsInt32 value);
+    //! Read the register or bitfield, zero-extended.
+    static Result<epicsInt64> readInt64(DeviceVariable &var);
+    //! Write the register or bitfield, truncating the value to its width.
+    static WriteResult writeInt64(DeviceVariable &var, epicsInt64 value);
+
+    //! Read the bits of the register or bitfield selected by `mask`.
+    static Result<epicsUInt32> readDigital(DeviceVariable &var,
+                                           epicsUInt32 mask);
+    //! Write the bits of the register or bitfield selected by `mask`.
+    static WriteResult writeDigital(DeviceVariable &var, epicsUInt32 value,
+                                    epicsUInt32 mask);
+
+    /*! Copy `count` consecutive registers into `value`, up to its maximum
+     * size.
+     *
+     * The width of the registers must match `T`. Bitfields are ignored.
+     */
+    template <typename T>
+    static ArrayResult readArray(DeviceVariable &var, Array<T> &value);
+
+    //! Copy `value` to consecutive registers, up to `count` of them.
+    template <typename T>
+    static WriteResult writeArray(DeviceVariable &var, Array<T> const &value);
+
+  private:
+    static epicsUInt64 loadRaw(RegisterVariable const &var);
+    static void storeRaw(RegisterVariable &var, epicsUInt64 value);
+    static epicsUInt64 loadField(RegisterVariable const &var);
+    static void storeField(RegisterVariable &var, epicsUInt64 value,
+                           epicsUInt64 mask);
+};
+
+} // namespace Autoparam
@@ -0,0 +1,273 @@
+// SPDX-FileCopyrightText: 2022 Cosylab d.d. https://www.cosylab.com
+//
+// SPDX-License-Identifier: MIT
+
+// IOC shell commands for inspecting and tuning `Autoparam::Driver` instances.
+
+#include <cstdio>
+
+#include <iocsh.h>
+#include <epicsExport.h>
+#include <epicsThread.h>
+
+#include "autoparamDriver.h"
+
+namespace {
+
+using Autoparam::Driver;
+
+// Returns the `Driver` registered under `portName`, printing an error and
+// returning NULL if there is none.
+Driver *findDriver(char const *portName) {
+    if (portName == NULL || portName[0] == 0) {
+        printf("Missing port name\n");
+        return NULL;
+    }
+    asynPortDriver *port =
+        static_cast<asynPortDriver *>(findAsynPortDriver(portName));
+    Driver *driver = dynamic_cast<Driver *>(port);
+    if (driver == NULL) {
+        printf("Port %s is not an Autoparam::Driver\n", portName);
+    }
+    return driver;
+}
+
+iocshArg const portArg = {"port name", iocshArgString};
+
+iocshArg const *const portOnlyArgs[] = {&portArg};
+iocshFuncDef const memoryReportDef = {"autoparamMemoryReport", 1,
+                                      portOnlyArgs};
+
+void memoryReportCall(iocshArgBuf const *args) {
+    Driver *driver = findDriver(args[0].sval);
+    if (driver) {
+        driver->memoryReport(stdout);
+    }
+}
+
+iocshArg const countArg = {"number of entries", iocshArgInt};
+iocshArg const *const flightRecorderArgs[] = {&portArg, &countArg};
+iocshFuncDef const flightRecorderDef = {"autoparamFlightRecorder", 2,
+                                        flightRecorderArgs};
+
+void flightRecorderCall(iocshArgBuf const *args) {
+    Driver *driver = findDriver(args[0].sval);
+    if (driver) {
+        int count = args[1].ival > 0 ? args[1].ival : 20;
+        driver->flightRecorderReport(stdout, count);
+    }
+}
+
+iocshArg const fileArg = {"file name", iocshArgString};
+iocshArg const *const flightRecorderTraceArgs[] = {&portArg, &fileArg};
+iocshFuncDef const flightRecorderTraceDef = {"autoparamFlightRecorderTrace", 2,
+                                             flightRecorderTraceArgs};
+
+void flightRecorderTraceCall(iocshArgBuf const *args) {
+    Driver *driver = findDriver(args[0].sval);
+    if (driver == NULL) {
+        return;
+    }
+    char const *fileName = args[1].sval;
+    if (fileName == NULL || fileName[0] == 0) {
+        printf("Missing file name\n");
+        return;
+    }
+    FILE *fp = fopen(fileName, "w");
+    if (fp == NULL) {
+        printf("Cannot open %s for writing\n", fileName);
+        return;
+    }
+    driver->flightRecorderTrace(fp);
+    fclose(fp);
+}
+
+iocshFuncDef const slowRequestsDef = {"autoparamSlowRequests", 1,
+                                      portOnlyArgs};
+
+void slowRequestsCall(iocshArgBuf const *args) {
+    Driver *driver = findDriver(args[0].sval);
+    if (driver) {
+        driver->slowRequestReport(stdout);
+    }
+}
+
+iocshFuncDef const slowRequestsResetDef = {"autoparamSlowRequestsReset", 1,
+                                           portOnlyArgs};
+
+void slowRequestsResetCall(iocshArgBuf const *args) {
+    Driver *driver = findDriver(args[0].sval);
+    if (driver) {
+        driver->resetSlowRequests();
+    }
+}
+
+iocshArg const thresholdArg = {"threshold [s]", iocshArgDouble};
+iocshArg const intervalArg = {"min interval [s]", iocshArgDouble};
+iocshArg const *const slowRequestLogArgs[] = {&portArg, &thresholdArg,
+                                              &intervalArg};
+iocshFuncDef const slowRequestLogDef = {"autoparamSlowRequestLog", 3,
+                                        slowRequestLogArgs};
+
+void slowRequestLogCall(iocshArgBuf const *args) {
+    Driver *driver = findDriver(args[0].sval);
+    if (driver) {
+        double interval = args[2].dval > 0 ? args[2].dval : 1.0;
+        driver->setSlowRequestLogging(args[1].dval, interval);
+    }
+}
+
+iocshFuncDef const deadlinesDef = {"autoparamDeadlines", 1, portOnlyArgs};
+
+void deadlinesCall(iocshArgBuf const *args) {
+    Driver *driver = findDriver(args[0].sval);
+    if (driver) {
+        driver->deadlineReport(stdout);
+    }
+}
+
+iocshFuncDef const devicesDef = {"autoparamDevices", 1, portOnlyArgs};
+
+void devicesCall(iocshArgBuf const *args) {
+    Driver *driver = findDriver(args[0].sval);
+    if (driver) {
+        driver->deviceReport(stdout);
+    }
+}
+
+iocshFuncDef const lanesDef = {"autoparamLanes", 1, portOnlyArgs};
+
+void lanesCall(iocshArgBuf const *args) {
+    Driver *driver = findDriver(args[0].sval);
+    if (driver) {
+        driver->laneReport(stdout);
+    }
+}
+
+iocshArg const poolArg = {"pool name", iocshArgString};
+iocshArg const threadsArg = {"number of threads", iocshArgInt};
+iocshArg const priorityArg = {"priority", iocshArgInt};
+iocshArg const stackSizeArg = {"stack size", iocshArgInt};
+iocshArg const *const threadPoolArgs[] = {&poolArg, &threadsArg, &priorityArg,
+                                          &stackSizeArg};
+iocshFuncDef const threadPoolDef = {"autoparamThreadPool", 4, threadPoolArgs};
+
+void threadPoolCall(iocshArgBuf const *args) {
+    if (args[0].sval == NULL || args[0].sval[0] == 0) {
+        printf("Missing pool name\n");
+        return;
+    }
+    int priority = args[2].ival > 0 ? args[2].ival : epicsThreadPriorityMedium;
+    int stackSize = args[3].ival > 0 ? args[3].ival : 0;
+    Driver::createThreadPool(args[0].sval, args[1].ival, priority, stackSize);
+}
+
+iocshArg const *const captureArgs[] = {&portArg, &fileArg};
+iocshFuncDef const captureDef = {"autoparamCapture", 2, captureArgs};
+
+void captureCall(iocshArgBuf const *args) {
+    Driver *driver = findDriver(args[0].sval);
+    if (driver == NULL) {
+        return;
+    }
+    if (args[1].sval == NULL || args[1].sval[0] == 0) {
+        printf("Missing file name\n");
+        return;
+    }
+    if (!driver->startCapture(args[1].sval)) {
+        printf("Cannot open %s for writing\n", args[1].sval);
+    }
+}
+
+iocshFuncDef const captureStopDef = {"autoparamCaptureStop", 1, portOnlyArgs};
+
+void captureStopCall(iocshArgBuf const *args) {
+    Driver *driver = findDriver(args[0].sval);
+    if (driver) {
+        driver->stopCapture();
+    }
+}
+
+iocshArg const speedArg = {"speed", iocshArgDouble};
+iocshArg const *const replayArgs[] = {&portArg, &fileArg, &speedArg};
+iocshFuncDef const replayDef = {"autoparamReplay", 3, replayArgs};
+
+void replayCall(iocshArgBuf const *args) {
+    Driver *driver = findDriver(args[0].sval);
+    if (driver == NULL) {
+        return;
+    }
+    if (args[1].sval == NULL || args[1].sval[0] == 0) {
+        printf("Missing file name\n");
+        return;
+    }
+    driver->replayTraffic(args[1].sval, args[2].dval, stdout);
+}
+
+iocshArg const functionArg = {"function", iocshArgString};
+iocshArg const requestsArg = {"number of requests", iocshArgInt};
+iocshArg const rateArg = {"rate [1/s]", iocshArgDouble};
+iocshArg const writeArg = {"write", iocshArgInt};
+iocshArg const *const loadArgs[] = {&portArg,    &functionArg, &requestsArg,
+                                    &threadsArg, &rateArg,     &writeArg};
+iocshFuncDef const loadDef = {"autoparamLoad", 6, loadArgs};
+
+void loadCall(iocshArgBuf const *args) {
+    Driver *driver = findDriver(args[0].sval);
+    if (driver == NULL) {
+        return;
+    }
+    if (args[1].sval == NULL || args[1].sval[0] == 0) {
+        printf("Missing function name\n");
+        return;
+    }
+    if (args[2].ival < 0) {
+        printf("Invalid number of requests\n");
+        return;
+    }
+    driver->generateLoad(args[1].sval, args[2].ival, args[3].ival,
+                         args[4].dval, args[5].ival != 0, stdout);
+}
+
+iocshArg const periodArg = {"period [s]", iocshArgDouble};
+iocshArg const *const metricsArgs[] = {&fileArg, &periodArg};
+iocshFuncDef const metricsDef = {"autoparamMetrics", 2, metricsArgs};
+
+void metricsCall(iocshArgBuf const *args) {
+    // An empty file name stops the export.
+    double period = args[1].dval > 0 ? args[1].dval : 15;
+    Driver::exportMetrics(args[0].sval, period);
+}
+
+} // namespace
+
+extern "C" {
+
+static void autoparamDriverRegistrar() {
+    iocshRegister(&memoryReportDef, memoryReportCall);
+    iocshRegister(&flightRecorderDef, flightRecorderCall);
+    iocshRegister(&flightRecorderTraceDef, flightRecorderTraceCall);
+    iocshRegister(&slowRequestsDef, slowRequestsCall);
+    iocshRegister(&slowRequestsResetDef, slowRequestsResetCall);
+    iocshRegister(&slowRequestLogDef, slowRequestLogCall);
+    iocshRegister(&deadlinesDef, deadlinesCall);
+    iocshRegister(&devicesDef, devicesCall);
+    iocshRegister(&threadPoolDef, threadPoolCall);
+    iocshRegister(&lanesDef, lanesCall);
+    iocshRegister(&captureDef, captureCall);
+    iocshRegister(&captureStopDef, captureStopCall);
+    iocshRegister(&replayDef, replayCall);
+    iocshRegister(&loadDef, loadCall);
+    iocshRegister(&metricsDef, metricsCall);
+}
+
+// The library is built with hidden visibility, but the registrar needs to be
+// found by the code generated from the dbd file.
+#if __GNUC__ >= 4
+#pragma GCC visibility push(default)
+#endif
+epicsExportRegistrar(autoparamDriverRegistrar);
+#if __GNUC__ >= 4
+#pragma GCC visibility pop
+#endif
+}
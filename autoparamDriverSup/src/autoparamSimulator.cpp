@@ -0,0 +1,232 @@
+// SPDX-FileCopyrightText: 2022 Cosylab d.d. https://www.cosylab.com
+//
+// SPDX-License-Identifier: MIT
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include <epicsThread.h>
+#include <epicsTime.h>
+
+#include "autoparamSimulator.h"
+
+namespace Autoparam {
+
+namespace {
+
+double const pi = 3.14159265358979323846;
+
+char const *distributionName(SimulatedDevice::Distribution distribution) {
+    switch (distribution) {
+    case SimulatedDevice::LatencyFixed:
+        return "fixed";
+    case SimulatedDevice::LatencyNormal:
+        return "normal";
+    case SimulatedDevice::LatencyLongTail:
+        return "longtail";
+    }
+    return "?";
+}
+
+} // namespace
+
+SimulatedDevice::SimulatedDevice(size_t numRegisters, epicsUInt32 seed)
+    : m_slotFreed(epicsEventEmpty), m_registers(numRegisters, 0),
+      // xorshift needs a non-zero state.
+      m_random(0x9e3779b97f4a7c15ull ^ seed), m_distribution(LatencyFixed),
+      m_typical(0), m_spread(0), m_failureRate(0), m_failureStatus(asynError),
+      m_maxConcurrent(0), m_active(0), m_waiting(0) {
+    std::memset(&m_stats, 0, sizeof(m_stats));
+}
+
+void SimulatedDevice::setLatency(Distribution distribution, double typical,
+                                 double spread) {
+    m_lock.lock();
+    m_distribution = distribution;
+    m_typical = std::max(typical, 0.0);
+    m_spread = std::max(spread, 0.0);
+    m_lock.unlock();
+}
+
+void SimulatedDevice::setFailures(double probability, asynStatus status) {
+    m_lock.lock();
+    m_failureRate = probability;
+    m_failureStatus = status;
+    m_lock.unlock();
+}
+
+void SimulatedDevice::setMaxConcurrent(size_t max) {
+    m_lock.lock();
+    m_maxConcurrent = max;
+    m_lock.unlock();
+    // Let waiters recheck against the new limit.
+    m_slotFreed.signal();
+}
+
+asynStatus SimulatedDevice::read(size_t address, epicsUInt32 *dest,
+                                 size_t count) {
+    return transact(address, count, dest, NULL);
+}
+
+asynStatus SimulatedDevice::write(size_t address, epicsUInt32 const *src,
+                                  size_t count) {
+    return transact(address, count, NULL, src);
+}
+
+asynStatus SimulatedDevice::transact(size_t address, size_t count,
+                                     epicsUInt32 *dest,
+                                     epicsUInt32 const *src) {
+    if (address > m_registers.size() || count > m_registers.size() - address) {
+        return asynError;
+    }
+
+    epicsUInt64 start = epicsMonotonicGet();
+    acquireSlot();
+
+    m_lock.lock();
+    double duration = drawLatency();
+    bool fail = m_failureRate > 0 && uniform() < m_failureRate;
+    asynStatus status = fail ? m_failureStatus : asynSuccess;
+    m_lock.unlock();
+
+    if (duration > 0) {
+        epicsThreadSleep(duration);
+    }
+
+    // The registers change at the end of the transaction, as if the data was
+    // transferred last.
+    m_lock.lock();
+    if (!fail && count > 0) {
+        if (dest != NULL) {
+            std::copy(&m_registers[address], &m_registers[address] + count,
+                      dest);
+        } else {
+            std::copy(src, src + count, &m_registers[address]);
+        }
+    }
+    m_stats.transactions++;
+    m_stats.failures += fail;
+    m_lock.unlock();
+
+    releaseSlot();
+    m_latency.add(epicsMonotonicGet() - start);
+    return status;
+}
+
+void SimulatedDevice::acquireSlot() {
+    m_lock.lock();
+    if (m_maxConcurrent > 0 && m_active >= m_maxConcurrent) {
+        m_stats.waits++;
+        m_waiting++;
+        while (m_maxConcurrent > 0 && m_active >= m_maxConcurrent) {
+            m_lock.unlock();
+            m_slotFreed.wait();
+            m_lock.lock();
+        }
+        m_waiting--;
+    }
+    m_active++;
+    m_stats.peakConcurrent = std::max(m_stats.peakConcurrent, m_active);
+    // The event is binary, so slots freed at the same time wake up a single
+    // waiter. Pass the wakeup on if there is still room.
+    bool more = m_waiting > 0 &&
+                (m_maxConcurrent == 0 || m_active < m_maxConcurrent);
+    m_lock.unlock();
+    if (more) {
+        m_slotFreed.signal();
+    }
+}
+
+void SimulatedDevice::releaseSlot() {
+    m_lock.lock();
+    m_active--;
+    bool waiting = m_waiting > 0;
+    m_lock.unlock();
+    if (waiting) {
+        m_slotFreed.signal();
+    }
+}
+
+// xorshift64*, scaled to (0, 1].
+double SimulatedDevice::uniform() {
+    m_random ^= m_random >> 12;
+    m_random ^= m_random << 25;
+    m_random ^= m_random >> 27;
+    epicsUInt64 bits = (m_random * 0x2545f4914f6cdd1dull) >> 11;
+    return (bits + 1) * (1.0 / 9007199254740992.0);
+}
+
+double SimulatedDevice::drawLatency() {
+    switch (m_distribution) {
+    case LatencyFixed:
+        break;
+    case LatencyNormal: {
+        // Box-Muller
+        double radius = std::sqrt(-2 * std::log(uniform()));
+        double angle = 2 * pi * uniform();
+        return std::max(m_typical + m_spread * radius * std::cos(angle), 0.0);
+    }
+    case LatencyLongTail:
+        if (m_spread > m_typical && m_typical > 0) {
+            // P(X > x) = (typical / x)^shape, so the 99th percentile is
+            // typical * 100^(1 / shape).
+            double shape = std::log(100.0) / std::log(m_spread / m_typical);
+            return m_typical * std::pow(uniform(), -1 / shape);
+        }
+        break;
+    }
+    return m_typical;
+}
+
+SimulatedDevice::Statistics SimulatedDevice::statistics() const {
+    m_lock.lock();
+    Statistics stats = m_stats;
+    m_lock.unlock();
+    return stats;
+}
+
+void SimulatedDevice::report(FILE *fp) const {
+    m_lock.lock();
+    Statistics stats = m_stats;
+    Distribution distribution = m_distribution;
+    double typical = m_typical;
+    double spread = m_spread;
+    double failureRate = m_failureRate;
+    size_t maxConcurrent = m_maxConcurrent;
+    m_lock.unlock();
+
+    fprintf(fp, "Simulated device with %lu registers\n",
+            (unsigned long)m_registers.size());
+    fprintf(fp, "    latency: %s, typical %g s, spread %g s\n",
+            distributionName(distribution), typical, spread);
+    fprintf(fp, "    failure rate: %g\n", failureRate);
+    if (maxConcurrent > 0) {
+        fprintf(fp, "    max concurrent: %lu\n", (unsigned long)maxConcurrent);
+    } else {
+        fprintf(fp, "    max concurrent: unlimited\n");
+    }
+    fprintf(fp,
+            "    transactions: %lu, failed: %lu, waited: %lu, "
+            "peak concurrent: %lu\n",
+            (unsigned long)stats.transactions, (unsigned long)stats.failures,
+            (unsigned long)stats.waits, (unsigned long)stats.peakConcurrent);
+
+    m_latency.report(fp, "    ");
+}
+
+bool SimulatedDevice::parseDistribution(char const *name,
+                                        Distribution &distribution) {
+    if (name == NULL) {
+        return false;
+    }
+    for (int i = LatencyFixed; i <= LatencyLongTail; ++i) {
+        if (std::strcmp(name, distributionName(Distribution(i))) == 0) {
+            distribution = Distribution(i);
+            return true;
+        }
+    }
+    return false;
+}
+
+} // namespace Autoparam
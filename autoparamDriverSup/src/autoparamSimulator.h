@@ -0,0 +1,158 @@
+// SPDX-FileCopyrightText: 2022 Cosylab d.d. https://www.cosylab.com
+//
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+#include <cstddef>
+#include <cstdio>
+#include <vector>
+
+#include <asynDriver.h>
+#include <epicsEvent.h>
+#include <epicsMutex.h>
+#include <epicsTypes.h>
+
+#include "autoparamRecorder.h"
+
+// API definition
+#include <autoparamDriverAPI.h>
+
+namespace Autoparam {
+
+/*! A simulated device for testing drivers without hardware.
+ *
+ * The device is a map of 32-bit registers, accessed by transactions that
+ * read or write a range of consecutive registers. Each transaction takes a
+ * random amount of time drawn from a configurable distribution, and may fail
+ * with a configurable probability. The number of transactions in progress at
+ * the same time can be limited, in which case further transactions wait for
+ * one of them to finish, like they would on a real bus or connection.
+ *
+ * Read and write handlers call `read()` and `write()` in place of a real
+ * transport. The calling thread blocks for the duration of the transaction, so
+ * the driver should be blocking (see `DriverOpts::setBlocking()`). All methods
+ * are threadsafe. The example driver in `autoparamTestApp` shows how to use
+ * the simulator to measure throughput and latency of a driver.
+ */
+class AUTOPARAMDRIVER_API SimulatedDevice {
+  public:
+    //! The distribution of transaction durations.
+    enum Distribution {
+        //! Every transaction takes `typical` seconds.
+        LatencyFixed,
+        /*! Normally distributed with mean `typical` and standard deviation
+         * `spread`. Negative durations are clamped to zero.
+         */
+        LatencyNormal,
+        /*! Pareto distributed with minimum `typical` and 99th percentile
+         * `spread`, so that a few transactions take much longer than most.
+         */
+        LatencyLongTail
+    };
+
+    //! Transaction counters, see `statistics()`.
+    struct Statistics {
+        //! The number of finished transactions.
+        size_t transactions;
+        //! The number of those that failed.
+        size_t failures;
+        //! The number of transactions that had to wait for a free slot.
+        size_t waits;
+        //! The largest number of transactions in progress at the same time.
+        size_t peakConcurrent;
+    };
+
+    /*! Construct a device with `numRegisters` registers, all set to zero.
+     *
+     * Random numbers are generated from `seed`, so a run can be reproduced
+     * given the same seed and the same sequence of transactions.
+     */
+    explicit SimulatedDevice(size_t numRegisters, epicsUInt32 seed = 1);
+
+    //! The number of registers.
+    size_t size() const { return m_registers.size(); }
+
+    /*! Set the distribution of transaction durations, in seconds.
+     *
+     * Default: `LatencyFixed` with zero duration
+     */
+    void setLatency(Distribution distribution, double typical,
+                    double spread = 0);
+
+    /*! Make transactions fail with the given `probability` and `status`.
+     *
+     * A failed transaction takes the same time as a successful one, but
+     * neither reads nor writes any register.
+     *
+     * Default: transactions don't fail
+     */
+    void setFailures(double probability, asynStatus status = asynError);
+
+    /*! Limit the number of transactions in progress at the same time.
+     *
+     * Zero means no limit.
+     *
+     * Default: no limit
+     */
+    void setMaxConcurrent(size_t max);
+
+    /*! Read `count` registers starting at `address` into `dest`.
+     *
+     * Returns `asynError` without delay if the range is outside the register
+     * map, otherwise the status of the transaction.
+     */
+    asynStatus read(size_t address, epicsUInt32 *dest, size_t count = 1);
+
+    /*! Write `count` registers starting at `address` from `src`.
+     *
+     * Returns `asynError` without delay if the range is outside the register
+     * map, otherwise the status of the transaction.
+     */
+    asynStatus write(size_t address, epicsUInt32 const *src, size_t count = 1);
+
+    //! Obtain the transaction counters.
+    Statistics statistics() const;
+
+    //! Obtain the histogram of transaction durations, including waiting.
+    LatencyHistogram const &latency() const { return m_latency; }
+
+    //! Print the settings, counters and latency histogram to `fp`.
+    void report(FILE *fp) const;
+
+    /*! Parse "fixed", "normal" or "longtail" into `distribution`.
+     *
+     * Returns false if `name` is none of those.
+     */
+    static bool parseDistribution(char const *name,
+                                  Distribution &distribution);
+
+  private:
+    SimulatedDevice(SimulatedDevice const &);
+    SimulatedDevice &operator=(SimulatedDevice const &);
+
+    asynStatus transact(size_t address, size_t count, epicsUInt32 *dest,
+                        epicsUInt32 const *src);
+    void acquireSlot();
+    void releaseSlot();
+    // These need `m_lock` to be held.
+    double uniform();
+    double drawLatency();
+
+    mutable epicsMutex m_lock;
+    epicsEvent m_slotFreed;
+    std::vector<epicsUInt32> m_registers;
+    epicsUInt64 m_random;
+    Distribution m_distribution;
+    double m_typical;
+    double m_spread;
+    double m_failureRate;
+    asynStatus m_failureStatus;
+    size_t m_maxConcurrent;
+    size_t m_active;
+    size_t m_waiting;
+    Statistics m_stats;
+    LatencyHistogram m_latency;
+};
+
+} // namespace Autoparam
@@ -0,0 +1,83 @@
+// SPDX-FileCopyrightText: 2022 Cosylab d.d. https://www.cosylab.com
+//
+// SPDX-License-Identifier: MIT
+
+#include <cstring>
+
+#include "autoparamBuffer.h"
+#include "autoparamDriver.h"
+
+namespace Autoparam {
+
+Snapshot::Snapshot(Driver *driver, std::string const &name)
+    : m_driver(driver), m_name(name), m_handler(NULL) {
+    timestamp.secPastEpoch = 0;
+    timestamp.nsec = 0;
+}
+
+template <typename T>
+asynStatus Snapshot::setValue(DeviceVariable const &var, T value) {
+    return m_driver->setParam(var, value);
+}
+
+template <typename T>
+asynStatus Snapshot::setArray(DeviceVariable const &var,
+                              Array<T> const &value) {
+    if (!m_driver->checkHandlersVerbosely<Array<T> >(var)) {
+        return asynError;
+    }
+    // The buffer keeps its capacity, so only the first snapshot of a given
+    // size allocates memory.
+    PendingArray &pending = m_arrays[var.asynIndex()];
+    pending.var = &var;
+    pending.data.resize(value.size() * sizeof(T));
+    if (value.size() > 0) {
+        std::memcpy(&pending.data[0], value.data(), value.size() * sizeof(T));
+    }
+    pending.size = value.size();
+    pending.publish = publishArray<T>;
+    pending.set = true;
+    return asynSuccess;
+}
+
+template <typename T>
+asynStatus Snapshot::publishArray(Driver &driver, DeviceVariable const &var,
+                                  std::vector<char> &data, size_t size,
+                                  asynStatus status) {
+    Array<T> value(bufferElements<T>(data), size);
+    value.setSize(size);
+    return driver.doCallbacksArray(var, value, status);
+}
+
+template AUTOPARAMDRIVER_API asynStatus epicsStdCall
+Snapshot::setValue<epicsInt32>(DeviceVariable const &var, epicsInt32 value);
+template AUTOPARAMDRIVER_API asynStatus epicsStdCall
+Snapshot::setValue<epicsInt64>(DeviceVariable const &var, epicsInt64 value);
+template AUTOPARAMDRIVER_API asynStatus epicsStdCall
+Snapshot::setValue<epicsUInt32>(DeviceVariable const &var, epicsUInt32 value);
+template AUTOPARAMDRIVER_API asynStatus epicsStdCall
+Snapshot::setValue<epicsFloat64>(DeviceVariable const &var,
+                                 epicsFloat64 value);
+template AUTOPARAMDRIVER_API asynStatus epicsStdCall
+Snapshot::setValue<Octet>(DeviceVariable const &var, Octet value);
+
+template AUTOPARAMDRIVER_API asynStatus epicsStdCall
+Snapshot::setArray<epicsInt8>(DeviceVariable const &var,
+                              Array<epicsInt8> const &value);
+template AUTOPARAMDRIVER_API asynStatus epicsStdCall
+Snapshot::setArray<epicsInt16>(DeviceVariable const &var,
+                               Array<epicsInt16> const &value);
+template AUTOPARAMDRIVER_API asynStatus epicsStdCall
+Snapshot::setArray<epicsInt32>(DeviceVariable const &var,
+                               Array<epicsInt32> const &value);
+template AUTOPARAMDRIVER_API asynStatus epicsStdCall
+Snapshot::setArray<epicsInt64>(DeviceVariable const &var,
+                               Array<epicsInt64> const &value);
+template AUTOPARAMDRIVER_API asynStatus epicsStdCall
+Snapshot::setArray<epicsFloat32>(DeviceVariable const &var,
+                                 Array<epicsFloat32> const &value);
+template AUTOPARAMDRIVER_API asynStatus epicsStdCall
+Snapshot::setArray<epicsFloat64>(DeviceVariable const &var,
+                                 Array<epicsFloat64> const &value);
+
+} // namespace Autoparam
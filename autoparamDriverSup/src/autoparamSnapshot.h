@@ -0,0 +1,114 @@
+// SPDX-FileCopyrightText: 2022 Cosylab d.d. https://www.cosylab.com
+//
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include <epicsTime.h>
+
+#include "autoparamHandler.h"
+
+// API definition
+#include <autoparamDriverAPI.h>
+
+namespace Autoparam {
+
+class Driver;
+
+/*! The values of a snapshot group, acquired together.
+ *
+ * Some devices acquire many values at once, e.g. all the channels of a
+ * digitizer on the same trigger. Reading them one record at a time would give
+ * each record a different time stamp, and clients could observe a mix of old
+ * and new values. Instead, functions can be made members of a snapshot group
+ * (see `FunctionOpts::setSnapshotGroup()`). When the driver calls
+ * `Driver::takeSnapshot()`, a single `SnapshotHandler` fills in the values of
+ * all members, which are then given the same time stamp and propagated to
+ * `I/O Intr` records together, without the driver being unlocked in between.
+ *
+ * Records of scalar members that are not `I/O Intr` read the value of the last
+ * snapshot if their function has no read handler.
+ */
+class AUTOPARAMDRIVER_API Snapshot {
+  public:
+    //! The name of the snapshot group.
+    std::string const &name() const { return m_name; }
+
+    //! The variables that are members of the group, in order of creation.
+    std::vector<DeviceVariable *> const &variables() const {
+        return m_variables;
+    }
+
+    /*! Set the value of a scalar member.
+     *
+     * The value is set right away, but records are not processed until the
+     * snapshot handler returns.
+     */
+    template <typename T>
+    asynStatus setValue(DeviceVariable const &var, T value);
+
+    /*! Set the value of an array member.
+     *
+     * The data is copied to a buffer that is reused by subsequent snapshots,
+     * and propagated to `I/O Intr` records once the snapshot handler returns.
+     */
+    template <typename T>
+    asynStatus setArray(DeviceVariable const &var, Array<T> const &value);
+
+    /*! The time the values were acquired at.
+     *
+     * Cleared before the snapshot handler is called. If the handler leaves it
+     * at zero, the time stamp is obtained from the driver as for other
+     * requests (see `DriverOpts::setTimeStampSource()`).
+     */
+    epicsTimeStamp timestamp;
+
+  private:
+    friend class Driver;
+
+    typedef asynStatus (*ArrayPublisher)(Driver &driver,
+                                         DeviceVariable const &var,
+                                         std::vector<char> &data, size_t size,
+                                         asynStatus status);
+
+    struct PendingArray {
+        PendingArray() : var(NULL), size(0), publish(NULL), set(false) {}
+
+        DeviceVariable const *var;
+        std::vector<char> data;
+        size_t size;
+        ArrayPublisher publish;
+        bool set;
+    };
+
+    Snapshot(Driver *driver, std::string const &name);
+    Snapshot(Snapshot const &);
+    Snapshot &operator=(Snapshot const &);
+
+    template <typename T>
+    static asynStatus publishArray(Driver &driver, DeviceVariable const &var,
+                                   std::vector<char> &data, size_t size,
+                                   asynStatus status);
+
+    Driver *m_driver;
+    std::string m_name;
+    asynStatus (*m_handler)(Snapshot &snapshot);
+    std::vector<DeviceVariable *> m_variables;
+    // Keyed by asyn index.
+    std::map<int, PendingArray> m_arrays;
+};
+
+/*! A function filling in the values of a snapshot group.
+ *
+ * Called by `Driver::takeSnapshot()` with the driver locked. It should set
+ * the values of the members using `Snapshot::setValue()` and
+ * `Snapshot::setArray()`, and may set `Snapshot::timestamp`. If it returns an
+ * error, the status of all members is set to it.
+ */
+typedef asynStatus (*SnapshotHandler)(Snapshot &snapshot);
+
+} // namespace Autoparam
@@ -0,0 +1,168 @@
+// SPDX-FileCopyrightText: 2022 Cosylab d.d. https://www.cosylab.com
+//
+// SPDX-License-Identifier: MIT
+
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <sstream>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#include <errlog.h>
+
+#include "autoparamDriver.h"
+#include "autoparamThread.h"
+
+namespace Autoparam {
+
+static char const *driverName = "Autoparam::Driver";
+
+#ifdef __linux__
+
+namespace {
+
+// Parses a list like "0,2-3" into `set`. Returns false on syntax errors and
+// CPU numbers out of range.
+bool parseCpuList(std::string const &cpus, cpu_set_t &set) {
+    CPU_ZERO(&set);
+    char const *p = cpus.c_str();
+    while (*p != 0) {
+        char *end;
+        long first = strtol(p, &end, 10);
+        if (end == p) {
+            return false;
+        }
+        long last = first;
+        p = end;
+        if (*p == '-') {
+            ++p;
+            last = strtol(p, &end, 10);
+            if (end == p) {
+                return false;
+            }
+            p = end;
+        }
+        if (first < 0 || last < first || last >= CPU_SETSIZE) {
+            return false;
+        }
+        for (long cpu = first; cpu <= last; ++cpu) {
+            CPU_SET(cpu, &set);
+        }
+        if (*p == ',') {
+            ++p;
+        } else if (*p != 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+std::string formatCpuList(cpu_set_t const &set) {
+    std::ostringstream os;
+    for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+        if (!CPU_ISSET(cpu, &set)) {
+            continue;
+        }
+        int last = cpu;
+        while (last + 1 < CPU_SETSIZE && CPU_ISSET(last + 1, &set)) {
+            ++last;
+        }
+        if (os.tellp() > 0) {
+            os << ',';
+        }
+        os << cpu;
+        if (last > cpu) {
+            os << '-' << last;
+        }
+        cpu = last;
+    }
+    return os.str();
+}
+
+char const *policyName(int policy) {
+    switch (policy) {
+    case SCHED_FIFO:
+        return "SCHED_FIFO";
+    case SCHED_RR:
+        return "SCHED_RR";
+    case SCHED_OTHER:
+        return "SCHED_OTHER";
+    default:
+        return "other";
+    }
+}
+
+} // namespace
+
+void applyThreadOptions(char const *name, std::string const &cpus, int policy,
+                        int priority) {
+    if (cpus.empty() && policy == DriverOpts::SchedDefault) {
+        return;
+    }
+
+    pthread_t self = pthread_self();
+    if (!cpus.empty()) {
+        cpu_set_t set;
+        if (!parseCpuList(cpus, set)) {
+            errlogPrintf("%s: thread %s: invalid CPU list '%s'\n", driverName,
+                         name, cpus.c_str());
+        } else {
+            int err = pthread_setaffinity_np(self, sizeof(set), &set);
+            if (err != 0) {
+                errlogPrintf("%s: thread %s: could not set CPU affinity to "
+                             "'%s': %s\n",
+                             driverName, name, cpus.c_str(), strerror(err));
+            }
+        }
+    }
+
+    if (policy != DriverOpts::SchedDefault) {
+        sched_param param;
+        memset(&param, 0, sizeof(param));
+        param.sched_priority = priority;
+        int posixPolicy =
+            policy == DriverOpts::SchedRoundRobin ? SCHED_RR : SCHED_FIFO;
+        int err = pthread_setschedparam(self, posixPolicy, &param);
+        if (err != 0) {
+            errlogPrintf("%s: thread %s: could not set %s priority %d: %s\n",
+                         driverName, name, policyName(posixPolicy), priority,
+                         strerror(err));
+        }
+    }
+
+    // Report what the thread actually ended up with, whether or not the
+    // requested settings could be applied.
+    cpu_set_t set;
+    std::string applied = "unknown";
+    if (pthread_getaffinity_np(self, sizeof(set), &set) == 0) {
+        applied = formatCpuList(set);
+    }
+    int actualPolicy;
+    sched_param param;
+    if (pthread_getschedparam(self, &actualPolicy, &param) != 0) {
+        actualPolicy = -1;
+        param.sched_priority = 0;
+    }
+    errlogPrintf("%s: thread %s runs on CPUs %s with %s priority %d\n",
+                 driverName, name, applied.c_str(), policyName(actualPolicy),
+                 param.sched_priority);
+}
+
+#else
+
+void applyThreadOptions(char const *name, std::string const &cpus, int policy,
+                        int) {
+    if (!cpus.empty() || policy != DriverOpts::SchedDefault) {
+        errlogPrintf("%s: thread %s: CPU affinity and scheduling policy are "
+                     "only supported on Linux\n",
+                     driverName, name);
+    }
+}
+
+#endif
+
+} // namespace Autoparam
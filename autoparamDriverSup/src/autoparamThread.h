@@ -0,0 +1,24 @@
+// SPDX-FileCopyrightText: 2022 Cosylab d.d. https://www.cosylab.com
+//
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+// Scheduling settings of threads. This header is private to the library.
+
+#include <string>
+
+namespace Autoparam {
+
+/*! Apply CPU affinity and scheduling policy to the calling thread.
+ *
+ * `cpus` is a list of CPU numbers and ranges, e.g. "2,4-5"; an empty list
+ * leaves the affinity unchanged. `policy` is a `DriverOpts::SchedPolicy`. The
+ * settings the thread ends up with are logged, named after `name`, so that
+ * they can be verified. Only supported on Linux; elsewhere, an error is logged
+ * if any setting is requested.
+ */
+void applyThreadOptions(char const *name, std::string const &cpus, int policy,
+                        int priority);
+
+} // namespace Autoparam
@@ -0,0 +1,34 @@
+// SPDX-FileCopyrightText: 2022 Cosylab d.d. https://www.cosylab.com
+//
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+// Static tracepoints (USDT) for use with bpftrace, perf, systemtap etc. This
+// header is private to the library.
+//
+// The probes are provided by <sys/sdt.h> (part of systemtap-sdt-dev or
+// systemtap-sdt-devel) when it is available at build time. A probe that no
+// tracer is attached to is a single nop instruction. Without the header, or if
+// AUTOPARAM_NO_USDT is defined, the probes compile to nothing.
+
+#if defined(__linux__) && !defined(AUTOPARAM_NO_USDT) && defined(__has_include)
+#if __has_include(<sys/sdt.h>)
+#include <sys/sdt.h>
+#define AUTOPARAM_HAVE_USDT 1
+#endif
+#endif
+
+#ifdef AUTOPARAM_HAVE_USDT
+#define AUTOPARAM_PROBE3(name, a1, a2, a3)                                     \
+    DTRACE_PROBE3(autoparam, name, a1, a2, a3)
+#define AUTOPARAM_PROBE4(name, a1, a2, a3, a4)                                 \
+    DTRACE_PROBE4(autoparam, name, a1, a2, a3, a4)
+#else
+#define AUTOPARAM_PROBE3(name, a1, a2, a3)                                     \
+    do {                                                                       \
+    } while (0)
+#define AUTOPARAM_PROBE4(name, a1, a2, a3, a4)                                 \
+    do {                                                                       \
+    } while (0)
+#endif
@@ -0,0 +1,213 @@
+// SPDX-FileCopyrightText: 2022 Cosylab d.d. https://www.cosylab.com
+//
+// SPDX-License-Identifier: MIT
+
+#include <algorithm>
+#include <cstring>
+
+#include "autoparamTraffic.h"
+
+namespace Autoparam {
+
+namespace {
+
+char const magic[8] = {'A', 'P', 'T', 'R', 'A', 'F', 'F', 0};
+epicsUInt32 const version = 1;
+
+enum Tag { TagVariable = 1, TagCall = 2 };
+
+// Reads a traffic file field by field, remembering whether any read failed.
+class Reader {
+  public:
+    explicit Reader(FILE *file) : m_file(file), m_ok(true) {}
+
+    template <typename T> T get() {
+        T value = T();
+        read(&value, sizeof(value));
+        return value;
+    }
+
+    void read(void *dest, size_t size) {
+        if (m_ok && size > 0 && fread(dest, size, 1, m_file) != 1) {
+            m_ok = false;
+        }
+    }
+
+    bool ok() const { return m_ok; }
+
+  private:
+    FILE *m_file;
+    bool m_ok;
+};
+
+} // namespace
+
+TrafficCapture *TrafficCapture::create(char const *path) {
+    FILE *file = fopen(path, "wb");
+    if (file == NULL) {
+        return NULL;
+    }
+    TrafficCapture *capture = new TrafficCapture(file);
+    capture->put(magic, sizeof(magic));
+    capture->put(&version, sizeof(version));
+    return capture;
+}
+
+TrafficCapture::TrafficCapture(FILE *file)
+    : m_file(file), m_start(epicsMonotonicGet()), m_calls(0),
+      m_failed(false) {}
+
+TrafficCapture::~TrafficCapture() { fclose(m_file); }
+
+void TrafficCapture::put(void const *data, size_t size) {
+    if (!m_failed && size > 0 && fwrite(data, size, 1, m_file) != 1) {
+        m_failed = true;
+    }
+}
+
+void TrafficCapture::record(DeviceVariable const &var, TrafficCall const &call,
+                            void const *data, size_t size) {
+    size_t index = var.asynIndex();
+    if (m_defined.size() <= index) {
+        m_defined.resize(index + 1, false);
+    }
+    if (!m_defined[index]) {
+        m_defined[index] = true;
+        std::string const &name = var.asString();
+        epicsUInt8 tag = TagVariable;
+        epicsUInt8 type = var.asynType();
+        epicsUInt16 length = static_cast<epicsUInt16>(
+            std::min(name.size(), static_cast<size_t>(0xffff)));
+        put(&tag, sizeof(tag));
+        put(&call.variable, sizeof(call.variable));
+        put(&type, sizeof(type));
+        put(&length, sizeof(length));
+        put(name.data(), length);
+    }
+
+    epicsUInt8 tag = TagCall;
+    epicsUInt32 dataSize = static_cast<epicsUInt32>(size);
+    put(&tag, sizeof(tag));
+    put(&call.variable, sizeof(call.variable));
+    put(&call.kind, sizeof(call.kind));
+    put(&call.status, sizeof(call.status));
+    put(&call.alarmStatus, sizeof(call.alarmStatus));
+    put(&call.alarmSeverity, sizeof(call.alarmSeverity));
+    put(&call.processInterrupts, sizeof(call.processInterrupts));
+    put(&call.mask, sizeof(call.mask));
+    put(&call.start, sizeof(call.start));
+    put(&call.duration, sizeof(call.duration));
+    put(&call.timestamp.secPastEpoch, sizeof(call.timestamp.secPastEpoch));
+    put(&call.timestamp.nsec, sizeof(call.timestamp.nsec));
+    put(&dataSize, sizeof(dataSize));
+    put(data, size);
+    m_calls++;
+}
+
+TrafficReplay::TrafficReplay() : speed(0) {}
+
+TrafficReplay *TrafficReplay::load(char const *path, std::string &error) {
+    FILE *file = fopen(path, "rb");
+    if (file == NULL) {
+        error = "cannot open file";
+        return NULL;
+    }
+
+    Reader in(file);
+    char header[sizeof(magic)];
+    in.read(header, sizeof(header));
+    if (!in.ok() || std::memcmp(header, magic, sizeof(magic)) != 0 ||
+        in.get<epicsUInt32>() != version) {
+        fclose(file);
+        error = "not a traffic file of a supported version";
+        return NULL;
+    }
+
+    TrafficReplay *replay = new TrafficReplay;
+    // Variable ids in the file are asyn indices of the capturing driver.
+    std::map<epicsUInt32, size_t> ids;
+    int tag;
+    while (error.empty() && (tag = fgetc(file)) != EOF) {
+        if (tag == TagVariable) {
+            epicsUInt32 id = in.get<epicsUInt32>();
+            Variable var;
+            var.type = static_cast<asynParamType>(in.get<epicsUInt8>());
+            var.name.resize(in.get<epicsUInt16>());
+            if (!var.name.empty()) {
+                in.read(&var.name[0], var.name.size());
+            }
+            var.next[0] = var.next[1] = 0;
+            ids[id] = replay->m_variables.size();
+            replay->m_byName[var.name] = replay->m_variables.size();
+            replay->m_variables.push_back(var);
+        } else if (tag == TagCall) {
+            TrafficCall call;
+            std::map<epicsUInt32, size_t>::const_iterator id =
+                ids.find(in.get<epicsUInt32>());
+            call.kind = in.get<epicsUInt8>();
+            call.status = in.get<epicsInt16>();
+            call.alarmStatus = in.get<epicsInt16>();
+            call.alarmSeverity = in.get<epicsInt16>();
+            call.processInterrupts = in.get<epicsUInt8>();
+            call.mask = in.get<epicsUInt32>();
+            call.start = in.get<epicsUInt64>();
+            call.duration = in.get<epicsUInt64>();
+            call.timestamp.secPastEpoch = in.get<epicsUInt32>();
+            call.timestamp.nsec = in.get<epicsUInt32>();
+            call.data.resize(in.get<epicsUInt32>());
+            if (!call.data.empty()) {
+                in.read(&call.data[0], call.data.size());
+            }
+            if (id == ids.end() || call.kind > RequestWrite) {
+                error = "corrupt call record";
+                break;
+            }
+            call.variable = id->second;
+            replay->m_variables[id->second].calls[call.kind].push_back(
+                replay->m_calls.size());
+            replay->m_calls.push_back(call);
+        } else {
+            error = "unknown record";
+        }
+        if (!in.ok()) {
+            error = "truncated file";
+        }
+    }
+    fclose(file);
+
+    if (!error.empty()) {
+        delete replay;
+        return NULL;
+    }
+    return replay;
+}
+
+TrafficCall const *TrafficReplay::next(DeviceVariable const &var,
+                                       RequestKind kind) {
+    size_t index = var.asynIndex();
+    TrafficCall const *call = NULL;
+    m_lock.lock();
+    if (m_byIndex.size() <= index) {
+        m_byIndex.resize(index + 1, -2);
+    }
+    if (m_byIndex[index] == -2) {
+        std::map<std::string, size_t>::const_iterator i =
+            m_byName.find(var.asString());
+        m_byIndex[index] = i != m_byName.end() &&
+                                   m_variables[i->second].type == var.asynType()
+                               ? static_cast<int>(i->second)
+                               : -1;
+    }
+    if (m_byIndex[index] >= 0) {
+        Variable &recorded = m_variables[m_byIndex[index]];
+        std::vector<size_t> const &calls = recorded.calls[kind];
+        if (!calls.empty()) {
+            call = &m_calls[calls[recorded.next[kind]]];
+            recorded.next[kind] = (recorded.next[kind] + 1) % calls.size();
+        }
+    }
+    m_lock.unlock();
+    return call;
+}
+
+} // namespace Autoparam
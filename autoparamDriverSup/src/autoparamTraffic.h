@@ -0,0 +1,135 @@
+// SPDX-FileCopyrightText: 2022 Cosylab d.d. https://www.cosylab.com
+//
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+// Capturing handler calls to a file and replaying them. This header is private
+// to the library.
+//
+// A traffic file consists of a header followed by records. All integers are
+// stored in the byte order of the host that captured the file:
+//
+//   header:   "APTRAFF" and a NUL (8 bytes), u32 version
+//   variable: u8 tag (1), u32 id, u8 asynParamType, u16 length, the name of the
+//             variable as given by the record (`length` bytes); written before
+//             the first call of the variable
+//   call:     u8 tag (2), u32 variable id, u8 RequestKind, i16 status,
+//             i16 alarm status, i16 alarm severity,
+//             u8 ProcessInterrupts::ValueType,
+//             u32 mask, u64 start (ns since the capture started),
+//             u64 duration (ns), u32 and u32 time stamp, u32 size, the value
+//             (`size` bytes)
+//
+// The value is the one returned by a read handler or passed to a write handler:
+// a scalar, the elements of an array or the characters of a string. Generic
+// pointers are opaque, so their value is not stored.
+
+#include <cstdio>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <asynDriver.h>
+#include <epicsMutex.h>
+#include <epicsTime.h>
+#include <epicsTypes.h>
+
+#include "autoparamHandler.h"
+#include "autoparamRecorder.h"
+
+namespace Autoparam {
+
+// One handler call, as captured.
+struct TrafficCall {
+    epicsUInt32 variable;
+    epicsUInt8 kind;
+    epicsInt16 status;
+    epicsInt16 alarmStatus;
+    epicsInt16 alarmSeverity;
+    // A `ProcessInterrupts::ValueType`.
+    epicsUInt8 processInterrupts;
+    epicsUInt32 mask;
+    epicsUInt64 start;
+    epicsUInt64 duration;
+    epicsTimeStamp timestamp;
+    std::vector<char> data;
+};
+
+// Writes handler calls of one driver to a file. Not threadsafe; the driver
+// calls it while locked.
+class TrafficCapture {
+  public:
+    // Returns NULL if the file cannot be created.
+    static TrafficCapture *create(char const *path);
+    ~TrafficCapture();
+
+    void record(DeviceVariable const &var, TrafficCall const &call,
+                void const *data, size_t size);
+
+    // Converts a time given by `epicsMonotonicGet()` to the time since the
+    // capture started.
+    epicsUInt64 sinceStart(epicsUInt64 time) const {
+        return time > m_start ? time - m_start : 0;
+    }
+
+    size_t calls() const { return m_calls; }
+    bool failed() const { return m_failed; }
+
+  private:
+    explicit TrafficCapture(FILE *file);
+    TrafficCapture(TrafficCapture const &);
+    TrafficCapture &operator=(TrafficCapture const &);
+
+    void put(void const *data, size_t size);
+
+    FILE *m_file;
+    epicsUInt64 m_start;
+    // Indexed by asyn index.
+    std::vector<bool> m_defined;
+    size_t m_calls;
+    bool m_failed;
+};
+
+// The calls read from a traffic file. Substitutes recorded results for
+// handler calls while it is installed in a driver, taking the calls of each
+// variable in order and starting over once they run out.
+class TrafficReplay {
+  public:
+    struct Variable {
+        std::string name;
+        asynParamType type;
+        // Indices into `calls()`, by `RequestKind`.
+        std::vector<size_t> calls[2];
+        size_t next[2];
+    };
+
+    // Returns NULL and sets `error` if the file cannot be read.
+    static TrafficReplay *load(char const *path, std::string &error);
+
+    std::vector<Variable> const &variables() const { return m_variables; }
+    std::vector<TrafficCall> const &calls() const { return m_calls; }
+
+    // Handler calls are delayed by their recorded duration divided by this,
+    // or not at all if it is zero.
+    double speed;
+
+    // The call to substitute for a handler call of `var`, or NULL if there
+    // are no calls of that kind recorded for it. Threadsafe.
+    TrafficCall const *next(DeviceVariable const &var, RequestKind kind);
+
+  private:
+    TrafficReplay();
+    TrafficReplay(TrafficReplay const &);
+    TrafficReplay &operator=(TrafficReplay const &);
+
+    epicsMutex m_lock;
+    std::vector<Variable> m_variables;
+    std::vector<TrafficCall> m_calls;
+    std::map<std::string, size_t> m_byName;
+    // Variable by asyn index, resolved on first use: -1 if there is no such
+    // variable in the file, -2 if not resolved yet.
+    std::vector<int> m_byIndex;
+};
+
+} // namespace Autoparam
@@ -0,0 +1,285 @@
+// SPDX-FileCopyrightText: 2022 Cosylab d.d. https://www.cosylab.com
+//
+// SPDX-License-Identifier: MIT
+
+// Checks that dispatching requests and updating parameters does not allocate
+// memory once the variables are warmed up.
+
+#include <algorithm>
+
+#include <epicsUnitTest.h>
+#include <testMain.h>
+
+#include <autoparamDriver.h>
+
+#ifdef __GLIBC__
+#include <pthread.h>
+#define COUNT_ALLOCATIONS 1
+#endif
+
+using namespace Autoparam::Convenience;
+
+#ifdef COUNT_ALLOCATIONS
+
+// Replaces malloc() and friends for the whole process, including the C++
+// runtime, whose operator new is built on malloc(). Only allocations made by
+// the thread running the check are counted, and nothing is done that could
+// allocate in turn.
+extern "C" {
+void *__libc_malloc(size_t size);
+void *__libc_calloc(size_t count, size_t size);
+void *__libc_realloc(void *ptr, size_t size);
+}
+
+namespace {
+
+volatile bool counting = false;
+pthread_t countingThread;
+size_t allocations = 0;
+
+void countAllocation() {
+    if (counting && pthread_equal(pthread_self(), countingThread)) {
+        allocations++;
+    }
+}
+
+void startCounting() {
+    allocations = 0;
+    countingThread = pthread_self();
+    counting = true;
+}
+
+void stopCounting() { counting = false; }
+
+} // namespace
+
+extern "C" {
+
+void *malloc(size_t size) {
+    countAllocation();
+    return __libc_malloc(size);
+}
+
+void *calloc(size_t count, size_t size) {
+    countAllocation();
+    return __libc_calloc(count, size);
+}
+
+void *realloc(void *ptr, size_t size) {
+    countAllocation();
+    return __libc_realloc(ptr, size);
+}
+
+} // extern "C"
+
+#endif // COUNT_ALLOCATIONS
+
+namespace {
+
+class TestDriver;
+
+class TestAddress : public DeviceAddress {
+  public:
+    bool operator==(DeviceAddress const &other) const {
+        return function == static_cast<TestAddress const &>(other).function;
+    }
+
+    std::string function;
+};
+
+class TestVar : public DeviceVariable {
+  public:
+    TestVar(DeviceVariable *baseVar, TestDriver *driver)
+        : DeviceVariable(baseVar), driver(driver) {}
+
+    TestDriver *driver;
+};
+
+// Keeps the values written in memory.
+class TestDriver : public Autoparam::Driver {
+  public:
+    explicit TestDriver(char const *portName)
+        : Autoparam::Driver(portName, Autoparam::DriverOpts()), value(0),
+          bits(0) {
+        registerHandlers<epicsInt32>("VALUE", readValue, writeValue, NULL);
+        registerHandlers<epicsUInt32>("BITS", readBits, writeBits, NULL);
+        registerHandlers<Array<epicsInt8> >("WFM", readWaveform,
+                                            writeWaveform, NULL);
+        std::fill(waveform, waveform + sizeof(waveform), 0);
+    }
+
+    using Autoparam::Driver::deviceVariableFromUser;
+    using Autoparam::Driver::doCallbacksArray;
+    using Autoparam::Driver::setParam;
+
+  protected:
+    DeviceAddress *parseDeviceAddress(std::string const &function,
+                                      std::string const &) {
+        TestAddress *addr = new (arena()) TestAddress;
+        addr->function = function;
+        return addr;
+    }
+
+    DeviceVariable *createDeviceVariable(DeviceVariable *baseVar) {
+        return new (arena()) TestVar(baseVar, this);
+    }
+
+  private:
+    static TestDriver &driverOf(DeviceVariable &var) {
+        return *static_cast<TestVar &>(var).driver;
+    }
+
+    static Int32ReadResult readValue(DeviceVariable &var) {
+        Int32ReadResult result;
+        result.value = driverOf(var).value;
+        return result;
+    }
+
+    static WriteResult writeValue(DeviceVariable &var, epicsInt32 value) {
+        driverOf(var).value = value;
+        return WriteResult();
+    }
+
+    static UInt32ReadResult readBits(DeviceVariable &var, epicsUInt32 mask) {
+        UInt32ReadResult result;
+        result.value = driverOf(var).bits & mask;
+        return result;
+    }
+
+    static WriteResult writeBits(DeviceVariable &var, epicsUInt32 value,
+                                 epicsUInt32 mask) {
+        epicsUInt32 &bits = driverOf(var).bits;
+        bits = (bits & ~mask) | (value & mask);
+        return WriteResult();
+    }
+
+    static ArrayReadResult readWaveform(DeviceVariable &var,
+                                        Array<epicsInt8> &value) {
+        epicsInt8 const *waveform = driverOf(var).waveform;
+        size_t size = std::min(value.maxSize(), sizeof(driverOf(var).waveform));
+        std::copy(waveform, waveform + size, value.data());
+        value.setSize(size);
+        return ArrayReadResult();
+    }
+
+    static WriteResult writeWaveform(DeviceVariable &var,
+                                     Array<epicsInt8> const &value) {
+        size_t size = std::min(value.size(), sizeof(driverOf(var).waveform));
+        std::copy(value.data(), value.data() + size, driverOf(var).waveform);
+        return WriteResult();
+    }
+
+    epicsInt32 value;
+    epicsUInt32 bits;
+    epicsInt8 waveform[8];
+};
+
+asynInterface *connectUser(char const *reason, char const *ifaceType,
+                           asynUser **user) {
+    *user = pasynManager->createAsynUser(NULL, NULL);
+    if (pasynManager->connectDevice(*user, "ALLOC", 0) != asynSuccess) {
+        return NULL;
+    }
+    asynInterface *drvUser =
+        pasynManager->findInterface(*user, asynDrvUserType, 1);
+    if (drvUser == NULL) {
+        return NULL;
+    }
+    asynDrvUser *pdrvUser = static_cast<asynDrvUser *>(drvUser->pinterface);
+    if (pdrvUser->create(drvUser->drvPvt, *user, reason, NULL, NULL) !=
+        asynSuccess) {
+        return NULL;
+    }
+    return pasynManager->findInterface(*user, ifaceType, 1);
+}
+
+void ignoreInt32(void *, asynUser *, epicsInt32) {}
+
+void ignoreInt8Array(void *, asynUser *, epicsInt8 *, size_t) {}
+
+void testDispatch(int iterations) {
+    TestDriver *driver = new TestDriver("ALLOC");
+
+    asynUser *valueUser;
+    asynUser *bitsUser;
+    asynUser *wfmUser;
+    asynInterface *valueIface =
+        connectUser("VALUE", asynInt32Type, &valueUser);
+    asynInterface *bitsIface =
+        connectUser("BITS", asynUInt32DigitalType, &bitsUser);
+    asynInterface *wfmIface = connectUser("WFM", asynInt8ArrayType, &wfmUser);
+    if (!testOk(valueIface != NULL && bitsIface != NULL && wfmIface != NULL,
+                "Users connected to the test driver")) {
+        testAbort("Cannot continue without users");
+    }
+
+    asynInt32 *pint = static_cast<asynInt32 *>(valueIface->pinterface);
+    asynUInt32Digital *pbits =
+        static_cast<asynUInt32Digital *>(bitsIface->pinterface);
+    asynInt8Array *pwfm = static_cast<asynInt8Array *>(wfmIface->pinterface);
+    // Subscribers make setParam() and doCallbacksArray() call back.
+    void *valueRegistrar;
+    void *wfmRegistrar;
+    pint->registerInterruptUser(valueIface->drvPvt, valueUser, ignoreInt32,
+                                NULL, &valueRegistrar);
+    pwfm->registerInterruptUser(wfmIface->drvPvt, wfmUser, ignoreInt8Array,
+                                NULL, &wfmRegistrar);
+
+    DeviceVariable *valueVar = driver->deviceVariableFromUser(valueUser);
+    DeviceVariable *wfmVar = driver->deviceVariableFromUser(wfmUser);
+    epicsInt8 wfm[4] = {1, 2, 3, 4};
+    epicsInt8 wfmRead[8];
+    epicsInt32 value = -1;
+    epicsUInt32 bits = 0;
+
+    // The first round is not counted: it may size buffers.
+    for (int i = -1; i < iterations; ++i) {
+#ifdef COUNT_ALLOCATIONS
+        if (i == 0) {
+            startCounting();
+        }
+#endif
+        pint->write(valueIface->drvPvt, valueUser, i);
+        pint->read(valueIface->drvPvt, valueUser, &value);
+
+        pbits->write(bitsIface->drvPvt, bitsUser, i, 0x5);
+        pbits->read(bitsIface->drvPvt, bitsUser, &bits, 0x5);
+
+        size_t size;
+        wfm[0] = i;
+        pwfm->write(wfmIface->drvPvt, wfmUser, wfm, 4);
+        pwfm->read(wfmIface->drvPvt, wfmUser, wfmRead, 8, &size);
+
+        Array<epicsInt8> array(wfm, 4);
+        driver->lock();
+        driver->setParam(*valueVar, i);
+        driver->callParamCallbacks();
+        driver->doCallbacksArray(*wfmVar, array);
+        driver->unlock();
+    }
+#ifdef COUNT_ALLOCATIONS
+    stopCounting();
+#endif
+
+    testOk(value == iterations - 1, "Int32 values reach the handlers");
+    testOk(bits == ((iterations - 1) & 0x5), "Masked bits reach the handlers");
+    testOk(wfmRead[0] == static_cast<epicsInt8>(iterations - 1),
+           "Arrays reach the handlers");
+#ifdef COUNT_ALLOCATIONS
+    testOk(allocations == 0, "%lu allocations in %d iterations",
+           (unsigned long)allocations, iterations);
+#else
+    testSkip(1, "Allocations can only be counted with glibc");
+#endif
+
+    pint->cancelInterruptUser(valueIface->drvPvt, valueUser, valueRegistrar);
+    pwfm->cancelInterruptUser(wfmIface->drvPvt, wfmUser, wfmRegistrar);
+}
+
+} // namespace
+
+MAIN(autoparamAllocTest) {
+    testPlan(5);
+    testDispatch(1000);
+    return testDone();
+}
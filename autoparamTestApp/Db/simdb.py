@@ -0,0 +1,139 @@
+#!/usr/bin/env python3
+
+# SPDX-FileCopyrightText: 2022 Cosylab d.d. https://www.cosylab.com
+#
+# SPDX-License-Identifier: MIT
+
+"""Generate a database for the simulated device driver.
+
+The records exercise the paths of the driver that are worth measuring:
+
+  read      periodically scanned longin records, one request each
+  write     longout records, processed by the client
+  intr      I/O Intr longin records of the same registers as read records
+  polled    I/O Intr longin records updated by the poller in one snapshot
+  block     periodically scanned waveform records reading a range of
+            registers
+  bits      bo records, each writing one bit of a register through the
+            shadow register of the BITS function
+  setpoint  longout records of the SETPOINT function, whose writes are
+            collected into write batches
+
+Registers are assigned round robin, wrapping around at --registers, and
+records of the read, write, block and bits kinds are spread over --groups
+device groups. Bits records use the 32 bits of a register, all in the same
+group so that they share its shadow register, before moving on to the next
+one. For example, to measure 1000 records scanned at 10 Hz:
+
+  simdb.py --read 1000 --scan ".1 second" > sim.db
+"""
+
+import argparse
+import sys
+
+
+def record(out, rtype, name, fields):
+    out.write('record(%s, "%s") {\n' % (rtype, name))
+    for field, value in fields:
+        out.write('    field(%s, "%s")\n' % (field, value))
+    out.write("}\n\n")
+
+
+def group_suffix(args, index):
+    if args.groups <= 0:
+        return ""
+    return " g%d" % (index % args.groups)
+
+
+def generate(args, out):
+    out.write("# Generated by simdb.py %s\n\n" % " ".join(sys.argv[1:]))
+    port = args.port
+    prefix = args.prefix
+    registers = args.registers
+
+    for i in range(args.read):
+        record(out, "longin", "%s:read%d" % (prefix, i), [
+            ("DTYP", "asynInt32"),
+            ("SCAN", args.scan),
+            ("INP", "@asyn(%s) REG %d%s"
+             % (port, i % registers, group_suffix(args, i))),
+        ])
+
+    for i in range(args.write):
+        record(out, "longout", "%s:write%d" % (prefix, i), [
+            ("DTYP", "asynInt32"),
+            ("OUT", "@asyn(%s) REG %d%s"
+             % (port, i % registers, group_suffix(args, i))),
+        ])
+
+    for i in range(args.intr):
+        record(out, "longin", "%s:intr%d" % (prefix, i), [
+            ("DTYP", "asynInt32"),
+            ("SCAN", "I/O Intr"),
+            ("INP", "@asyn(%s) REG %d%s"
+             % (port, i % registers, group_suffix(args, i))),
+        ])
+
+    for i in range(args.polled):
+        record(out, "longin", "%s:polled%d" % (prefix, i), [
+            ("DTYP", "asynInt32"),
+            ("SCAN", "I/O Intr"),
+            ("TSE", "-2"),
+            ("INP", "@asyn(%s) POLLED %d" % (port, i % registers)),
+        ])
+
+    size = min(args.block_size, registers)
+    for i in range(args.block):
+        record(out, "waveform", "%s:block%d" % (prefix, i), [
+            ("DTYP", "asynInt32ArrayIn"),
+            ("SCAN", args.scan),
+            ("FTVL", "LONG"),
+            ("NELM", str(size)),
+            ("INP", "@asyn(%s) BLOCK %d %d%s"
+             % (port, (i * size) % (registers - size + 1), size,
+                group_suffix(args, i))),
+        ])
+
+    for i in range(args.bits):
+        record(out, "bo", "%s:bits%d" % (prefix, i), [
+            ("DTYP", "asynUInt32Digital"),
+            ("OUT", "@asynMask(%s, 0, 0x%x) BITS %d%s"
+             % (port, 1 << (i % 32), (i // 32) % registers,
+                group_suffix(args, i // 32))),
+        ])
+
+    for i in range(args.setpoint):
+        record(out, "longout", "%s:setpoint%d" % (prefix, i), [
+            ("DTYP", "asynInt32"),
+            ("OUT", "@asyn(%s) SETPOINT %d" % (port, i % registers)),
+        ])
+
+
+def main():
+    parser = argparse.ArgumentParser(
+        description=__doc__,
+        formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--prefix", default="sim", help="record name prefix")
+    parser.add_argument("--port", default="SIM", help="asyn port name")
+    parser.add_argument("--registers", type=int, default=1024,
+                        help="registers of the simulated device")
+    parser.add_argument("--groups", type=int, default=0,
+                        help="number of device groups, 0 for none")
+    parser.add_argument("--scan", default="1 second",
+                        help="SCAN of read and block records")
+    parser.add_argument("--read", type=int, default=0)
+    parser.add_argument("--write", type=int, default=0)
+    parser.add_argument("--intr", type=int, default=0)
+    parser.add_argument("--polled", type=int, default=0)
+    parser.add_argument("--block", type=int, default=0)
+    parser.add_argument("--block-size", type=int, default=64)
+    parser.add_argument("--bits", type=int, default=0)
+    parser.add_argument("--setpoint", type=int, default=0)
+    args = parser.parse_args()
+    if args.registers <= 0 or args.block_size <= 0:
+        parser.error("--registers and --block-size must be positive")
+    generate(args, sys.stdout)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,131 @@
+// SPDX-FileCopyrightText: 2022 Cosylab d.d. https://www.cosylab.com
+//
+// SPDX-License-Identifier: MIT
+
+// An example driver for memory-mapped registers, e.g. of a UIO device. It can
+// be tried out on a regular file instead:
+//
+//     truncate -s 4096 /tmp/regs
+//     drvAutoparamRegsConfigure("REGS", "/tmp/regs", 4096, 0)
+//
+// The same registers can be driven by a generic RegisterDriver instead, given
+// a description of them, e.g.
+//
+//     group fast 0.1
+//     STATUS  0x00 uint32 ro group=fast
+//     READY   0x00 uint32 ro bits=0:0 group=fast
+//     TEMP    0x04 int16  ro eslo=0.0625 group=fast
+//     SETPT   0x08 int32  rw
+//
+//     drvAutoparamTableConfigure("TABLE", "regs.txt", "/tmp/regs", 4096, 0)
+
+#include <autoparamDriver.h>
+#include <autoparamRegisterDriver.h>
+#include <autoparamRegisters.h>
+#include <cstdio>
+#include <iocsh.h>
+#include <epicsExport.h>
+
+using namespace Autoparam::Convenience;
+using Autoparam::MappedRegisterBus;
+using Autoparam::RegisterAddress;
+using Autoparam::RegisterDriver;
+using Autoparam::RegisterMap;
+using Autoparam::RegisterVariable;
+using Autoparam::Registers;
+
+// Functions:
+// - "REG <offset> [width=..] [bits=..]" as an Int32,
+// - "BITS <offset> [width=..] [bits=..]" as an UInt32Digital,
+// - "BLOCK <offset> count=<n>" as an Int32Array of 32-bit registers.
+class RegsDriver : public Autoparam::Driver {
+  public:
+    RegsDriver(char const *portName, RegisterMap *map)
+        : Autoparam::Driver(portName,
+                            Autoparam::DriverOpts().setAutoDestruct()),
+          map(map) {
+        registerHandlers<epicsInt32>("REG", Registers::readInt32,
+                                     Registers::writeInt32, NULL);
+        registerHandlers<epicsUInt32>("BITS", Registers::readDigital,
+                                      Registers::writeDigital, NULL);
+        registerHandlers<Array<epicsInt32> >(
+            "BLOCK", Registers::readArray<epicsInt32>,
+            Registers::writeArray<epicsInt32>, NULL);
+    }
+
+    ~RegsDriver() { delete map; }
+
+  protected:
+    DeviceAddress *parseDeviceAddress(std::string const &function,
+                                      std::string const &arguments) {
+        RegisterAddress *addr = new (arena()) RegisterAddress;
+        std::string error;
+        if (!addr->parse(arguments, *map, error)) {
+            printf("Bad arguments for %s '%s': %s\n", function.c_str(),
+                   arguments.c_str(), error.c_str());
+            delete addr;
+            return NULL;
+        }
+        return addr;
+    }
+
+    DeviceVariable *createDeviceVariable(DeviceVariable *baseVar) {
+        return new (arena()) RegisterVariable(baseVar, map);
+    }
+
+  private:
+    RegisterMap *map;
+};
+
+static int const numArgs = 4;
+static iocshArg const arg1 = {"port name", iocshArgString};
+static iocshArg const arg2 = {"file", iocshArgString};
+static iocshArg const arg3 = {"size", iocshArgInt};
+static iocshArg const arg4 = {"offset", iocshArgInt};
+static iocshArg const *const args[numArgs] = {&arg1, &arg2, &arg3, &arg4};
+static iocshFuncDef command = {"drvAutoparamRegsConfigure", numArgs, args};
+
+static void call(iocshArgBuf const *args) {
+    if (args[1].sval == NULL || args[2].ival <= 0 || args[3].ival < 0) {
+        printf("A file, a positive size and an offset are required\n");
+        return;
+    }
+    RegisterMap *map = RegisterMap::open(args[1].sval, args[2].ival,
+                                         args[3].ival);
+    if (map != NULL) {
+        new RegsDriver(args[0].sval, map);
+    }
+}
+
+static int const numTableArgs = 5;
+static iocshArg const tableArg2 = {"description", iocshArgString};
+static iocshArg const *const tableArgs[numTableArgs] = {&arg1, &tableArg2,
+                                                        &arg2, &arg3, &arg4};
+static iocshFuncDef tableCommand = {"drvAutoparamTableConfigure",
+                                    numTableArgs, tableArgs};
+
+static void callTable(iocshArgBuf const *args) {
+    if (args[1].sval == NULL || args[2].sval == NULL || args[3].ival <= 0 ||
+        args[4].ival < 0) {
+        printf("A description, a file, a positive size and an offset are "
+               "required\n");
+        return;
+    }
+    RegisterMap *map = RegisterMap::open(args[2].sval, args[3].ival,
+                                         args[4].ival);
+    if (map != NULL) {
+        RegisterDriver::create(args[0].sval, args[1].sval,
+                               new MappedRegisterBus(map),
+                               Autoparam::DriverOpts().setAutoDestruct());
+    }
+}
+
+extern "C" {
+
+static void autoparamRegsCommandRegistrar() {
+    iocshRegister(&command, call);
+    iocshRegister(&tableCommand, callTable);
+}
+
+epicsExportRegistrar(autoparamRegsCommandRegistrar);
+}
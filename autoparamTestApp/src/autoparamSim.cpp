@@ -0,0 +1,332 @@
+// SPDX-FileCopyrightText: 2022 Cosylab d.d. https://www.cosylab.com
+//
+// SPDX-License-Identifier: MIT
+
+// An example driver for a simulated device, used to measure throughput and
+// latency of request dispatch, polling and batching without hardware. See
+// simdb.py for generating databases to load it with.
+
+#include <autoparamDriver.h>
+#include <autoparamSimulator.h>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <sstream>
+#include <iocsh.h>
+#include <epicsThread.h>
+#include <epicsExport.h>
+
+using namespace Autoparam::Convenience;
+using Autoparam::SimulatedDevice;
+
+class SimDriver;
+
+// "REG <address> [<group>]", "BITS <address> [<group>]",
+// "BLOCK <address> <count> [<group>]", "POLLED <address>" or
+// "SETPOINT <address>".
+class SimAddress : public DeviceAddress {
+  public:
+    SimAddress() : address(0), count(1) {}
+
+    bool operator==(DeviceAddress const &other) const {
+        SimAddress const &o = static_cast<SimAddress const &>(other);
+        return function == o.function && address == o.address &&
+               count == o.count && group == o.group;
+    }
+
+    // Requests for different groups are handled in parallel, so that the
+    // concurrency limit of the simulator can be reached.
+    std::string deviceName() const { return group; }
+
+    std::string function;
+    size_t address;
+    size_t count;
+    std::string group;
+};
+
+class SimVar : public DeviceVariable {
+  public:
+    SimVar(DeviceVariable *baseVar, SimDriver *driver)
+        : DeviceVariable(baseVar), driver(driver) {}
+
+    SimAddress const &simAddress() const {
+        return static_cast<SimAddress const &>(address());
+    }
+
+    SimDriver *driver;
+};
+
+class SimDriver : public Autoparam::Driver {
+
+    // Reads all registers in one transaction and publishes them to the
+    // POLLED records as a snapshot.
+    class Poller : public epicsThreadRunable {
+      public:
+        Poller(SimDriver *self) : self(self) {}
+
+        void run() {
+            while (true) {
+                epicsThreadSleep(self->pollPeriod);
+                self->lock();
+                bool quit = self->quitThread;
+                self->unlock();
+                if (quit) {
+                    return;
+                }
+
+                self->pollStatus = self->device.read(
+                    0, &self->pollBuffer[0], self->pollBuffer.size());
+                self->takeSnapshot("poll");
+            }
+        }
+
+      private:
+        SimDriver *self;
+    };
+
+  public:
+    SimDriver(char const *portName, size_t numRegisters, double pollPeriod)
+        : Autoparam::Driver(portName, Autoparam::DriverOpts()
+                                          .setBlocking()
+                                          .setAutoDestruct()
+                                          .setDeviceGroups()),
+          device(numRegisters), pollBuffer(numRegisters),
+          pollStatus(asynSuccess), pollPeriod(pollPeriod),
+          thread(poller, "AutoparamSimPoller", epicsThreadStackMedium),
+          poller(this), quitThread(false) {
+        registerHandlers<epicsInt32>("REG", readRegister, writeRegister, NULL);
+        // Masked writes by bo and mbbo records are merged into the shadow
+        // register instead of reading the register for each of them.
+        registerHandlers<epicsUInt32>(
+            "BITS", readBits, writeBits, NULL,
+            Autoparam::FunctionOpts().setShadowRegister(10));
+        registerHandlers<Array<epicsInt32> >("BLOCK", readBlock, writeBlock,
+                                             NULL);
+        registerHandlers<epicsInt32>(
+            "POLLED", NULL, NULL, NULL,
+            Autoparam::FunctionOpts().setSnapshotGroup("poll"));
+        registerSnapshotHandler("poll", readPolled);
+        // Setpoints written within 50 ms of each other are written to the
+        // device together.
+        registerHandlers<epicsInt32>(
+            "SETPOINT", NULL, NULL, NULL,
+            Autoparam::FunctionOpts().setWriteBatch("setpoints"));
+        registerBatchHandler("setpoints", writeSetpoints, 0.05);
+
+        if (pollPeriod > 0 && numRegisters > 0) {
+            thread.start();
+        }
+    }
+
+    ~SimDriver() {
+        lock();
+        quitThread = true;
+        unlock();
+        if (pollPeriod > 0 && device.size() > 0) {
+            thread.exitWait();
+        }
+    }
+
+    SimulatedDevice &simulator() { return device; }
+
+    void report(FILE *fp, int details) {
+        Autoparam::Driver::report(fp, details);
+        device.report(fp);
+    }
+
+  protected:
+    DeviceAddress *parseDeviceAddress(std::string const &function,
+                                      std::string const &arguments) {
+        SimAddress *p = new (arena()) SimAddress;
+        p->function = function;
+
+        std::istringstream is(arguments);
+        if (!(is >> p->address) ||
+            (function == "BLOCK" && !(is >> p->count))) {
+            printf("Bad arguments for %s: '%s'\n", function.c_str(),
+                   arguments.c_str());
+            return NULL;
+        }
+        if (function != "POLLED" && function != "SETPOINT") {
+            is >> p->group;
+        }
+        if (p->address > device.size() ||
+            p->count > device.size() - p->address) {
+            printf("Registers of %s %s are out of range\n", function.c_str(),
+                   arguments.c_str());
+            return NULL;
+        }
+        return p;
+    }
+
+    DeviceVariable *createDeviceVariable(DeviceVariable *baseVar) {
+        return new (arena()) SimVar(baseVar, this);
+    }
+
+  private:
+    static Int32ReadResult readRegister(DeviceVariable &baseVar) {
+        Int32ReadResult result;
+        SimVar &var = static_cast<SimVar &>(baseVar);
+        epicsUInt32 value;
+        result.status =
+            var.driver->device.read(var.simAddress().address, &value);
+        result.value = value;
+        return result;
+    }
+
+    static WriteResult writeRegister(DeviceVariable &baseVar,
+                                     epicsInt32 value) {
+        WriteResult result;
+        SimVar &var = static_cast<SimVar &>(baseVar);
+        epicsUInt32 reg = value;
+        result.status =
+            var.driver->device.write(var.simAddress().address, &reg);
+        return result;
+    }
+
+    static UInt32ReadResult readBits(DeviceVariable &baseVar,
+                                     epicsUInt32 mask) {
+        UInt32ReadResult result;
+        SimVar &var = static_cast<SimVar &>(baseVar);
+        result.status =
+            var.driver->device.read(var.simAddress().address, &result.value);
+        result.value &= mask;
+        return result;
+    }
+
+    // Reads, merges and writes back the register unless all bits are written.
+    static WriteResult writeBits(DeviceVariable &baseVar, epicsUInt32 value,
+                                 epicsUInt32 mask) {
+        WriteResult result;
+        SimVar &var = static_cast<SimVar &>(baseVar);
+        size_t address = var.simAddress().address;
+        epicsUInt32 reg = value;
+        if (mask != 0xffffffff) {
+            result.status = var.driver->device.read(address, &reg);
+            if (result.status != asynSuccess) {
+                return result;
+            }
+            reg = (reg & ~mask) | (value & mask);
+        }
+        result.status = var.driver->device.write(address, &reg);
+        return result;
+    }
+
+    static ArrayReadResult readBlock(DeviceVariable &baseVar,
+                                     Array<epicsInt32> &value) {
+        ArrayReadResult result;
+        SimVar &var = static_cast<SimVar &>(baseVar);
+        size_t count = std::min(var.simAddress().count, value.maxSize());
+        result.status = var.driver->device.read(
+            var.simAddress().address,
+            reinterpret_cast<epicsUInt32 *>(value.data()), count);
+        value.setSize(result.status == asynSuccess ? count : 0);
+        return result;
+    }
+
+    static WriteResult writeBlock(DeviceVariable &baseVar,
+                                  Array<epicsInt32> const &value) {
+        WriteResult result;
+        SimVar &var = static_cast<SimVar &>(baseVar);
+        size_t count = std::min(var.simAddress().count, value.size());
+        result.status = var.driver->device.write(
+            var.simAddress().address,
+            reinterpret_cast<epicsUInt32 const *>(value.data()), count);
+        return result;
+    }
+
+    static asynStatus readPolled(Autoparam::Snapshot &snapshot) {
+        std::vector<DeviceVariable *> const &vars = snapshot.variables();
+        if (vars.empty()) {
+            return asynSuccess;
+        }
+        SimDriver *self = static_cast<SimVar *>(vars.front())->driver;
+        if (self->pollStatus != asynSuccess) {
+            return self->pollStatus;
+        }
+        for (size_t i = 0; i < vars.size(); ++i) {
+            SimVar &var = *static_cast<SimVar *>(vars[i]);
+            epicsInt32 value = self->pollBuffer[var.simAddress().address];
+            snapshot.setValue(var, value);
+        }
+        return asynSuccess;
+    }
+
+    // Writes runs of consecutive setpoints in one transaction each.
+    static asynStatus writeSetpoints(Autoparam::WriteBatch &batch) {
+        // Pairs of address and position in the batch.
+        std::vector<std::pair<size_t, size_t> > order;
+        for (size_t i = 0; i < batch.size(); ++i) {
+            SimVar &var = static_cast<SimVar &>(batch.variable(i));
+            order.push_back(std::make_pair(var.simAddress().address, i));
+        }
+        std::sort(order.begin(), order.end());
+        SimDriver *self = static_cast<SimVar &>(batch.variable(0)).driver;
+
+        std::vector<epicsUInt32> run;
+        for (size_t i = 0; i < order.size(); ++i) {
+            run.push_back(batch.value<epicsInt32>(order[i].second));
+            size_t address = order[i].first;
+            if (i + 1 < order.size() && order[i + 1].first == address + 1) {
+                continue;
+            }
+            asynStatus status = self->device.write(address + 1 - run.size(),
+                                                   &run[0], run.size());
+            for (size_t j = i + 1 - run.size(); j <= i; ++j) {
+                batch.result(order[j].second).status = status;
+            }
+            run.clear();
+        }
+        return asynSuccess;
+    }
+
+    SimulatedDevice device;
+    // Only accessed by the poller thread and the snapshot handler it calls.
+    std::vector<epicsUInt32> pollBuffer;
+    asynStatus pollStatus;
+    double pollPeriod;
+    epicsThread thread;
+    Poller poller;
+    bool quitThread;
+};
+
+static int const numArgs = 8;
+static iocshArg const arg1 = {"port name", iocshArgString};
+static iocshArg const arg2 = {"registers", iocshArgInt};
+static iocshArg const arg3 = {"latency (fixed|normal|longtail)",
+                              iocshArgString};
+static iocshArg const arg4 = {"typical latency [s]", iocshArgDouble};
+static iocshArg const arg5 = {"latency spread [s]", iocshArgDouble};
+static iocshArg const arg6 = {"failure rate", iocshArgDouble};
+static iocshArg const arg7 = {"max concurrent", iocshArgInt};
+static iocshArg const arg8 = {"poll period [s]", iocshArgDouble};
+static iocshArg const *const args[numArgs] = {&arg1, &arg2, &arg3, &arg4,
+                                              &arg5, &arg6, &arg7, &arg8};
+static iocshFuncDef command = {"drvAutoparamSimConfigure", numArgs, args};
+
+static void call(iocshArgBuf const *args) {
+    SimulatedDevice::Distribution distribution =
+        SimulatedDevice::LatencyFixed;
+    if (args[2].sval != NULL &&
+        !SimulatedDevice::parseDistribution(args[2].sval, distribution)) {
+        printf("Unknown latency distribution: %s\n", args[2].sval);
+        return;
+    }
+    if (args[1].ival <= 0 || args[6].ival < 0) {
+        printf("Registers must be positive and max concurrent not negative\n");
+        return;
+    }
+
+    SimDriver *driver = new SimDriver(args[0].sval, args[1].ival, args[7].dval);
+    SimulatedDevice &device = driver->simulator();
+    device.setLatency(distribution, args[3].dval, args[4].dval);
+    device.setFailures(args[5].dval);
+    device.setMaxConcurrent(args[6].ival);
+}
+
+extern "C" {
+
+static void autoparamSimCommandRegistrar() { iocshRegister(&command, call); }
+
+epicsExportRegistrar(autoparamSimCommandRegistrar);
+}
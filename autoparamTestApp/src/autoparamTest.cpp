@@ -3,13 +3,21 @@
 // SPDX-License-Identifier: MIT
 
 #include <autoparamDriver.h>
+#include <algorithm>
 #include <sstream>
 #include <ctime>
 #include <cstdlib>
+#include <cstring>
 #include <iocsh.h>
 #include <epicsThread.h>
+#include <epicsTime.h>
 #include <epicsExport.h>
 
+#ifdef __linux__
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
 #ifdef _MSC_VER
 // Windows doesn't have rand_r, instead it reseeds rand, so it's ok.
 #define rand_r(x) rand()
@@ -23,6 +31,13 @@ class AutoparamTest;
 
 typedef std::vector<std::string> ArgumentList;
 
+// The structured payload passed around by the BLOB function.
+struct BlobPacket {
+    epicsUInt32 sequence;
+    size_t size;
+    epicsInt8 const *data;
+};
+
 class MyAddress : public DeviceAddress {
   public:
     bool operator==(DeviceAddress const &other) const {
@@ -63,7 +78,7 @@ class AutoparamTest : public Autoparam::Driver {
                 }
 
                 std::vector<DeviceVariable *> intrs =
-                    self->getInterruptVariables();
+                    self->getPollVariables();
                 for (std::vector<DeviceVariable *>::iterator i = intrs.begin(),
                                                              end = intrs.end();
                      i != end; ++i) {
@@ -87,10 +102,13 @@ class AutoparamTest : public Autoparam::Driver {
         : Autoparam::Driver(
               portName, Autoparam::DriverOpts().setAutoDestruct().setInitHook(
                             AutoparamTest::testInitHook)),
-          randomSeed(time(NULL) + clock()), currentSum(0), shiftedRegister(0),
+          randomSeed(time(NULL) + clock()), blobSequence(0), currentSum(0),
+          shiftedRegister(0), lastEvent(0),
           thread(runnable, "AutoparamTestThread", epicsThreadStackMedium),
           runnable(this), quitThread(false) {
-        registerHandlers<epicsInt32>("RANDOM", randomRead, NULL, interruptReg);
+        registerHandlers<epicsInt32>(
+            "RANDOM", randomRead, NULL, interruptReg,
+            Autoparam::FunctionOpts().setPollPeriod(interruptScanPeriod));
         registerHandlers<epicsInt32>("SUM", readSum, sumArgs, NULL);
         registerHandlers<epicsFloat64>("ERROR", erroredRead, NULL, NULL);
         registerHandlers<Array<epicsInt8> >("WFM8", wfm8Read, wfm8Write, NULL);
@@ -98,6 +116,18 @@ class AutoparamTest : public Autoparam::Driver {
         registerHandlers<epicsUInt32>("DIGIO", bitsGet, bitsSet, NULL);
         registerHandlers<Octet>("ARGECHO", argEcho, NULL, NULL);
         registerHandlers<Octet>("PRINT", NULL, stringPrint, NULL);
+        registerHandlers<GenericPointer>("BLOB", blobRead, NULL, NULL);
+        registerHandlers<Array<epicsInt8> >("BLOB8", NULL, NULL, NULL);
+        registerHandlers<epicsInt32>("EVENT", eventRead, NULL, NULL);
+
+        // Values written to the pipe by sendEvent() update EVENT records.
+        eventPipe[0] = eventPipe[1] = -1;
+#ifdef __linux__
+        if (pipe(eventPipe) == 0) {
+            fcntl(eventPipe[0], F_SETFL, O_NONBLOCK);
+            watchDescriptor(eventPipe[0], eventsReadable, this);
+        }
+#endif
 
         thread.start();
     }
@@ -107,12 +137,34 @@ class AutoparamTest : public Autoparam::Driver {
         quitThread = true;
         unlock();
         thread.exitWait();
+#ifdef __linux__
+        if (eventPipe[0] >= 0) {
+            unwatchDescriptor(eventPipe[0]);
+            close(eventPipe[0]);
+            close(eventPipe[1]);
+        }
+#endif
+    }
+
+    // Passes `value` to EVENT records through the driver's event loop.
+    void sendEvent(epicsInt32 value) {
+#ifdef __linux__
+        if (eventPipe[1] >= 0 &&
+            write(eventPipe[1], &value, sizeof(value)) == sizeof(value)) {
+            return;
+        }
+#endif
+        printf("Cannot send events on port %s\n", portName);
     }
 
+    // Compares passing a payload to in-process subscribers via
+    // asynGenericPointer against serializing it into an asynInt8Array.
+    void benchmarkBlob(size_t size, int iterations);
+
   protected:
     DeviceAddress *parseDeviceAddress(std::string const &function,
                                       std::string const &arguments) {
-        MyAddress *p = new MyAddress;
+        MyAddress *p = new (arena()) MyAddress;
         p->function = function;
 
         std::istringstream is(arguments);
@@ -125,7 +177,7 @@ class AutoparamTest : public Autoparam::Driver {
     }
 
     DeviceVariable *createDeviceVariable(DeviceVariable *baseVar) {
-        return new MyVar(baseVar, this);
+        return new (arena()) MyVar(baseVar, this);
     }
 
   private:
@@ -136,13 +188,13 @@ class AutoparamTest : public Autoparam::Driver {
                driver);
         std::vector<DeviceVariable *> pvs = self->getAllVariables();
         for (size_t i = 0; i < pvs.size(); ++i) {
-            printf("    0x%p: %s\n", pvs[i], pvs[i]->asString().c_str());
+            printf("    0x%p: %s\n", pvs[i], pvs[i]->asCString());
         }
     }
 
     static asynStatus interruptReg(DeviceVariable &baseVar, bool cancel) {
         printf("Interrupt %s: %s\n", (cancel ? "cancelled" : "registered"),
-               baseVar.asString().c_str());
+               baseVar.asCString());
         return asynSuccess;
     }
 
@@ -257,6 +309,47 @@ class AutoparamTest : public Autoparam::Driver {
         return result;
     }
 
+    static Int32ReadResult eventRead(DeviceVariable &baseVar) {
+        Int32ReadResult result;
+        MyVar &deviceVariable = static_cast<MyVar &>(baseVar);
+        result.value = deviceVariable.driver->lastEvent;
+        return result;
+    }
+
+    // Called by the event loop with the driver locked.
+    static bool eventsReadable(int fd, void *arg) {
+        AutoparamTest *self = static_cast<AutoparamTest *>(arg);
+#ifdef __linux__
+        epicsInt32 value;
+        ssize_t size;
+        while ((size = read(fd, &value, sizeof(value))) == sizeof(value)) {
+            self->lastEvent = value;
+        }
+        if (size == 0) {
+            // The write end was closed.
+            return false;
+        }
+#endif
+        std::vector<DeviceVariable *> vars = self->getInterruptVariables();
+        for (size_t i = 0; i < vars.size(); ++i) {
+            if (vars[i]->function() == "EVENT") {
+                self->setParam(*vars[i], self->lastEvent);
+            }
+        }
+        return true;
+    }
+
+    static GenericPointerReadResult blobRead(DeviceVariable &baseVar,
+                                             GenericPointer value) {
+        MyVar &deviceVariable = static_cast<MyVar &>(baseVar);
+        AutoparamTest *self = deviceVariable.driver;
+        BlobPacket *packet = value.as<BlobPacket>();
+        packet->sequence = self->blobSequence++;
+        packet->size = self->wfm8Data.size();
+        packet->data = self->wfm8Data.empty() ? NULL : &self->wfm8Data[0];
+        return GenericPointerReadResult();
+    }
+
     static WriteResult stringPrint(DeviceVariable &baseVar,
                                    Octet const &value) {
         printf("Got string: '");
@@ -269,14 +362,151 @@ class AutoparamTest : public Autoparam::Driver {
     }
 
     unsigned randomSeed;
+    epicsUInt32 blobSequence;
     epicsInt32 currentSum;
     std::vector<epicsInt8> wfm8Data;
     epicsUInt32 shiftedRegister;
+    epicsInt32 lastEvent;
+    int eventPipe[2];
     epicsThread thread;
     Runnable runnable;
     bool quitThread;
 };
 
+// Consumers for benchmarkBlob(). They touch the data the way a real consumer
+// would: the array consumer copies it (like a waveform record does), the
+// pointer consumer merely looks at it.
+struct BlobConsumer {
+    std::vector<epicsInt8> buffer;
+    epicsInt64 checksum;
+};
+
+static void consumeBlob(void *userPvt, asynUser *, void *pointer) {
+    BlobConsumer *consumer = static_cast<BlobConsumer *>(userPvt);
+    BlobPacket const *packet = static_cast<BlobPacket const *>(pointer);
+    consumer->checksum += packet->sequence + packet->data[packet->size - 1];
+}
+
+static void consumeBlob8(void *userPvt, asynUser *, epicsInt8 *data,
+                         size_t size) {
+    BlobConsumer *consumer = static_cast<BlobConsumer *>(userPvt);
+    size = std::min(size, consumer->buffer.size());
+    std::memcpy(&consumer->buffer[0], data, size);
+    consumer->checksum += consumer->buffer[size - 1];
+}
+
+// Creates an asynUser bound to `reason` on `port` and returns the interface of
+// the given type, or NULL on failure, in which case the asynUser is freed.
+static asynInterface *connectBenchUser(char const *port, char const *reason,
+                                       char const *ifaceType, asynUser **user) {
+    *user = pasynManager->createAsynUser(NULL, NULL);
+    if (pasynManager->connectDevice(*user, port, 0) != asynSuccess) {
+        pasynManager->freeAsynUser(*user);
+        *user = NULL;
+        return NULL;
+    }
+    asynInterface *drvUser =
+        pasynManager->findInterface(*user, asynDrvUserType, 1);
+    asynInterface *iface = NULL;
+    if (drvUser != NULL) {
+        asynDrvUser *pdrvUser = static_cast<asynDrvUser *>(drvUser->pinterface);
+        if (pdrvUser->create(drvUser->drvPvt, *user, reason, NULL, NULL) ==
+            asynSuccess) {
+            iface = pasynManager->findInterface(*user, ifaceType, 1);
+        }
+    }
+    if (iface == NULL) {
+        pasynManager->disconnect(*user);
+        pasynManager->freeAsynUser(*user);
+        *user = NULL;
+    }
+    return iface;
+}
+
+// Releases a user created by connectBenchUser(), if there is one.
+static void releaseBenchUser(asynUser *user) {
+    if (user != NULL) {
+        pasynManager->disconnect(user);
+        pasynManager->freeAsynUser(user);
+    }
+}
+
+void AutoparamTest::benchmarkBlob(size_t size, int iterations) {
+    if (size == 0 || iterations <= 0) {
+        printf("Size and iterations must be positive\n");
+        return;
+    }
+
+    std::vector<epicsInt8> payload(size, 42);
+    std::vector<epicsInt8> serialized(size);
+    BlobConsumer ptrConsumer;
+    ptrConsumer.checksum = 0;
+    BlobConsumer arrConsumer;
+    arrConsumer.buffer.resize(size);
+    arrConsumer.checksum = 0;
+
+    asynUser *ptrUser;
+    asynUser *arrUser;
+    asynInterface *ptrIface =
+        connectBenchUser(portName, "BLOB", asynGenericPointerType, &ptrUser);
+    asynInterface *arrIface =
+        connectBenchUser(portName, "BLOB8", asynInt8ArrayType, &arrUser);
+    if (ptrIface == NULL || arrIface == NULL) {
+        printf("Could not connect benchmark users to port %s\n", portName);
+        releaseBenchUser(ptrUser);
+        releaseBenchUser(arrUser);
+        return;
+    }
+
+    asynGenericPointer *pptr =
+        static_cast<asynGenericPointer *>(ptrIface->pinterface);
+    asynInt8Array *parr = static_cast<asynInt8Array *>(arrIface->pinterface);
+    void *ptrRegistrar;
+    void *arrRegistrar;
+    pptr->registerInterruptUser(ptrIface->drvPvt, ptrUser, consumeBlob,
+                                &ptrConsumer, &ptrRegistrar);
+    parr->registerInterruptUser(arrIface->drvPvt, arrUser, consumeBlob8,
+                                &arrConsumer, &arrRegistrar);
+
+    DeviceVariable *ptrVar = deviceVariableFromUser(ptrUser);
+    DeviceVariable *arrVar = deviceVariableFromUser(arrUser);
+
+    lock();
+
+    epicsUInt64 start = epicsMonotonicGet();
+    for (int i = 0; i < iterations; ++i) {
+        BlobPacket packet;
+        packet.sequence = i;
+        packet.size = payload.size();
+        packet.data = &payload[0];
+        doCallbacksGenericPointer(*ptrVar, GenericPointer(&packet));
+    }
+    epicsUInt64 ptrNs = epicsMonotonicGet() - start;
+
+    start = epicsMonotonicGet();
+    for (int i = 0; i < iterations; ++i) {
+        // The payload needs to be serialized into a byte array first.
+        std::memcpy(&serialized[0], &payload[0], size);
+        Array<epicsInt8> array(&serialized[0], size);
+        doCallbacksArray(*arrVar, array);
+    }
+    epicsUInt64 arrNs = epicsMonotonicGet() - start;
+
+    unlock();
+
+    pptr->cancelInterruptUser(ptrIface->drvPvt, ptrUser, ptrRegistrar);
+    parr->cancelInterruptUser(arrIface->drvPvt, arrUser, arrRegistrar);
+    releaseBenchUser(ptrUser);
+    releaseBenchUser(arrUser);
+
+    printf("Payload of %lu bytes, %d iterations:\n", (unsigned long)size,
+           iterations);
+    printf("    GenericPointer: %10.1f ns/update\n",
+           double(ptrNs) / iterations);
+    printf("    Int8Array:      %10.1f ns/update\n",
+           double(arrNs) / iterations);
+}
+
 static int const num_args = 1;
 static iocshArg const arg1 = {"port name", iocshArgString};
 static iocshArg const *const args[num_args] = {&arg1};
@@ -284,9 +514,50 @@ static iocshFuncDef command = {"drvAutoparamTestConfigure", num_args, args};
 
 static void call(iocshArgBuf const *args) { new AutoparamTest(args[0].sval); }
 
+static int const benchNumArgs = 3;
+static iocshArg const benchArg1 = {"port name", iocshArgString};
+static iocshArg const benchArg2 = {"payload size", iocshArgInt};
+static iocshArg const benchArg3 = {"iterations", iocshArgInt};
+static iocshArg const *const benchArgs[benchNumArgs] = {&benchArg1, &benchArg2,
+                                                        &benchArg3};
+static iocshFuncDef benchCommand = {"autoparamTestBenchBlob", benchNumArgs,
+                                    benchArgs};
+
+static void callBench(iocshArgBuf const *args) {
+    AutoparamTest *driver =
+        static_cast<AutoparamTest *>(findAsynPortDriver(args[0].sval));
+    if (driver == NULL) {
+        printf("No such port: %s\n", args[0].sval);
+        return;
+    }
+    driver->benchmarkBlob(args[1].ival, args[2].ival);
+}
+
+static int const eventNumArgs = 2;
+static iocshArg const eventArg1 = {"port name", iocshArgString};
+static iocshArg const eventArg2 = {"value", iocshArgInt};
+static iocshArg const *const eventArgs[eventNumArgs] = {&eventArg1,
+                                                        &eventArg2};
+static iocshFuncDef eventCommand = {"autoparamTestEvent", eventNumArgs,
+                                    eventArgs};
+
+static void callEvent(iocshArgBuf const *args) {
+    AutoparamTest *driver =
+        static_cast<AutoparamTest *>(findAsynPortDriver(args[0].sval));
+    if (driver == NULL) {
+        printf("No such port: %s\n", args[0].sval);
+        return;
+    }
+    driver->sendEvent(args[1].ival);
+}
+
 extern "C" {
 
-static void autoparamTestCommandRegistrar() { iocshRegister(&command, call); }
+static void autoparamTestCommandRegistrar() {
+    iocshRegister(&command, call);
+    iocshRegister(&benchCommand, callBench);
+    iocshRegister(&eventCommand, callEvent);
+}
 
 epicsExportRegistrar(autoparamTestCommandRegistrar);
 }
@@ -0,0 +1,34 @@
+#!../../bin/linux-x86_64/autoparamTest
+
+# SPDX-FileCopyrightText: 2022 Cosylab d.d. https://www.cosylab.com
+#
+# SPDX-License-Identifier: MIT-0
+
+#- Measures the driver against a simulated device. Generate the database
+#- first, e.g. for 1000 records scanned at 10 Hz over 4 device groups:
+#-     ../../autoparamTestApp/Db/simdb.py --read 1000 --groups 4 \
+#-         --scan ".1 second" > sim.db
+#- Add e.g. "--bits 64 --setpoint 100" for bo records using the shadow
+#- register and longout records using write batches.
+
+< envPaths
+
+cd "${TOP}"
+
+## Register all support components
+dbLoadDatabase "dbd/autoparamTest.dbd"
+autoparamTest_registerRecordDeviceDriver pdbbase
+
+#- 1024 registers, transactions taking 1 ms with a 99th percentile of 10 ms,
+#- 0.1 % of them failing, at most 2 at a time, polled every 0.1 s
+drvAutoparamSimConfigure("SIM", 1024, "longtail", 0.001, 0.01, 0.001, 2, 0.1)
+
+cd "${TOP}/iocBoot/${IOC}"
+
+## Load record instances
+dbLoadRecords("sim.db")
+
+iocInit
+
+#- Afterwards, "asynReport 1 SIM" shows the simulator's latency histogram and
+#- "autoparamSlowRequests SIM" the slowest requests.